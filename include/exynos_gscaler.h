@@ -83,6 +83,39 @@ typedef struct {
     int      mem_type;
 } exynos_mpp_img;
 
+/* one conversion of a batch, see exynos_gsc_run_batch() */
+typedef struct {
+    exynos_mpp_img src;
+    exynos_mpp_img dst;
+    int            status;      /* out: 0 or -1 */
+    long long      time_ns;     /* out: from queueing to completion */
+} exynos_gsc_job;
+
+typedef struct {
+    unsigned int jobs;
+    unsigned int failed;
+    unsigned int reconfigs;     /* configurations programmed */
+    /*
+     * compared to exynos_gsc_convert() per job: controls left alone, plus
+     * the stream stop and restart each job queued on a running stream avoided
+     */
+    unsigned long ioctls_saved;
+    long long    total_ns;
+} exynos_gsc_batch_stats;
+
+typedef struct {
+    unsigned int hw_jobs;
+    unsigned int sw_jobs;
+    unsigned int explored;      /* jobs run on the backend estimated slower */
+    unsigned int failed;
+    long long    hw_open_ns;    /* current estimates */
+    long long    hw_config_ns;
+    long long    hw_fixed_ns;
+    long long    hw_mpix_ns;    /* per million pixels */
+    long long    sw_copy_mb_ns; /* per MiB written */
+    long long    sw_scale_mb_ns;
+} exynos_gsc_dispatch_stats;
+
 /*
  * Create libgscaler handle.
  * Gscaler dev_num is dynamically changed.
@@ -95,6 +128,24 @@ typedef struct {
 void *exynos_gsc_create(
     void);
 
+/*!
+ * Create libgscaler handle with an arbitration priority.
+ * Like exynos_gsc_create(), but when every unit is busy the caller is
+ * served before the waiters of a lower priority class. Waiters of the same
+ * class are served in arrival order. exynos_gsc_create() uses
+ * GSC_PRIORITY_NORMAL.
+ *
+ * \ingroup exynos_gscaler
+ *
+ * \param priority
+ *   GSC_PRIORITY_DISPLAY, GSC_PRIORITY_NORMAL or GSC_PRIORITY_BACKGROUND[in]
+ *
+ * \return
+ *   libgscaler handle
+ */
+void *exynos_gsc_create_with_priority(
+    int priority);
+
 /*!
  * Create exclusive libgscaler handle.
  * Other module can't use dev_num of Gscaler.
@@ -278,6 +329,29 @@ int exynos_gsc_set_rotation(
     int   flip_horizontal,
     int   flip_vertical);
 
+/*!
+ * Set the number of M2M jobs that may be in flight.
+ * With a depth above 1, exynos_gsc_run_exclusive() queues a job and
+ * returns without waiting for the previous ones, and only blocks once
+ * depth jobs are queued. Completed jobs are dequeued in submission order
+ * by exynos_gsc_wait_frame_done_exclusive(). The default depth is 1.
+ * A new depth takes effect with the next reconfiguration.
+ *
+ * \ingroup exynos_gscaler
+ *
+ * \param handle
+ *   libgscaler handle[in]
+ *
+ * \param depth
+ *   number of buffer slots per queue, 1 to 6[in]
+ *
+ * \return
+ *   error code
+ */
+int exynos_gsc_set_queue_depth(
+    void *handle,
+    int   depth);
+
 /*!
  * Set source buffer
  *
@@ -370,6 +444,273 @@ int exynos_gsc_run_exclusive(
 int exynos_gsc_wait_frame_done_exclusive
 (void *handle);
 
+/*!
+ * Run a batch of conversions through the unit.
+ * Jobs sharing a configuration are grouped, keeping their order within a
+ * group, so each configuration is programmed once, and up to the queue
+ * depth of jobs are in flight. Acquire fences are consumed like in
+ * exynos_gsc_run_exclusive(). Release fences are closed, since every job is
+ * complete on return. The unit is left configured for the next batch;
+ * call exynos_gsc_stop_exclusive() when done.
+ *
+ * \ingroup exynos_gscaler
+ *
+ * \param handle
+ *   libgscaler handle[in]
+ *
+ * \param jobs
+ *   job descriptors, status and time_ns are filled in[in/out]
+ *
+ * \param count
+ *   number of jobs[in]
+ *
+ * \param stats
+ *   batch statistics or NULL[out]
+ *
+ * \return
+ *   0 if every job succeeded, -1 otherwise
+ */
+int exynos_gsc_run_batch(
+    void                   *handle,
+    exynos_gsc_job         *jobs,
+    int                     count,
+    exynos_gsc_batch_stats *stats);
+
+/*!
+ * Convert an image that may exceed the per-pass limits of the scaler.
+ * Crops over 4800x3344, or 2048x2048 when rotated, are split into tiles
+ * that are run as a batch on the unit; smaller ones run in one pass.
+ * Buffers up to 8192x8192 are supported. The seams are placed where the
+ * source and destination pixel grids meet, so every tile scales with the
+ * ratio and phase of a single pass; a conversion whose grids do not meet
+ * often enough for tiles within the limits fails, so that the caller can
+ * fall back. The scaling filter reads the tile edge instead of the
+ * neighbouring pixels, so output pixels within a few pixels of a seam
+ * differ from a single pass unless the image is not scaled. Blocks until
+ * the image is complete, the release fences are returned as -1.
+ *
+ * \ingroup exynos_gscaler
+ *
+ * \param handle
+ *   libgscaler handle[in]
+ *
+ * \param src_img
+ *   source image[in]
+ *
+ * \param dst_img
+ *   destination image[in]
+ *
+ * \return
+ *   error code
+ */
+int exynos_gsc_convert_tiled(
+    void           *handle,
+    exynos_mpp_img *src_img,
+    exynos_mpp_img *dst_img);
+
+/*!
+ * Take or give back a second unit for exynos_gsc_convert_split().
+ * Enabling takes a free unit without waiting for one and keeps it until
+ * disabled or the handle is destroyed. Only for M2M handles without drm.
+ *
+ * \ingroup exynos_gscaler
+ *
+ * \param handle
+ *   libgscaler handle[in]
+ *
+ * \param enable
+ *   1 to take a second unit, 0 to give it back[in]
+ *
+ * \return
+ *   error code, -1 if no second unit is free
+ */
+int exynos_gsc_set_split(
+    void *handle,
+    int   enable);
+
+/*!
+ * Convert one image on two units at once.
+ * The image is cut into two strips across its longer output side, which
+ * run concurrently on the unit of the handle and the one taken by
+ * exynos_gsc_set_split(), with the CSC settings of the handle. The seam
+ * is placed like the tiles of exynos_gsc_convert_tiled(), with the same
+ * differences from a single pass next to it; these are only modelled on
+ * the host, not verified on the hardware. Without a second unit, or for
+ * images too small to cut, the conversion runs in one pass. Blocks until
+ * the image is complete, the release fences are returned as -1.
+ *
+ * \ingroup exynos_gscaler
+ *
+ * \param handle
+ *   libgscaler handle[in]
+ *
+ * \param src_img
+ *   source image[in]
+ *
+ * \param dst_img
+ *   destination image[in]
+ *
+ * \return
+ *   error code
+ */
+int exynos_gsc_convert_split(
+    void           *handle,
+    exynos_mpp_img *src_img,
+    exynos_mpp_img *dst_img);
+
+/*!
+ * Create a dispatcher handle.
+ * Every job of the handle runs either on a scaler unit or on the CPU,
+ * whichever is expected to finish first. The expectation is made from the
+ * measured cost of opening and configuring a unit, of its jobs per pixel
+ * and of the CPU per byte written. The CPU only takes jobs with the same
+ * format on both sides and no rotation, and no cached dma-bufs once the
+ * kernel turned out to lack ranged cache sync for the CPU; the output has
+ * the layout the unit would write, scaled images are sampled from the
+ * nearest pixel. A unit is only taken when the CPU cannot do the job or is
+ * expected to be slower, and given back when unused for a while.
+ *
+ * \ingroup exynos_gscaler
+ *
+ * \param priority
+ *   GSC_PRIORITY_* for taking a unit[in]
+ *
+ * \return
+ *   dispatcher handle, also usable as a LibMpp
+ */
+void *exynos_gsc_create_dispatch(
+    int priority);
+
+/*!
+ * Convert one image on the backend chosen by the dispatcher.
+ * Blocks until the image is complete, the release fences are returned
+ * as -1.
+ *
+ * \ingroup exynos_gscaler
+ *
+ * \param handle
+ *   dispatcher handle[in]
+ *
+ * \param src_img
+ *   source image[in]
+ *
+ * \param dst_img
+ *   destination image[in]
+ *
+ * \return
+ *   error code
+ */
+int exynos_gsc_dispatch_convert(
+    void           *handle,
+    exynos_mpp_img *src_img,
+    exynos_mpp_img *dst_img);
+
+/*!
+ * Get the job counts and the current estimates of a dispatcher.
+ *
+ * \ingroup exynos_gscaler
+ *
+ * \param handle
+ *   dispatcher handle[in]
+ *
+ * \param stats
+ *   counts and estimates[out]
+ *
+ * \return
+ *   error code
+ */
+int exynos_gsc_dispatch_get_stats(
+    void                      *handle,
+    exynos_gsc_dispatch_stats *stats);
+
+/*!
+ * Destroy a dispatcher handle, giving back its unit if it holds one.
+ *
+ * \ingroup exynos_gscaler
+ *
+ * \param handle
+ *   dispatcher handle[in]
+ */
+void exynos_gsc_destroy_dispatch(
+    void *handle);
+
+/*!
+ * Select a named configuration session.
+ * Every session keeps a driver context of its own on the unit, with the
+ * formats, controls and buffers last programmed in it. A client that
+ * alternates between fixed configurations, e.g. thumbnail and full size,
+ * selects one session per configuration and stops paying the V4L2
+ * renegotiation on every switch. A new name opens a context, starting from
+ * the current configuration; the least recently used session is closed
+ * once the limit is reached. Pending jobs are completed before switching.
+ * Only for M2M handles without drm.
+ *
+ * \ingroup exynos_gscaler
+ *
+ * \param handle
+ *   libgscaler handle[in]
+ *
+ * \param name
+ *   session name, up to 15 characters are significant[in]
+ *
+ * \return
+ *   error code
+ */
+int exynos_gsc_select_session(
+    void       *handle,
+    const char *name);
+
+/*!
+ * Get an fd to poll for M2M job completion.
+ * The fd polls readable (POLLIN) once a queued job is done, so an event
+ * loop can drive several units without a waiter thread per unit. While no
+ * job is queued, e.g. before the first run, once every job was reaped or
+ * after a stop, it does not poll readable at all. The per-buffer release
+ * fences returned by exynos_gsc_run_exclusive() in releaseFenceFd are
+ * unchanged. The fd stays owned by the handle and stays the same across
+ * exynos_gsc_select_session(): it always reports the current session.
+ *
+ * \ingroup exynos_gscaler
+ *
+ * \param handle
+ *   libgscaler handle[in]
+ *
+ * \return
+ *   fd to poll, -1 if the handle is not in M2M mode
+ */
+int exynos_gsc_get_event_fd
+(void *handle);
+
+/*!
+ * Dequeue every completed M2M job without blocking.
+ * Jobs complete in submission order, so the n reaped jobs are the n oldest.
+ *
+ * \ingroup exynos_gscaler
+ *
+ * \param handle
+ *   libgscaler handle[in]
+ *
+ * \return
+ *   number of jobs reaped, -1 on error
+ */
+int exynos_gsc_reap_frames_exclusive
+(void *handle);
+
+/*!
+ * Get the number of M2M jobs submitted and not yet dequeued.
+ * exynos_gsc_run_exclusive() only blocks when this reaches the queue depth.
+ *
+ * \ingroup exynos_gscaler
+ *
+ * \param handle
+ *   libgscaler handle[in]
+ *
+ * \return
+ *   number of pending jobs
+ */
+int exynos_gsc_pending_frames
+(void *handle);
+
 /*
 *api for GSC stop.
 It stops the GSC OUT streaming.
@@ -403,6 +744,14 @@ enum {
     GSC_NEED_CNG_CFG,
 };
 
+/* arbitration priority, see exynos_gsc_create_with_priority() */
+enum {
+    GSC_PRIORITY_DISPLAY = 0,
+    GSC_PRIORITY_NORMAL,
+    GSC_PRIORITY_BACKGROUND,
+    GSC_PRIORITY_MAX,
+};
+
 enum {
     GSC_MEM_MMAP = 1,
     GSC_MEM_USERPTR,
@@ -33,6 +33,26 @@
 #define ION_EXYNOS_MFC_OUTPUT_MASK    (1 << 26)
 #define ION_EXYNOS_MFC_INPUT_MASK    (1 << 25)
 
+/* Default number of bytes ion_pool keeps cached for each heap mask */
+#define ION_POOL_DEFAULT_LIMIT  (32 * 1024 * 1024)
+
+/* Default virtual address space ion_map_cached() may keep mapped */
+#define ION_MAP_CACHE_DEFAULT_BUDGET    (64 * 1024 * 1024)
+
+/* Largest buffer set ion_prealloc_start() can allocate */
+#define ION_PREALLOC_MAX_BUFFERS    8
+
+/* Number of log2 latency buckets kept by ion_stats */
+#define ION_STATS_BUCKETS   24
+
+/* Limits of heap fallback chains, see ion_chain_register() */
+#define ION_CHAIN_MAX_STEPS     4
+#define ION_CHAIN_MAX_CHAINS    8
+
+/* Most planes an ion_image can have, and the default alignment of a plane */
+#define ION_IMAGE_MAX_PLANES            3
+#define ION_IMAGE_DEFAULT_PLANE_ALIGN   64
+
 
 /* ION_MSYNC_FLAGS
  * values of @flags parameter to ion_msync()
@@ -56,6 +76,26 @@ enum ION_MSYNC_FLAGS {
     IMSYNC_SYNC_FOR_CPU = 0x20000,
 };
 
+/* ION_MAP_FLAGS
+ * values of @map_flags parameter to ion_map_ext()
+ *
+ * ION_MAP_READ: CPU reads the mapping
+ * ION_MAP_WRITE: CPU writes the mapping. Without ION_MAP_READ the mapping is
+ *                meant to be write-only, though most CPUs can also read it.
+ * ION_MAP_PREFAULT: Populates all page tables at map time, so the first CPU
+ *                   touch of each page does not fault. Worth it when the
+ *                   whole mapping is going to be touched, like a plane fill.
+ * ION_MAP_ALIGN_LARGE: Aligns the mapping to 1MiB (64KiB for smaller
+ *                      mappings), so that a physically contiguous buffer
+ *                      can be mapped with sections or large pages.
+ */
+enum ION_MAP_FLAGS {
+    ION_MAP_READ = 1,
+    ION_MAP_WRITE = 2,
+    ION_MAP_PREFAULT = 4,
+    ION_MAP_ALIGN_LARGE = 8,
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -85,17 +125,41 @@ typedef int ion_client;
 typedef int ion_buffer;
 
 /* ion_client_create()
- * @RETURN: new ion_client.
+ * @RETURN: the ion_client shared by the process.
  *          netative value if creating new ion_client is failed.
  *
  * A call to ion_client_create() must be paired with ion_client_destroy(),
  * symmetrically. ion_client_destroy() needs a valid ion_client that
  * is returned by ion_client_create().
+ * All callers in a process get the same client, opened on first use and
+ * reference counted, so they share one fd and one kernel ion_client. It is
+ * safe to call from any thread. Never close() the returned value directly.
  */
 ion_client ion_client_create(void);
 
+/* ion_client_create_private()
+ * @RETURN: new ion_client that is not shared with the rest of the process.
+ *          netative value if creating new ion_client is failed.
+ *
+ * Use this only when a caller needs its own kernel handle table. The client
+ * is also released with ion_client_destroy().
+ */
+ion_client ion_client_create_private(void);
+
+/* ion_select_backend()
+ * @name: "kernel" for /dev/ion, or "memfd" for the userspace emulation that
+ *        backs buffers with memfd and needs no ION driver.
+ * @RETURN: 0 if successful. -1 if @name is unknown or a shared client exists.
+ *
+ * Must be called before any client is created. Without it the backend is
+ * taken from the ION_EXYNOS_BACKEND environment variable, and defaults to
+ * "kernel".
+ */
+int ion_select_backend(const char *name);
+
 /* ion_client_destroy()
- * @client: An ion_client value to remove.
+ * @client: An ion_client value to remove. The shared client is closed when
+ *          its last reference is dropped.
  */
 void ion_client_destroy(ion_client client);
 
@@ -140,6 +204,17 @@ void ion_free(ion_buffer buffer);
  */
 void *ion_map(ion_buffer buffer, size_t len, off_t offset);
 
+/* ion_map_ext() - ion_map() with mapping options
+ * @buffer, @len, @offset: Same as ion_map().
+ * @map_flags: ORed ION_MAP_FLAGS.
+ * @RETURN: The start virtual addres mapped.
+ *          MAP_FAILED if mapping fails.
+ *
+ * The mapping is released with ion_unmap() like any other.
+ */
+void *ion_map_ext(ion_buffer buffer, size_t len, off_t offset,
+                  unsigned int map_flags);
+
 /* ion_unmap() - Frees the buffer mapped by ion_map()
  * @addr: The address returned by ion_map().
  * @len: The size of the buffer mapped by ion_map().
@@ -148,6 +223,35 @@ void *ion_map(ion_buffer buffer, size_t len, off_t offset);
  */
 int ion_unmap(void *addr, size_t len);
 
+/* ion_map_cached() - Obtains a virtual address of @buffer from the map cache
+ * @buffer, @len, @offset: Same as ion_map().
+ * @RETURN: The start virtual addres mapped.
+ *          MAP_FAILED if mapping fails.
+ *
+ * Mappings are shared process-wide and keyed by the identity of the dma-buf
+ * behind @buffer (the dev and inode of the file), not by the fd number, so
+ * any fd of the same buffer hits the same mapping. Each call takes a reference
+ * that must be dropped with ion_unmap_cached(). Unreferenced mappings stay
+ * mapped until the cache exceeds its budget, and are then unmapped least
+ * recently used first. Note that a cached mapping keeps its buffer alive.
+ */
+void *ion_map_cached(ion_buffer buffer, size_t len, off_t offset);
+
+/* ion_unmap_cached() - Drops a reference taken by ion_map_cached()
+ * @addr: The address returned by ion_map_cached().
+ * @RETURN: 0 on success, and -1 if @addr is not a referenced cached mapping.
+ */
+int ion_unmap_cached(void *addr);
+
+/* ion_map_cache_set_budget() - Sets the size of the map cache
+ * @budget: Bytes of unreferenced mappings that may stay mapped.
+ *          ION_MAP_CACHE_DEFAULT_BUDGET is used until this is called.
+ */
+void ion_map_cache_set_budget(size_t budget);
+
+/* ion_map_cache_flush() - Unmaps every unreferenced cached mapping */
+void ion_map_cache_flush(void);
+
 /* ion_msync() - Makes sure that data in the buffer are visible to H/W peri.
  * @client: A valid ion_client value returned by ion_client_create().
  * @buffer: The buffer to perform ion_msync().
@@ -158,6 +262,33 @@ int ion_unmap(void *addr, size_t len);
  * @RETURN: 0 if successful. -error, otherwise.
  *
  * Note that @offset + @size must not exceed the size of @buffer.
+ * Only the cache lines covering [@offset, @offset + @size) are maintained, so
+ * a CPU writer that touched part of a buffer should pass just that range.
+ * If the kernel has no range sync, IMSYNC_SYNC_FOR_DEV falls back to
+ * ion_sync() of the whole buffer, and IMSYNC_SYNC_FOR_CPU fails with
+ * -ENOTTY since there is nothing to fall back to. A range the kernel
+ * rejects fails with -EINVAL.
+ */
+int ion_msync(ion_client client, ion_buffer buffer, long flags,
+              size_t size, off_t offset);
+
+/* ion_msync_rect() - ion_msync() on the lines covered by a rectangle
+ * @client, @buffer, @flags: Same as ion_msync().
+ * @offset: Where the plane holding the rectangle starts in @buffer.
+ * @stride: Bytes per line of the plane.
+ * @x, @y, @w, @h: The rectangle in bytes and lines.
+ * @RETURN: 0 if successful. -error, otherwise.
+ *
+ * Lines outside [@y, @y + @h) are not touched.
+ */
+int ion_msync_rect(ion_client client, ion_buffer buffer, long flags,
+                   off_t offset, size_t stride,
+                   size_t x, size_t y, size_t w, size_t h);
+
+/* ion_sync() - Makes the whole buffer visible to H/W peri.
+ * @client: A valid ion_client value returned by ion_client_create().
+ * @buffer: The buffer to synchronize.
+ * @RETURN: 0 if successful. negative value, otherwise.
  */
 int ion_sync(ion_client client, ion_buffer buffer);
 
@@ -165,6 +296,423 @@ int ion_incRef(int fd, int share_fd, unsigned long **handle);
 
 int ion_decRef(int fd, unsigned long *handle);
 
+/* ion_pool_alloc() - Allocates a buffer, reusing a pooled one if possible.
+ * @client, @align, @heap_mask, @flags: Same as ion_alloc().
+ * @len: Size of a buffer required in bytes. It is rounded up to a size class
+ *       and a buffer of the rounded size is returned, so that buffers of
+ *       nearby sizes can be recycled for each other.
+ * @RETURN: An ion_buffer or -error, like ion_alloc().
+ *
+ * A buffer returned by ion_pool_alloc() must be released with ion_pool_free()
+ * and not with ion_free(). Its contents are undefined, it may hold data
+ * written by a previous user in this process.
+ */
+ion_buffer ion_pool_alloc(ion_client client, size_t len, size_t align,
+                          unsigned int heap_mask, unsigned int flags);
+
+/* ion_pool_free() - Returns a buffer to the pool.
+ * @buffer: An ion_buffer returned by ion_pool_alloc().
+ *
+ * The buffer is kept for reuse unless the pool of its heap mask would exceed
+ * its limit, in which case the oldest cached buffers are freed. A buffer that
+ * does not come from ion_pool_alloc() is simply freed with ion_free().
+ */
+void ion_pool_free(ion_buffer buffer);
+
+/* ion_pool_set_limit() - Sets how many bytes the pool may cache for a heap.
+ * @heap_mask: Heap mask as given to ion_pool_alloc().
+ * @limit: Maximum cached bytes. 0 disables caching for @heap_mask.
+ *         ION_POOL_DEFAULT_LIMIT is used until this is called.
+ * @RETURN: 0 if successful. -1 if too many heap masks are in use.
+ */
+int ion_pool_set_limit(unsigned int heap_mask, size_t limit);
+
+/* ion_pool_trim() - Frees the oldest cached buffers.
+ * @heap_mask: Heap mask to trim, or 0 to trim the whole pool.
+ * @limit: Number of cached bytes to keep. 0 empties the pool.
+ */
+void ion_pool_trim(unsigned int heap_mask, size_t limit);
+
+/* ion_pool_cached_size() - Returns the number of bytes cached for reuse.
+ * @heap_mask: Heap mask to query, or 0 for the whole pool.
+ */
+size_t ion_pool_cached_size(unsigned int heap_mask);
+
+/* ion_alloc_set() - Allocates @count identical buffers
+ * @client, @len, @align, @heap_mask, @flags: Same as ion_alloc().
+ * @count: Number of buffers to allocate.
+ * @buffers: Array of at least @count entries that receives the buffers.
+ * @RETURN: 0 if all buffers are allocated. -error otherwise, in which case
+ *          the buffers allocated so far are freed.
+ */
+int ion_alloc_set(ion_client client, size_t len, size_t align,
+                  unsigned int heap_mask, unsigned int flags,
+                  unsigned int count, ion_buffer *buffers);
+
+/* ion_prealloc
+ * A buffer set being allocated by ion_prealloc_start() on a background
+ * thread. It is released by ion_prealloc_finish() or ion_prealloc_cancel().
+ */
+struct ion_prealloc;
+
+/* ion_prealloc_callback
+ * Called on the allocating thread when the set is ready, with the result of
+ * ion_alloc_set() and the data given to ion_prealloc_start(). It must not
+ * call ion_prealloc_finish() or ion_prealloc_cancel() itself.
+ */
+typedef void (*ion_prealloc_callback)(struct ion_prealloc *req, int result,
+                                      void *data);
+
+/* ion_prealloc_start() - Starts allocating a buffer set in the background
+ * @client, @len, @align, @heap_mask, @flags, @count: Same as ion_alloc_set().
+ *          @count must not exceed ION_PREALLOC_MAX_BUFFERS.
+ * @callback: Completion callback or NULL.
+ * @data: Passed to @callback.
+ * @RETURN: The pending request, or NULL if it could not be started.
+ *
+ * This lets a caller warm up the buffers of the next configuration while
+ * the current one is still in use, off the display critical path.
+ */
+struct ion_prealloc *ion_prealloc_start(ion_client client, size_t len,
+                                        size_t align, unsigned int heap_mask,
+                                        unsigned int flags, unsigned int count,
+                                        ion_prealloc_callback callback,
+                                        void *data);
+
+/* ion_prealloc_fd() - Returns an eventfd that becomes readable on completion
+ * @req: A request returned by ion_prealloc_start().
+ *
+ * The fd belongs to @req and is closed by ion_prealloc_finish() or
+ * ion_prealloc_cancel().
+ */
+int ion_prealloc_fd(struct ion_prealloc *req);
+
+/* ion_prealloc_finish() - Waits for a request and takes its buffers
+ * @req: A request returned by ion_prealloc_start(). It is freed.
+ * @buffers: Array of at least @count entries that receives the buffers.
+ * @RETURN: 0 if successful. -error if the allocation failed.
+ */
+int ion_prealloc_finish(struct ion_prealloc *req, ion_buffer *buffers);
+
+/* ion_prealloc_cancel() - Waits for a request and frees its buffers
+ * @req: A request returned by ion_prealloc_start(). It is freed.
+ */
+void ion_prealloc_cancel(struct ion_prealloc *req);
+
+/* ion_heap_stats
+ * Allocation statistics of one heap in this process, see ion_stats_get_heap().
+ * @heap_mask: The heap bit the statistics belong to.
+ * @live_bytes: Bytes currently allocated and not yet freed.
+ * @peak_bytes: High-water mark of @live_bytes.
+ * @alloc_count, @free_count, @fail_count: Number of ion_alloc() successes,
+ *                                         buffers freed and failures.
+ *
+ * Buffers are recorded by fd. One released with close() instead of
+ * ion_free() stays in @live_bytes until ion_alloc() returns the same fd
+ * again, and is counted as freed then. Buffers on fds above 4095 are only
+ * counted in @alloc_count.
+ * @alloc_latency: Histogram of ion_alloc() latency. Bucket 0 counts calls
+ *                 under 1us and bucket i calls in [2^(i-1), 2^i) us. The last
+ *                 bucket also counts everything slower.
+ */
+struct ion_heap_stats {
+    unsigned int heap_mask;
+    size_t live_bytes;
+    size_t peak_bytes;
+    unsigned long alloc_count;
+    unsigned long free_count;
+    unsigned long fail_count;
+    unsigned long alloc_latency[ION_STATS_BUCKETS];
+};
+
+/* ion_map_stats
+ * ion_map() statistics of this process, see ion_stats_get_map().
+ * @prefaulted_pages: Page faults taken while populating ION_MAP_PREFAULT
+ *                    mappings, measured around each mmap() call: the sum
+ *                    of the @prefaulted counts of struct ion_track_record.
+ *                    Heaps that map without faulting add nothing.
+ * @map_latency: Histogram of ion_map() latency, like @alloc_latency above.
+ */
+struct ion_map_stats {
+    unsigned long map_count;
+    unsigned long fail_count;
+    unsigned long long map_bytes;
+    unsigned long long prefaulted_pages;
+    unsigned long map_latency[ION_STATS_BUCKETS];
+};
+
+/* ion_stats_get_heap() - Reads the statistics of a heap
+ * @heap_mask: Heap to query. Buffers are accounted to the lowest bit of the
+ *             heap mask they were allocated with.
+ * @stats: Receives the statistics.
+ * @RETURN: 0 if successful. -1 if @heap_mask is 0.
+ *
+ * Counters are updated without locks, so fields may be sampled a few
+ * allocations apart from each other.
+ */
+int ion_stats_get_heap(unsigned int heap_mask, struct ion_heap_stats *stats);
+
+/* ion_stats_get_map() - Reads the ion_map() statistics
+ * @stats: Receives the statistics.
+ */
+void ion_stats_get_map(struct ion_map_stats *stats);
+
+/* ion_stats_dump() - Prints all statistics as text
+ * @buf: Buffer to print to. It is always NUL terminated.
+ * @len: Size of @buf.
+ * @RETURN: Number of characters printed.
+ */
+int ion_stats_dump(char *buf, size_t len);
+
+/* ion_chain_register() - Declares a heap fallback chain
+ * @name: Short name used in logs.
+ * @heap_masks: Heap masks to try, in order of preference. For example
+ *              { ION_HEAP_EXYNOS_CONTIG_MASK, ION_HEAP_SYSTEM_MASK } for a
+ *              buffer whose consumer sits behind an IOMMU and can also use
+ *              scattered memory.
+ * @nr_steps: Number of entries in @heap_masks, at most ION_CHAIN_MAX_STEPS.
+ * @RETURN: Chain id for ion_alloc_chain(). -error if it can't be registered.
+ */
+int ion_chain_register(const char *name, const unsigned int *heap_masks,
+                       unsigned int nr_steps);
+
+/* ion_alloc_chain() - Allocates from the first heap of a chain that can
+ *                     serve the request.
+ * @client, @len, @align, @flags: Same as ion_alloc().
+ * @chain: Chain id returned by ion_chain_register().
+ * @heap_used: If not NULL, receives the heap mask that served the request.
+ * @RETURN: An ion_buffer or the -error of the last heap tried.
+ *
+ * A heap that fails is first given back the buffers ion_pool caches for it
+ * and retried once. A heap that keeps failing is skipped for a short while,
+ * so that allocations under memory pressure go straight to the fallback
+ * instead of stalling in a fragmented contiguous heap. The last heap of a
+ * chain is never skipped.
+ */
+ion_buffer ion_alloc_chain(ion_client client, int chain, size_t len,
+                           size_t align, unsigned int flags,
+                           unsigned int *heap_used);
+
+/* ion_chain_stats
+ * Accounting of a chain, indexed by step where it applies.
+ * @attempts: Allocations tried on the step.
+ * @served: Allocations the step served.
+ * @skipped: Times the step was skipped while backing off.
+ * @fallbacks: Allocations served by any step but the first.
+ * @failures: Allocations no step could serve.
+ */
+struct ion_chain_stats {
+    unsigned long attempts[ION_CHAIN_MAX_STEPS];
+    unsigned long served[ION_CHAIN_MAX_STEPS];
+    unsigned long skipped[ION_CHAIN_MAX_STEPS];
+    unsigned long fallbacks;
+    unsigned long failures;
+};
+
+/* ion_chain_get_stats() - Reads the accounting of a chain
+ * @chain: Chain id returned by ion_chain_register().
+ * @stats: Receives the accounting.
+ * @RETURN: 0 if successful. -error if @chain is unknown.
+ */
+int ion_chain_get_stats(int chain, struct ion_chain_stats *stats);
+
+/* ION_IMAGE_FORMATS
+ * values of @format parameter to ion_image_layout() and ion_image_alloc()
+ *
+ * ION_IMAGE_YUV420SP: Y plane and interleaved CbCr plane at half height (NV12)
+ * ION_IMAGE_YUV420P: Y, Cb and Cr planes, chroma at half size (I420)
+ * ION_IMAGE_YUV422SP: Y plane and interleaved CbCr plane at full height (NV16)
+ * ION_IMAGE_RGB32: One plane of 32-bit pixels
+ */
+enum ION_IMAGE_FORMATS {
+    ION_IMAGE_YUV420SP = 0,
+    ION_IMAGE_YUV420P = 1,
+    ION_IMAGE_YUV422SP = 2,
+    ION_IMAGE_RGB32 = 3,
+};
+
+/* ion_image_plane
+ * @offset: Byte offset of the plane from the start of the buffer.
+ * @stride: Bytes per line of the plane.
+ * @height: Lines of the plane.
+ * @size: @stride * @height.
+ */
+struct ion_image_plane {
+    size_t offset;
+    size_t stride;
+    unsigned int height;
+    size_t size;
+};
+
+/* ion_image
+ * A multi-plane image held in a single ION buffer.
+ * @buffer: The buffer holding all planes, or -1 before allocation.
+ * @addr: The CPU mapping of the whole buffer, or MAP_FAILED if not mapped.
+ * @len: Size of @buffer.
+ * @format: One of ION_IMAGE_FORMATS.
+ * @width, @height: Size of the image in pixels.
+ * @nr_planes: Number of valid entries in @planes.
+ * @planes: Layout of each plane within @buffer.
+ */
+struct ion_image {
+    ion_buffer buffer;
+    void *addr;
+    size_t len;
+    unsigned int format;
+    unsigned int width;
+    unsigned int height;
+    unsigned int nr_planes;
+    struct ion_image_plane planes[ION_IMAGE_MAX_PLANES];
+};
+
+/* ion_image_layout() - Computes the plane layout of an image
+ * @format: One of ION_IMAGE_FORMATS.
+ * @width, @height: Size of the image in pixels.
+ * @stride_align: Alignment of the stride of every plane in bytes. 0 means none.
+ * @plane_align: Alignment of the offset of every plane in bytes. 0 means
+ *          ION_IMAGE_DEFAULT_PLANE_ALIGN.
+ * @image: Receives the layout. @image->buffer is set to -1.
+ * @RETURN: 0 if successful. -EINVAL if @format or the size is invalid.
+ *
+ * The buffer length is rounded up to a page.
+ */
+int ion_image_layout(unsigned int format, unsigned int width,
+                     unsigned int height, size_t stride_align,
+                     size_t plane_align, struct ion_image *image);
+
+/* ion_image_alloc() - Allocates all planes of an image in one buffer
+ * @client: A client ID returned by ion_client_create().
+ * @format, @width, @height, @stride_align, @plane_align: Same as
+ *          ion_image_layout().
+ * @heap_mask, @flags: Same as ion_alloc().
+ * @image: Receives the layout and the buffer.
+ * @RETURN: 0 if successful. -error otherwise.
+ *
+ * One allocation and one fd serve every plane, instead of one per plane.
+ * Release it with ion_image_free().
+ */
+int ion_image_alloc(ion_client client, unsigned int format, unsigned int width,
+                    unsigned int height, size_t stride_align, size_t plane_align,
+                    unsigned int heap_mask, unsigned int flags,
+                    struct ion_image *image);
+
+/* ion_image_map() - Maps all planes of an image at once
+ * @image: An image allocated by ion_image_alloc().
+ * @map_flags: ORed ION_MAP_FLAGS.
+ * @RETURN: The start of the buffer, or MAP_FAILED.
+ *
+ * The mapping is kept in @image->addr. Mapping an image that is already
+ * mapped returns the existing mapping.
+ */
+void *ion_image_map(struct ion_image *image, unsigned int map_flags);
+
+/* ion_image_plane_addr() - Returns the CPU address of a plane
+ * @image: A mapped image.
+ * @plane: Index of the plane.
+ * @RETURN: The address, or NULL if @image is not mapped or @plane is invalid.
+ */
+void *ion_image_plane_addr(const struct ion_image *image, unsigned int plane);
+
+/* ion_image_plane_fd() - Returns the device descriptor of a plane
+ * @image: An image allocated by ion_image_alloc().
+ * @plane: Index of the plane.
+ * @fd: Receives the buffer fd, the same one for every plane.
+ * @offset: Receives the offset of the plane in @fd.
+ * @RETURN: 0 if successful. -EINVAL if @image has no buffer or @plane is
+ *          invalid.
+ *
+ * The (fd, offset) pair is what a V4L2 multi-plane dmabuf queue takes as
+ * m.fd and data_offset. @fd stays owned by @image.
+ */
+int ion_image_plane_fd(const struct ion_image *image, unsigned int plane,
+                       int *fd, size_t *offset);
+
+/* ion_image_free() - Unmaps and frees an image
+ * @image: An image allocated by ion_image_alloc().
+ */
+void ion_image_free(struct ion_image *image);
+
+/* ion_track_enable() - Turns lifetime tracking on or off
+ * @enable: Nonzero to start tracking, 0 to stop and drop all records.
+ * @RETURN: 0 if successful. -ENOMEM if the record table cannot be allocated.
+ *
+ * While enabled, every buffer allocated by ion_alloc() and every mapping made
+ * by ion_map() or ion_map_ext() is recorded until it is freed or unmapped.
+ * Buffers and mappings that exist before tracking starts are not recorded.
+ * Setting the environment variable ION_EXYNOS_TRACK=1 enables tracking at
+ * the first call into the library.
+ */
+int ion_track_enable(int enable);
+
+/* ion_track_set_tag() - Sets the caller tag of the calling thread
+ * @tag: A string that outlives the records, usually a literal. NULL clears it.
+ * @RETURN: The previous tag, so that it can be restored.
+ *
+ * Allocations and mappings made by the thread are recorded with @tag.
+ */
+const char *ion_track_set_tag(const char *tag);
+
+/* ION_TRACK_TYPES
+ * values of @type in struct ion_track_record
+ */
+enum ION_TRACK_TYPES {
+    ION_TRACK_ALLOC = 0,
+    ION_TRACK_MAP = 1,
+};
+
+/* ion_track_record
+ * @type: One of ION_TRACK_TYPES.
+ * @buffer: The allocated or mapped buffer.
+ * @addr: Start of the mapping, NULL for allocations.
+ * @len: Size of the allocation or mapping.
+ * @heap_mask: Heap of the buffer, 0 for mappings of buffers allocated by
+ *          another process or before tracking started.
+ * @age_ns: Time since the allocation or mapping.
+ * @tag: Caller tag at the time of the allocation or mapping, or NULL.
+ * @serial: Sequence number of the record, see ion_track_snapshot().
+ * @prefaulted: Page faults taken while populating an ION_MAP_PREFAULT
+ *          mapping, 0 for allocations and other mappings.
+ */
+struct ion_track_record {
+    unsigned int type;
+    ion_buffer buffer;
+    void *addr;
+    size_t len;
+    unsigned int heap_mask;
+    long long age_ns;
+    const char *tag;
+    unsigned long serial;
+    unsigned long prefaulted;
+};
+
+/* ion_track_snapshot() - Marks the current point in the record sequence
+ * @RETURN: The serial of the latest record.
+ *
+ * Passing it as @since to ion_track_get() or ion_track_dump() later gives
+ * the difference between the two points in time: what was allocated or
+ * mapped since and is still alive, which is where leaks show up.
+ */
+unsigned long ion_track_snapshot(void);
+
+/* ion_track_get() - Reads the live records
+ * @records: Receives up to @max records. May be NULL if @max is 0.
+ * @max: Size of @records.
+ * @since: Only records newer than this serial are returned. 0 returns all.
+ * @RETURN: Number of matching records, which may exceed @max.
+ */
+int ion_track_get(struct ion_track_record *records, int max,
+                  unsigned long since);
+
+/* ion_track_dump() - Prints the live records as text
+ * @buf: Buffer to print to. It is always NUL terminated.
+ * @len: Size of @buf.
+ * @since: Same as ion_track_get().
+ * @RETURN: Number of characters printed, 0 if tracking is disabled.
+ *
+ * A summary of count and bytes per tag comes first, then every record.
+ */
+int ion_track_dump(char *buf, size_t len, unsigned long since);
+
 #ifdef __cplusplus
 }
 #endif
@@ -53,6 +53,10 @@
 #ifndef SW_CONVERTOR_H_
 #define SW_CONVERTOR_H_
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /*--------------------------------------------------------------------------------*/
 /* Format Conversion API                                                          */
 /*--------------------------------------------------------------------------------*/
@@ -339,6 +343,160 @@ void csc_ARGB8888_to_YUV420SP(
     unsigned int width,
     unsigned int height);
 
+/*--------------------------------------------------------------------------------*/
+/* 2D Memory API                                                                  */
+/*--------------------------------------------------------------------------------*/
+/*
+ * Copies a 2D rectangle from src to dst
+ *
+ * @param dst
+ *   Address of the first byte of the destination rectangle[out]
+ *
+ * @param dst_pitch
+ *   Bytes between the starts of two destination lines[in]
+ *
+ * @param src
+ *   Address of the first byte of the source rectangle[in]
+ *
+ * @param src_pitch
+ *   Bytes between the starts of two source lines[in]
+ *
+ * @param width
+ *   Width of the rectangle in bytes[in]
+ *
+ * @param height
+ *   Height of the rectangle in lines[in]
+ */
+void csc_memcpy_2d(
+    unsigned char *dst,
+    unsigned int dst_pitch,
+    unsigned char *src,
+    unsigned int src_pitch,
+    unsigned int width,
+    unsigned int height);
+
+/*
+ * Fills a 2D rectangle with a 32bit pattern
+ *
+ * @param dst
+ *   Address of the first byte of the rectangle[out]
+ *
+ * @param dst_pitch
+ *   Bytes between the starts of two lines[in]
+ *
+ * @param width
+ *   Width of the rectangle in bytes[in]
+ *
+ * @param height
+ *   Height of the rectangle in lines[in]
+ *
+ * @param pattern
+ *   32bit pattern. Byte (i % 4) of it is stored at byte i of each line[in]
+ */
+void csc_memset_2d(
+    unsigned char *dst,
+    unsigned int dst_pitch,
+    unsigned int width,
+    unsigned int height,
+    unsigned int pattern);
+
+/*
+ * Copies a rectangle between two buffers of the same pixel size
+ * Uses the NEON routines on arm targets.
+ *
+ * @param dst_x, dst_y, src_x, src_y
+ *   Position of the rectangle in each buffer in pixels[in]
+ *
+ * @param width, height
+ *   Size of the rectangle in pixels[in]
+ *
+ * @param bpp
+ *   Bytes per pixel[in]
+ */
+void csc_copy_rect(
+    unsigned char *dst,
+    unsigned int dst_pitch,
+    unsigned int dst_x,
+    unsigned int dst_y,
+    unsigned char *src,
+    unsigned int src_pitch,
+    unsigned int src_x,
+    unsigned int src_y,
+    unsigned int width,
+    unsigned int height,
+    unsigned int bpp);
+
+/*
+ * Fills a rectangle of YUV420SP with one colour
+ * Planes passed as NULL are left untouched.
+ *
+ * @param x, y, width, height
+ *   Rectangle in luma pixels. they should be even[in]
+ */
+void csc_fill_rect_YUV420SP(
+    unsigned char *y_dst,
+    unsigned char *uv_dst,
+    unsigned int y_pitch,
+    unsigned int uv_pitch,
+    unsigned int x,
+    unsigned int y,
+    unsigned int width,
+    unsigned int height,
+    unsigned char y_value,
+    unsigned char u_value,
+    unsigned char v_value);
+
+/*
+ * Fills a rectangle of YUV420P with one colour
+ * Planes passed as NULL are left untouched.
+ *
+ * @param x, y, width, height
+ *   Rectangle in luma pixels. they should be even[in]
+ */
+void csc_fill_rect_YUV420P(
+    unsigned char *y_dst,
+    unsigned char *u_dst,
+    unsigned char *v_dst,
+    unsigned int y_pitch,
+    unsigned int uv_pitch,
+    unsigned int x,
+    unsigned int y,
+    unsigned int width,
+    unsigned int height,
+    unsigned char y_value,
+    unsigned char u_value,
+    unsigned char v_value);
+
+/*
+ * Fills a rectangle of a 32bit RGB buffer with one colour
+ *
+ * @param color
+ *   Pixel value as it is stored in memory[in]
+ */
+void csc_fill_rect_ARGB8888(
+    unsigned char *dst,
+    unsigned int dst_pitch,
+    unsigned int x,
+    unsigned int y,
+    unsigned int width,
+    unsigned int height,
+    unsigned int color);
+
+/*
+ * Clears a rectangle to zero
+ *
+ * @param bpp
+ *   Bytes per pixel[in]
+ */
+void csc_clear_rect(
+    unsigned char *dst,
+    unsigned int dst_pitch,
+    unsigned int x,
+    unsigned int y,
+    unsigned int width,
+    unsigned int height,
+    unsigned int bpp);
+
 /*
  * De-interleaves src to dest1, dest2
  *
@@ -511,4 +669,33 @@ void csc_ARGB8888_to_YUV420SP_NEON(
     unsigned int width,
     unsigned int height);
 
+/*
+ * Copies a 2D rectangle from src to dst
+ * Stores are 128bit aligned, so it is suited to uncached destinations.
+ * See csc_memcpy_2d for the parameters.
+ */
+void csc_memcpy_2d_neon(
+    unsigned char *dst,
+    unsigned int dst_pitch,
+    unsigned char *src,
+    unsigned int src_pitch,
+    unsigned int width,
+    unsigned int height);
+
+/*
+ * Fills a 2D rectangle with a 32bit pattern
+ * The destination is never read and stores are 128bit aligned, so it is
+ * suited to uncached destinations. See csc_memset_2d for the parameters.
+ */
+void csc_memset_2d_neon(
+    unsigned char *dst,
+    unsigned int dst_pitch,
+    unsigned int width,
+    unsigned int height,
+    unsigned int pattern);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /*COLOR_SPACE_CONVERTOR_H_*/
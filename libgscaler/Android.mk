@@ -17,12 +17,16 @@ ifeq ($(filter-out exynos5,$(TARGET_BOARD_PLATFORM)),)
 LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
-LOCAL_SHARED_LIBRARIES := liblog libutils libcutils libexynosutils libexynosv4l2
+LOCAL_SHARED_LIBRARIES := liblog libutils libcutils libexynosutils libexynosv4l2 \
+	libion_exynos libsync
 
 # to talk to secure side
 LOCAL_SHARED_LIBRARIES += libMcClient
 LOCAL_STATIC_LIBRARIES := libsecurepath
 
+# CPU backend of the dispatcher
+LOCAL_STATIC_LIBRARIES += libswconverter
+
 ifeq ($(BOARD_USES_ONLY_GSC0_GSC1),true)
 	LOCAL_CFLAGS += -DUSES_ONLY_GSC0_GSC1
 endif
@@ -48,10 +52,83 @@ LOCAL_ADDITIONAL_DEPENDENCIES := \
 
 LOCAL_SRC_FILES := \
 	libgscaler_obj.cpp \
+	libgscaler_arbiter.cpp \
+	libgscaler_tile.cpp \
+	libgscaler_sw.cpp \
+	libgscaler_dispatch.cpp \
 	libgscaler.cpp
 
 LOCAL_MODULE_TAGS := eng
 LOCAL_MODULE := libexynosgscaler
 include $(BUILD_SHARED_LIBRARY)
 
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := liblog libcutils
+
+LOCAL_CFLAGS += -DGSC_ARBITER_PATH=\"/data/local/tmp/gsc_arbiter_bench.table\"
+
+ifeq ($(BOARD_USES_ONLY_GSC0_GSC1),true)
+	LOCAL_CFLAGS += -DUSES_ONLY_GSC0_GSC1
+endif
+
+LOCAL_C_INCLUDES := \
+	$(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include \
+	$(LOCAL_PATH)/../include \
+	$(TOP)/hardware/samsung_slsi-cm/exynos/include \
+	$(TOP)/hardware/samsung_slsi-cm/exynos/libexynosutils \
+	$(TOP)/hardware/samsung_slsi-cm/exynos/libmpp
+
+LOCAL_ADDITIONAL_DEPENDENCIES := \
+	$(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+
+LOCAL_SRC_FILES := \
+	libgscaler_arbiter.cpp \
+	gsc_arbiter_bench.cpp
+
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE := gsc_arbiter_bench
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_C_INCLUDES := \
+	$(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include \
+	$(LOCAL_PATH)/../include \
+	$(TOP)/hardware/samsung_slsi-cm/exynos/include \
+	$(TOP)/hardware/samsung_slsi-cm/exynos/libexynosutils \
+	$(TOP)/hardware/samsung_slsi-cm/exynos/libmpp
+
+LOCAL_ADDITIONAL_DEPENDENCIES := \
+	$(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+
+LOCAL_SRC_FILES := \
+	libgscaler_tile.cpp \
+	gsc_tile_test.cpp
+
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE := gsc_tile_test
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := liblog libexynosgscaler
+
+LOCAL_C_INCLUDES := \
+	$(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include \
+	$(LOCAL_PATH)/../include \
+	$(TOP)/hardware/samsung_slsi-cm/exynos/include \
+	$(TOP)/hardware/samsung_slsi-cm/exynos/libexynosutils \
+	$(TOP)/hardware/samsung_slsi-cm/exynos/libmpp
+
+LOCAL_ADDITIONAL_DEPENDENCIES := \
+	$(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+
+LOCAL_SRC_FILES := \
+	gsc_sw_test.cpp
+
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE := gsc_sw_test
+include $(BUILD_EXECUTABLE)
+
 endif
@@ -0,0 +1,370 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * gsc_arbiter_bench - contention of the M2M units, arbiter against polling
+ *
+ * usage: gsc_arbiter_bench [-p processes] [-n jobs] [-t hold_us] [-w wait_us]
+ *                          [-d dir]
+ *
+ * Each of the processes takes a unit -n times and holds it for hold_us,
+ * as a blit would. The units are mocked by files in dir that are opened
+ * with an exclusive flock(), which fails while another process holds the
+ * unit, like the video nodes do. The same load is run once through the
+ * arbiter and once by polling the units every GSC_WAITING_TIME_FOR_TRYLOCK,
+ * as m_gsc_find_and_create() does without it.
+ *
+ * Built with its own copy of the arbiter, whose table is moved to
+ * /data/local/tmp by GSC_ARBITER_PATH. Also checks that a unit left behind
+ * by a killed process is handed out again to a caller that does not wait,
+ * and that a waiter for a busy unit does not hold up a caller that can use
+ * a free one.
+ */
+
+#include <sys/file.h>
+#include <sys/wait.h>
+#include "libgscaler_obj.h"
+
+struct bench_result {
+    unsigned int jobs;
+    unsigned int timeouts;
+    long long total_wait;
+    long long max_wait;
+};
+
+static const char *bench_dir = "/data/local/tmp";
+
+static long long bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* The mocked video node: opening fails while another process holds it */
+static int bench_dev_open(int unit)
+{
+    char path[128];
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/gsc_arbiter_bench.dev%d", bench_dir, unit);
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return -1;
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static unsigned int bench_mask(void)
+{
+    unsigned int mask = 0;
+    int i;
+
+    /* the units m_gsc_find_and_create() may pick */
+    for (i = 1; i < NUM_OF_GSC_HW; i++)
+        mask |= 1 << i;
+
+    return mask;
+}
+
+/* Returns the open unit, or -1 after wait_us */
+static int bench_take_poll(unsigned int mask, unsigned int wait_us, int *unit)
+{
+    unsigned int slept = 0;
+    int fd, i;
+
+    do {
+        for (i = 0; i < NUM_OF_GSC_HW; i++) {
+            if (!(mask & (1 << i)))
+                continue;
+            fd = bench_dev_open(i);
+            if (fd >= 0) {
+                *unit = i;
+                return fd;
+            }
+        }
+        if (slept < wait_us) {
+            usleep(GSC_WAITING_TIME_FOR_TRYLOCK);
+            slept += GSC_WAITING_TIME_FOR_TRYLOCK;
+        }
+    } while (slept < wait_us);
+
+    return -1;
+}
+
+static int bench_take_arbiter(unsigned int mask, int priority,
+                              unsigned int wait_us, int *unit)
+{
+    int fd;
+
+    *unit = gsc_arbiter_acquire(priority, mask, wait_us);
+    if (*unit < 0)
+        return -1;
+
+    fd = bench_dev_open(*unit);
+    if (fd < 0)
+        gsc_arbiter_release(*unit, true);
+
+    return fd;
+}
+
+static void bench_worker(int out, bool arbiter, int priority,
+                         unsigned int jobs, unsigned int hold_us,
+                         unsigned int wait_us)
+{
+    struct bench_result r;
+    unsigned int mask = bench_mask();
+    long long start, ns;
+    unsigned int i;
+    int fd, unit;
+
+    memset(&r, 0, sizeof(r));
+    for (i = 0; i < jobs; i++) {
+        start = bench_now();
+        if (arbiter)
+            fd = bench_take_arbiter(mask, priority, wait_us, &unit);
+        else
+            fd = bench_take_poll(mask, wait_us, &unit);
+        ns = bench_now() - start;
+
+        if (fd < 0) {
+            r.timeouts++;
+            continue;
+        }
+
+        r.jobs++;
+        r.total_wait += ns;
+        if (ns > r.max_wait)
+            r.max_wait = ns;
+
+        usleep(hold_us);
+
+        close(fd);
+        if (arbiter)
+            gsc_arbiter_release(unit, false);
+    }
+
+    if (write(out, &r, sizeof(r)) != sizeof(r))
+        _exit(1);
+}
+
+static void bench_run(const char *name, bool arbiter, unsigned int processes,
+                      unsigned int jobs, unsigned int hold_us,
+                      unsigned int wait_us)
+{
+    struct bench_result sum, r;
+    long long start, ns;
+    unsigned int i;
+    int fds[2];
+    pid_t pid;
+
+    if (pipe(fds) < 0)
+        return;
+
+    start = bench_now();
+    for (i = 0; i < processes; i++) {
+        pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            /* one display client, the rest in the normal class */
+            bench_worker(fds[1], arbiter,
+                         (i == 0) ? GSC_PRIORITY_DISPLAY : GSC_PRIORITY_NORMAL,
+                         jobs, hold_us, wait_us);
+            _exit(0);
+        }
+    }
+    close(fds[1]);
+
+    memset(&sum, 0, sizeof(sum));
+    while (read(fds[0], &r, sizeof(r)) == sizeof(r)) {
+        sum.jobs += r.jobs;
+        sum.timeouts += r.timeouts;
+        sum.total_wait += r.total_wait;
+        if (r.max_wait > sum.max_wait)
+            sum.max_wait = r.max_wait;
+    }
+    close(fds[0]);
+    while (wait(NULL) > 0)
+        ;
+    ns = bench_now() - start;
+
+    if (!sum.jobs) {
+        printf("  %-10s all %u jobs timed out\n", name, sum.timeouts);
+        return;
+    }
+
+    printf("  %-10s wait avg %8.1f us  max %8.1f us  %7.1f jobs/s  "
+           "timeouts %u\n", name, sum.total_wait / 1000.0 / sum.jobs,
+           sum.max_wait / 1000.0, sum.jobs * 1000000000.0 / ns, sum.timeouts);
+}
+
+/* A unit held by a process that was killed is handed out again at once */
+static bool bench_dead_owner(void)
+{
+    unsigned int mask = bench_mask();
+    int fds[2], unit, got, i;
+    char c;
+    pid_t pid;
+
+    if (pipe(fds) < 0)
+        return false;
+
+    pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        for (i = 0; i < NUM_OF_GSC_HW; i++) {
+            if (gsc_arbiter_acquire(GSC_PRIORITY_NORMAL, mask, 0) < 0)
+                break;
+        }
+        c = 1;
+        if (write(fds[1], &c, 1) != 1)
+            _exit(1);
+        pause();
+        _exit(0);
+    }
+    close(fds[1]);
+
+    /* wait until the child owns every unit, then kill it */
+    got = read(fds[0], &c, 1);
+    close(fds[0]);
+    unit = gsc_arbiter_acquire(GSC_PRIORITY_NORMAL, mask, 0);
+    if (unit >= 0)
+        gsc_arbiter_release(unit, false);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+
+    if ((got != 1) || (unit != -ETIMEDOUT)) {
+        printf("  units were not all taken (%d)\n", unit);
+        return false;
+    }
+
+    unit = gsc_arbiter_acquire(GSC_PRIORITY_NORMAL, mask, 0);
+    if (unit < 0)
+        return false;
+    gsc_arbiter_release(unit, false);
+
+    return true;
+}
+
+/* A queued waiter for a busy unit does not delay a caller of another one */
+static bool bench_masked_head(void)
+{
+    int fds[2], held, unit;
+    long long start, ns;
+    char c;
+    pid_t pid;
+
+    held = gsc_arbiter_acquire(GSC_PRIORITY_DISPLAY, 1 << 1, 0);
+    if (held != 1)
+        return false;
+
+    if (pipe(fds) < 0) {
+        gsc_arbiter_release(held, false);
+        return false;
+    }
+
+    pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        c = 1;
+        if (write(fds[1], &c, 1) != 1)
+            _exit(1);
+        unit = gsc_arbiter_acquire(GSC_PRIORITY_DISPLAY, 1 << 1, 5000000);
+        if (unit >= 0)
+            gsc_arbiter_release(unit, false);
+        _exit(unit == 1 ? 0 : 1);
+    }
+    close(fds[1]);
+
+    /* let the child queue for unit 1 */
+    if (read(fds[0], &c, 1) != 1)
+        c = 0;
+    close(fds[0]);
+    usleep(50000);
+
+    start = bench_now();
+    unit = gsc_arbiter_acquire(GSC_PRIORITY_NORMAL, 1 << 2, 1000000);
+    ns = bench_now() - start;
+    if (unit >= 0)
+        gsc_arbiter_release(unit, false);
+
+    gsc_arbiter_release(held, false);
+    waitpid(pid, NULL, 0);
+
+    if ((unit != 2) || (ns > 50000000LL)) {
+        printf("  got unit %d after %.1f us\n", unit, ns / 1000.0);
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int processes = 4;
+    unsigned int jobs = 100;
+    unsigned int hold_us = 2000;
+    unsigned int wait_us = 1000000;
+    bool ok, masked;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:n:t:w:d:")) != -1) {
+        switch (opt) {
+        case 'p':
+            processes = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            jobs = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            hold_us = strtoul(optarg, NULL, 0);
+            break;
+        case 'w':
+            wait_us = strtoul(optarg, NULL, 0);
+            break;
+        case 'd':
+            bench_dir = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-p processes] [-n jobs] [-t hold_us] "
+                    "[-w wait_us] [-d dir]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    /* start from an empty table, the arbiter creates it on first use */
+    unlink(GSC_ARBITER_PATH);
+
+    printf("%u processes, %u jobs each, held %u us, %d units\n",
+           processes, jobs, hold_us, __builtin_popcount(bench_mask()));
+    bench_run("arbiter", true, processes, jobs, hold_us, wait_us);
+    bench_run("polling", false, processes, jobs, hold_us, wait_us);
+
+    ok = bench_dead_owner();
+    printf("  %-10s %s\n", "dead owner", ok ? "ok" : "FAILED");
+
+    masked = bench_masked_head();
+    printf("  %-10s %s\n", "masked head", masked ? "ok" : "FAILED");
+
+    unlink(GSC_ARBITER_PATH);
+
+    return (ok && masked) ? 0 : 1;
+}
@@ -0,0 +1,237 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * gsc_sw_test - functional checks of the CPU backend
+ *
+ * usage: gsc_sw_test
+ *
+ * Runs CSwMpp on user pointer buffers, so it needs no unit and no ION
+ * driver. Checks cropped copies, nearest sample NV12 scaling against a
+ * reference, the conversions the backend must refuse, and that cached
+ * dma-bufs are left to the units once SYNC_FOR_CPU is known not to work.
+ * Exits with 1 if any check fails.
+ */
+
+#include <sys/mman.h>
+#include "libgscaler_obj.h"
+
+/* user pointers are passed in 32 bit fields */
+#ifdef MAP_32BIT
+#define TEST_MAP_FLAGS      (MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT)
+#else
+#define TEST_MAP_FLAGS      (MAP_PRIVATE | MAP_ANONYMOUS)
+#endif
+
+#define TEST_BUF_SIZE       (1 << 20)
+
+static unsigned int test_failures;
+
+#define TEST_CHECK(cond)                                                \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            printf("  FAIL %s:%d: %s\n", __func__, __LINE__, #cond);    \
+            test_failures++;                                            \
+        }                                                               \
+    } while (0)
+
+static unsigned char *test_src, *test_dst;
+
+static void test_img(exynos_mpp_img *img, unsigned char *buf, int format,
+                     unsigned int fw, unsigned int fh, unsigned int x,
+                     unsigned int y, unsigned int w, unsigned int h)
+{
+    memset(img, 0, sizeof(*img));
+    img->fw = fw;
+    img->fh = fh;
+    img->x = x;
+    img->y = y;
+    img->w = w;
+    img->h = h;
+    img->format = format;
+    img->yaddr = (uint32_t)(uintptr_t)buf;
+    img->mem_type = GSC_MEM_USERPTR;
+    img->acquireFenceFd = -1;
+    img->releaseFenceFd = -1;
+}
+
+/* A cropped RGBA copy lands at the destination crop and nowhere else */
+static void test_copy_crop(void)
+{
+    const unsigned int fw = 64, fh = 32;
+    exynos_mpp_img src, dst;
+    unsigned int x, y;
+    bool inside;
+    uint32_t *s = (uint32_t *)test_src, *d = (uint32_t *)test_dst;
+    CSwMpp sw;
+
+    for (x = 0; x < fw * fh; x++)
+        s[x] = 0x01000000 * (x & 0xff) + x;
+    memset(test_dst, 0xaa, fw * fh * 4);
+
+    test_img(&src, test_src, HAL_PIXEL_FORMAT_RGBA_8888, fw, fh, 8, 4, 32, 16);
+    test_img(&dst, test_dst, HAL_PIXEL_FORMAT_RGBA_8888, fw, fh, 16, 8, 32, 16);
+    TEST_CHECK(sw.RunMpp(&sw, &src, &dst) == 0);
+
+    for (y = 0; y < fh; y++) {
+        for (x = 0; x < fw; x++) {
+            inside = (x >= 16) && (x < 48) && (y >= 8) && (y < 24);
+            if (inside)
+                TEST_CHECK(d[y * fw + x] == s[(y - 4) * fw + (x - 8)]);
+            else
+                TEST_CHECK(d[y * fw + x] == 0xaaaaaaaa);
+        }
+    }
+}
+
+/* Reference nearest sample of one plane, by pixel centres */
+static void test_ref_plane(unsigned char *dst, unsigned int dst_stride,
+                           unsigned int dst_w, unsigned int dst_h,
+                           const unsigned char *src, unsigned int src_stride,
+                           unsigned int src_w, unsigned int src_h,
+                           unsigned int bpp)
+{
+    unsigned int i, j, sx, sy;
+
+    for (j = 0; j < dst_h; j++) {
+        sy = (2 * j + 1) * src_h / (2 * dst_h);
+        for (i = 0; i < dst_w; i++) {
+            sx = (2 * i + 1) * src_w / (2 * dst_w);
+            memcpy(dst + j * dst_stride + i * bpp,
+                   src + sy * src_stride + sx * bpp, bpp);
+        }
+    }
+}
+
+/* NV12 down and up: both planes match the reference, chroma as pairs */
+static void test_nv12_scale_one(unsigned int sw_, unsigned int sh,
+                                unsigned int dw, unsigned int dh)
+{
+    exynos_mpp_img src, dst;
+    unsigned char *ref;
+    unsigned int i;
+    CSwMpp sw;
+
+    for (i = 0; i < sw_ * sh * 3 / 2; i++)
+        test_src[i] = (i * 7 + i / sw_) & 0xff;
+    memset(test_dst, 0, dw * dh * 3 / 2);
+
+    test_img(&src, test_src, HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP,
+             sw_, sh, 0, 0, sw_, sh);
+    test_img(&dst, test_dst, HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP,
+             dw, dh, 0, 0, dw, dh);
+    TEST_CHECK(sw.RunMpp(&sw, &src, &dst) == 0);
+
+    ref = new unsigned char[dw * dh * 3 / 2];
+    test_ref_plane(ref, dw, dw, dh, test_src, sw_, sw_, sh, 1);
+    test_ref_plane(ref + dw * dh, dw, dw / 2, dh / 2,
+                   test_src + sw_ * sh, sw_, sw_ / 2, sh / 2, 2);
+    TEST_CHECK(!memcmp(ref, test_dst, dw * dh));
+    TEST_CHECK(!memcmp(ref + dw * dh, test_dst + dw * dh, dw * dh / 2));
+    delete[] ref;
+}
+
+static void test_nv12_scale(void)
+{
+    test_nv12_scale_one(64, 32, 32, 16);
+    test_nv12_scale_one(64, 32, 40, 18);
+    test_nv12_scale_one(16, 8, 48, 24);
+}
+
+/* Rotation, a format change and half chroma samples are not done */
+static void test_refuse(void)
+{
+    exynos_mpp_img src, dst;
+
+    test_img(&src, test_src, HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP,
+             64, 32, 0, 0, 64, 32);
+    test_img(&dst, test_dst, HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP,
+             64, 32, 0, 0, 64, 32);
+    TEST_CHECK(CSwMpp::m_sw_supports(&src, &dst));
+
+    dst.rot = HAL_TRANSFORM_ROT_90;
+    TEST_CHECK(!CSwMpp::m_sw_supports(&src, &dst));
+    dst.rot = 0;
+
+    dst.x = 1;
+    TEST_CHECK(!CSwMpp::m_sw_supports(&src, &dst));
+    dst.x = 0;
+
+    dst.format = HAL_PIXEL_FORMAT_RGBA_8888;
+    TEST_CHECK(!CSwMpp::m_sw_supports(&src, &dst));
+}
+
+/* Cached dma-bufs need SYNC_FOR_CPU, other buffers do not */
+static void test_cpu_sync(void)
+{
+    exynos_mpp_img src, dst;
+    CSwMpp sw;
+
+    test_img(&src, test_src, HAL_PIXEL_FORMAT_RGBA_8888, 64, 32, 0, 0, 64, 32);
+    test_img(&dst, test_dst, HAL_PIXEL_FORMAT_RGBA_8888, 64, 32, 0, 0, 64, 32);
+    src.mem_type = GSC_MEM_DMABUF;
+    src.cacheable = 1;
+
+    TEST_CHECK(sw.m_sw_can_run(&src, &dst));
+    sw.cpu_sync_ok = false;
+    TEST_CHECK(!sw.m_sw_can_run(&src, &dst));
+
+    src.cacheable = 0;
+    TEST_CHECK(sw.m_sw_can_run(&src, &dst));
+    src.mem_type = GSC_MEM_USERPTR;
+    src.cacheable = 1;
+    TEST_CHECK(sw.m_sw_can_run(&src, &dst));
+}
+
+struct test_case {
+    const char *name;
+    void (*run)(void);
+};
+
+static const struct test_case test_cases[] = {
+    { "copy_crop",          test_copy_crop },
+    { "nv12_scale",         test_nv12_scale },
+    { "refuse",             test_refuse },
+    { "cpu_sync",           test_cpu_sync },
+};
+
+int main(void)
+{
+    unsigned int i, failures;
+
+    test_src = (unsigned char *)mmap(NULL, TEST_BUF_SIZE,
+                                     PROT_READ | PROT_WRITE, TEST_MAP_FLAGS,
+                                     -1, 0);
+    test_dst = (unsigned char *)mmap(NULL, TEST_BUF_SIZE,
+                                     PROT_READ | PROT_WRITE, TEST_MAP_FLAGS,
+                                     -1, 0);
+    if ((test_src == MAP_FAILED) || (test_dst == MAP_FAILED)) {
+        fprintf(stderr, "cannot map the test buffers\n");
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(test_cases) / sizeof(test_cases[0]); i++) {
+        failures = test_failures;
+        test_cases[i].run();
+        printf("%-24s %s\n", test_cases[i].name,
+               (test_failures == failures) ? "ok" : "FAILED");
+    }
+
+    munmap(test_src, TEST_BUF_SIZE);
+    munmap(test_dst, TEST_BUF_SIZE);
+
+    return test_failures ? 1 : 0;
+}
@@ -0,0 +1,353 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * gsc_tile_test - checks the tile geometry against a single pass
+ *
+ * usage: gsc_tile_test
+ *
+ * Needs no unit, it runs on a build host too. For each axis case the
+ * tiles of m_gsc_tile_axis() are scaled with a model of the scaler and
+ * compared with the same model run over the whole axis at once. The model
+ * is a Lanczos filter with the tap count of the scaler (8 horizontal, 4
+ * vertical) that clamps at the edges of its input, as the hardware reads
+ * only its crop; it is not the exact coefficient set. Printed per case:
+ * tiles, how many output pixels differ, by how much, and how far from a
+ * seam.
+ *
+ * Fails if the tiles do not cover the axis or break the limits, if a seam
+ * is off the common grid, if an unscaled case differs at all, or if any
+ * output pixel differs farther from a seam than the filter reaches. Cases
+ * whose grids do not meet often enough must be refused. Then checks that
+ * m_gsc_make_tile() places the tiles of rotated and flipped conversions
+ * where a single pass would put those pixels.
+ */
+
+#include <math.h>
+#include "libgscaler_obj.h"
+
+static unsigned int test_failures;
+
+#define TEST_CHECK(cond)                                                \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            printf("  FAIL %s:%d: %s\n", __func__, __LINE__, #cond);    \
+            test_failures++;                                            \
+        }                                                               \
+    } while (0)
+
+struct axis_case {
+    unsigned int src_len;
+    unsigned int out_len;
+    unsigned int max_len;
+    int taps;
+    bool refused;                   /* the grids do not meet within max_len */
+};
+
+static const struct axis_case axis_cases[] = {
+    /* 8K to 4K and back, on the grid every 2 pixels */
+    { 7680, 3840, GSC_MAX_CROP_W, 8, false },
+    { 3840, 7680, GSC_MAX_CROP_W, 8, false },
+    /* not scaled */
+    { 8192, 8192, GSC_MAX_CROP_W, 8, false },
+    { 6000, 6000, GSC_MAX_CROP_H, 4, false },
+    /* the grids meet only every few hundred pixels */
+    { 7500, 4900, GSC_MAX_CROP_W, 8, false },
+    { 5000, 3300, GSC_MAX_CROP_H, 4, false },
+    /* the grids never meet within the limits */
+    { 8190, 1081, GSC_MAX_CROP_W, 8, true },
+    { 5000, 4999, GSC_MAX_CROP_W, 8, true },
+    { 4000, 3501, GSC_MAX_CROP_H, 4, true },
+    /* rotated limits */
+    { 3000, 2500, GSC_MAX_ROT_CROP_W, 8, false },
+    { 4096, 2160, GSC_MAX_ROT_CROP_H, 4, false },
+};
+
+static double test_lanczos(double x, int a)
+{
+    if (x == 0.0)
+        return 1.0;
+    if ((x <= -a) || (x >= a))
+        return 0.0;
+
+    return a * sin(M_PI * x) * sin(M_PI * x / a) / (M_PI * M_PI * x * x);
+}
+
+/*
+ * One output pixel at source position pos, reading only [first, last].
+ * Pixel centres are at +0.5, as the scaler maps them.
+ */
+static int test_sample(const unsigned char *src, int first, int last,
+                       double pos, int taps)
+{
+    int base = (int)floor(pos), i, k;
+    double sum = 0.0, wsum = 0.0, w;
+
+    for (k = -taps / 2 + 1; k <= taps / 2; k++) {
+        i = base + k;
+        w = test_lanczos(pos - i, taps / 2);
+        if (i < first)
+            i = first;
+        if (i > last)
+            i = last;
+        sum += w * src[i];
+        wsum += w;
+    }
+
+    sum /= wsum;
+    if (sum < 0.0)
+        return 0;
+    if (sum > 255.0)
+        return 255;
+
+    return (int)(sum + 0.5);
+}
+
+/* Scales src[s0, s1) into out[o0, o1), starting at phase 0 like a pass */
+static void test_pass(const unsigned char *src, unsigned int s0,
+                      unsigned int s1, int *out, unsigned int o0,
+                      unsigned int o1, int taps)
+{
+    double ratio = (double)(s1 - s0) / (o1 - o0);
+    unsigned int x;
+
+    for (x = o0; x < o1; x++)
+        out[x] = test_sample(src, s0, s1 - 1,
+                             s0 + (x - o0 + 0.5) * ratio - 0.5, taps);
+}
+
+static void test_axis(const struct axis_case *c)
+{
+    unsigned int sb[GSC_MAX_TILES + 1], ob[GSC_MAX_TILES + 1];
+    unsigned char *src;
+    int *ref, *tiled;
+    unsigned int x, k, dist, far = 0, diffs = 0, max_diff = 0, reach;
+    int n, d;
+
+    n = m_gsc_tile_axis(c->src_len, c->out_len, c->max_len, sb, ob);
+    if (c->refused || (n <= 0)) {
+        printf("  %4u -> %4u max %4u taps %d: %s\n", c->src_len, c->out_len,
+               c->max_len, c->taps, (n <= 0) ? "refused" : "tiled");
+        TEST_CHECK(c->refused == (n <= 0));
+        return;
+    }
+
+    TEST_CHECK((sb[0] == 0) && (ob[0] == 0));
+    TEST_CHECK((sb[n] == c->src_len) && (ob[n] == c->out_len));
+    for (k = 0; k < (unsigned int)n; k++) {
+        TEST_CHECK((sb[k + 1] > sb[k]) && (ob[k + 1] > ob[k]));
+        TEST_CHECK(sb[k + 1] - sb[k] <= c->max_len);
+        TEST_CHECK(ob[k + 1] - ob[k] <= c->max_len);
+        TEST_CHECK((unsigned long long)sb[k] * c->out_len ==
+                   (unsigned long long)ob[k] * c->src_len);
+    }
+
+    src = new unsigned char[c->src_len];
+    ref = new int[c->out_len];
+    tiled = new int[c->out_len];
+
+    /* noise is the worst case for a seam */
+    srand(c->src_len * 31 + c->out_len);
+    for (x = 0; x < c->src_len; x++)
+        src[x] = rand() & 0xff;
+
+    test_pass(src, 0, c->src_len, ref, 0, c->out_len, c->taps);
+    for (k = 0; k < (unsigned int)n; k++)
+        test_pass(src, sb[k], sb[k + 1], tiled, ob[k], ob[k + 1], c->taps);
+
+    for (x = 0; x < c->out_len; x++) {
+        d = abs(ref[x] - tiled[x]);
+        if (!d)
+            continue;
+        diffs++;
+        if ((unsigned int)d > max_diff)
+            max_diff = d;
+        dist = c->out_len;
+        for (k = 1; k < (unsigned int)n; k++) {
+            if ((unsigned int)abs((int)x - (int)ob[k]) < dist)
+                dist = abs((int)x - (int)ob[k]);
+        }
+        if (dist > far)
+            far = dist;
+    }
+
+    printf("  %4u -> %4u max %4u taps %d: %d tiles, %5u px differ "
+           "by up to %3u, at most %u px from a seam\n",
+           c->src_len, c->out_len, c->max_len, c->taps, n,
+           diffs, max_diff, far);
+
+    /* half the taps, in output pixels when upscaling, and the rounding */
+    reach = (c->taps / 2) * ((c->out_len + c->src_len - 1) / c->src_len) + 1;
+    if (c->src_len == c->out_len)
+        TEST_CHECK(diffs == 0);
+    TEST_CHECK(far <= reach);
+
+    delete[] src;
+    delete[] ref;
+    delete[] tiled;
+}
+
+static void test_axes(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(axis_cases) / sizeof(axis_cases[0]); i++)
+        test_axis(&axis_cases[i]);
+}
+
+struct place_case {
+    unsigned int src_w, src_h;
+    unsigned int dst_w, dst_h;      /* destination crop, after rotation */
+    unsigned int rot;
+};
+
+static const struct place_case place_cases[] = {
+    { 7680, 4320, 3840, 2160, 0 },
+    { 7680, 4320, 3840, 2160, HAL_TRANSFORM_FLIP_H },
+    { 7680, 4320, 3840, 2160, HAL_TRANSFORM_FLIP_V },
+    { 7680, 4320, 3840, 2160, HAL_TRANSFORM_ROT_180 },
+    { 4000, 3000, 2400, 3200, HAL_TRANSFORM_ROT_90 },
+    { 4000, 3000, 2400, 3200, HAL_TRANSFORM_ROT_270 },
+    { 6000, 4000, 4000, 6000, HAL_TRANSFORM_ROT_90 | HAL_TRANSFORM_FLIP_H },
+};
+
+struct test_rect {
+    unsigned int x0, y0, x1, y1;
+};
+
+/*
+ * Where a single pass writes the output rect [x0, x1) x [y0, y1), given in
+ * source orientation: flips first, then the clockwise rotation.
+ */
+static struct test_rect test_place(struct test_rect r, unsigned int out_w,
+                                   unsigned int out_h, unsigned int rot)
+{
+    struct test_rect p = r;
+
+    if (rot & HAL_TRANSFORM_FLIP_H) {
+        p.x0 = out_w - r.x1;
+        p.x1 = out_w - r.x0;
+    }
+    if (rot & HAL_TRANSFORM_FLIP_V) {
+        p.y0 = out_h - r.y1;
+        p.y1 = out_h - r.y0;
+    }
+    if (rot & HAL_TRANSFORM_ROT_90) {
+        r = p;
+        p.x0 = out_h - r.y1;
+        p.x1 = out_h - r.y0;
+        p.y0 = r.x0;
+        p.y1 = r.x1;
+    }
+
+    return p;
+}
+
+static void test_place_case(const struct place_case *c)
+{
+    unsigned int sx[GSC_MAX_TILES + 1], sy[GSC_MAX_TILES + 1];
+    unsigned int ox[GSC_MAX_TILES + 1], oy[GSC_MAX_TILES + 1];
+    bool rot90 = !!(c->rot & HAL_TRANSFORM_ROT_90);
+    unsigned int out_w = rot90 ? c->dst_h : c->dst_w;
+    unsigned int out_h = rot90 ? c->dst_w : c->dst_h;
+    unsigned long long area = 0;
+    exynos_mpp_img src, dst;
+    exynos_gsc_job job;
+    struct test_rect r, p;
+    int nx, ny, i, j;
+
+    memset(&src, 0, sizeof(src));
+    memset(&dst, 0, sizeof(dst));
+    src.x = 16;
+    src.y = 8;
+    src.w = c->src_w;
+    src.h = c->src_h;
+    dst.x = 32;
+    dst.y = 4;
+    dst.w = c->dst_w;
+    dst.h = c->dst_h;
+    dst.rot = c->rot;
+
+    nx = m_gsc_tile_axis(src.w, out_w,
+                         rot90 ? GSC_MAX_ROT_CROP_W : GSC_MAX_CROP_W, sx, ox);
+    ny = m_gsc_tile_axis(src.h, out_h,
+                         rot90 ? GSC_MAX_ROT_CROP_H : GSC_MAX_CROP_H, sy, oy);
+    TEST_CHECK((nx > 0) && (ny > 0));
+    if ((nx <= 0) || (ny <= 0))
+        return;
+
+    for (j = 0; j < ny; j++) {
+        for (i = 0; i < nx; i++) {
+            m_gsc_make_tile(&job, &src, &dst, sx[i], sx[i + 1], sy[j],
+                            sy[j + 1], ox[i], ox[i + 1], oy[j], oy[j + 1]);
+
+            TEST_CHECK(job.src.x == src.x + sx[i]);
+            TEST_CHECK(job.src.y == src.y + sy[j]);
+            TEST_CHECK(job.src.w == sx[i + 1] - sx[i]);
+            TEST_CHECK(job.src.h == sy[j + 1] - sy[j]);
+
+            r.x0 = ox[i];
+            r.x1 = ox[i + 1];
+            r.y0 = oy[j];
+            r.y1 = oy[j + 1];
+            p = test_place(r, out_w, out_h, c->rot);
+            TEST_CHECK(job.dst.x == dst.x + p.x0);
+            TEST_CHECK(job.dst.y == dst.y + p.y0);
+            TEST_CHECK(job.dst.w == p.x1 - p.x0);
+            TEST_CHECK(job.dst.h == p.y1 - p.y0);
+            TEST_CHECK(job.dst.rot == c->rot);
+
+            TEST_CHECK(job.dst.x + job.dst.w <= dst.x + dst.w);
+            TEST_CHECK(job.dst.y + job.dst.h <= dst.y + dst.h);
+            area += (unsigned long long)job.dst.w * job.dst.h;
+        }
+    }
+
+    /* the tiles lie inside the crop and are disjoint, so they cover it */
+    TEST_CHECK(area == (unsigned long long)dst.w * dst.h);
+}
+
+static void test_placement(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(place_cases) / sizeof(place_cases[0]); i++)
+        test_place_case(&place_cases[i]);
+}
+
+struct test_case {
+    const char *name;
+    void (*run)(void);
+};
+
+static const struct test_case test_cases[] = {
+    { "axis_vs_single_pass",    test_axes },
+    { "tile_placement",         test_placement },
+};
+
+int main(void)
+{
+    unsigned int i, failures;
+
+    for (i = 0; i < sizeof(test_cases) / sizeof(test_cases[0]); i++) {
+        failures = test_failures;
+        test_cases[i].run();
+        printf("%-24s %s\n", test_cases[i].name,
+               (test_failures == failures) ? "ok" : "FAILED");
+    }
+
+    return test_failures ? 1 : 0;
+}
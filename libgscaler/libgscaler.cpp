@@ -30,11 +30,22 @@
 
 void *exynos_gsc_create(void)
 {
+    return exynos_gsc_create_with_priority(GSC_PRIORITY_NORMAL);
+}
+
+void *exynos_gsc_create_with_priority(int priority)
+{
+    if ((priority < 0) || (priority >= GSC_PRIORITY_MAX)) {
+        ALOGE("%s::fail:: priority is not valid(%d) ", __func__, priority);
+        return NULL;
+    }
+
     CGscaler *gsc = new CGscaler(GSC_M2M_MODE);
     if (!gsc) {
         ALOGE("%s:: failed to allocate Gscaler handle", __func__);
         return NULL;
     }
+    gsc->priority = priority;
     if (gsc->m_gsc_find_and_create(gsc) == false) {
         ALOGE("%s::m_exynos_gsc_find_and_create() fail", __func__);
         delete gsc;
@@ -162,6 +173,10 @@ int exynos_gsc_set_csc_property(
         return -1;
     }
 
+    if (gsc->eq_auto != eq_auto || gsc->range_full != range_full ||
+        gsc->v4l2_colorspace != v4l2_colorspace)
+        gsc->dst_info.dirty = true;
+
     gsc->eq_auto = eq_auto;
     gsc->range_full = range_full;
     gsc->v4l2_colorspace = v4l2_colorspace;
@@ -190,6 +205,18 @@ int exynos_gsc_set_src_format(
         ALOGE("%s::handle == NULL() fail", __func__);
         return -1;
     }
+    /* setting the same format again does not reconfigure the queue */
+    if (gsc->src_info.width            != width ||
+        gsc->src_info.height           != height ||
+        gsc->src_info.crop_left        != crop_left ||
+        gsc->src_info.crop_top         != crop_top ||
+        gsc->src_info.crop_width       != crop_width ||
+        gsc->src_info.crop_height      != crop_height ||
+        gsc->src_info.v4l2_colorformat != v4l2_colorformat ||
+        gsc->src_info.cacheable        != cacheable ||
+        gsc->src_info.mode_drm         != mode_drm)
+        gsc->src_info.dirty            = true;
+
     gsc->src_info.width            = width;
     gsc->src_info.height           = height;
     gsc->src_info.crop_left        = crop_left;
@@ -199,7 +226,6 @@ int exynos_gsc_set_src_format(
     gsc->src_info.v4l2_colorformat = v4l2_colorformat;
     gsc->src_info.cacheable        = cacheable;
     gsc->src_info.mode_drm         = mode_drm;
-    gsc->src_info.dirty            = true;
 
     Exynos_gsc_Out();
 
@@ -226,6 +252,18 @@ int exynos_gsc_set_dst_format(
         return -1;
     }
 
+    /* setting the same format again does not reconfigure the queue */
+    if (gsc->dst_info.width            != width ||
+        gsc->dst_info.height           != height ||
+        gsc->dst_info.crop_left        != crop_left ||
+        gsc->dst_info.crop_top         != crop_top ||
+        gsc->dst_info.crop_width       != crop_width ||
+        gsc->dst_info.crop_height      != crop_height ||
+        gsc->dst_info.v4l2_colorformat != v4l2_colorformat ||
+        gsc->dst_info.cacheable        != cacheable ||
+        gsc->dst_info.mode_drm         != mode_drm)
+        gsc->dst_info.dirty            = true;
+
     gsc->dst_info.width            = width;
     gsc->dst_info.height           = height;
     gsc->dst_info.crop_left        = crop_left;
@@ -233,7 +271,6 @@ int exynos_gsc_set_dst_format(
     gsc->dst_info.crop_width       = crop_width;
     gsc->dst_info.crop_height      = crop_height;
     gsc->dst_info.v4l2_colorformat = v4l2_colorformat;
-    gsc->dst_info.dirty            = true;
     gsc->dst_info.cacheable        = cacheable;
     gsc->dst_info.mode_drm         = mode_drm;
 
@@ -265,6 +302,11 @@ int exynos_gsc_set_rotation(
     if(new_rotation < 0)
         new_rotation = -new_rotation;
 
+    if (gsc->dst_info.rotation        != new_rotation ||
+        gsc->dst_info.flip_horizontal != flip_horizontal ||
+        gsc->dst_info.flip_vertical   != flip_vertical)
+        gsc->dst_info.dirty           = true;
+
     gsc->dst_info.rotation        = new_rotation;
     gsc->dst_info.flip_horizontal = flip_horizontal;
     gsc->dst_info.flip_vertical   = flip_vertical;
@@ -272,6 +314,35 @@ int exynos_gsc_set_rotation(
     return 0;
 }
 
+int exynos_gsc_set_queue_depth(
+    void *handle,
+    int   depth)
+{
+    Exynos_gsc_In();
+
+    CGscaler *gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+
+    if ((depth < 1) || (depth > GSC_M2M_MAX_QUEUE_DEPTH)) {
+        ALOGE("%s::queue depth(%d) is not valid", __func__, depth);
+        return -1;
+    }
+
+    if (depth != gsc->queue_depth) {
+        gsc->queue_depth = depth;
+        /* the buffer slots are requested again by the next run */
+        gsc->src_info.dirty = true;
+        gsc->dst_info.dirty = true;
+    }
+
+    Exynos_gsc_Out();
+
+    return 0;
+}
+
 int exynos_gsc_set_src_addr(
     void *handle,
     void *addr[3],
@@ -488,6 +559,289 @@ int exynos_gsc_wait_frame_done_exclusive(void *handle)
     return ret;
 }
 
+int exynos_gsc_run_batch(void *handle, exynos_gsc_job *jobs, int count,
+    exynos_gsc_batch_stats *stats)
+{
+    Exynos_gsc_In();
+
+    exynos_gsc_batch_stats local_stats;
+    int ret;
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+
+    if ((jobs == NULL) || (count <= 0)) {
+        ALOGE("%s::no jobs", __func__);
+        return -1;
+    }
+#ifdef USES_SCALER
+    if (gsc->gsc_id >= HW_SCAL0) {
+        Exynos_gsc_Out();
+        return -1;
+    }
+#endif
+    if (gsc->mode != GSC_M2M_MODE) {
+        ALOGE("%s::batches need an M2M handle", __func__);
+        return -1;
+    }
+
+    ret = gsc->m_gsc_m2m_run_batch(handle, jobs, count,
+                                   stats ? stats : &local_stats);
+
+    Exynos_gsc_Out();
+
+    return ret;
+}
+
+int exynos_gsc_convert_tiled(void *handle,
+    exynos_mpp_img *src_img, exynos_mpp_img *dst_img)
+{
+    Exynos_gsc_In();
+
+    int ret;
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+#ifdef USES_SCALER
+    if (gsc->gsc_id >= HW_SCAL0) {
+        Exynos_gsc_Out();
+        return -1;
+    }
+#endif
+    if (gsc->mode != GSC_M2M_MODE) {
+        ALOGE("%s::tiling needs an M2M handle", __func__);
+        return -1;
+    }
+
+    ret = gsc->m_gsc_m2m_run_tiled(handle, src_img, dst_img);
+
+    Exynos_gsc_Out();
+
+    return ret;
+}
+
+int exynos_gsc_set_split(void *handle, int enable)
+{
+    Exynos_gsc_In();
+
+    int ret = 0;
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+#ifdef USES_SCALER
+    if (gsc->gsc_id >= HW_SCAL0) {
+        Exynos_gsc_Out();
+        return -1;
+    }
+#endif
+    if ((gsc->mode != GSC_M2M_MODE) || gsc->allow_drm) {
+        ALOGE("%s::split needs a non-drm M2M handle", __func__);
+        return -1;
+    }
+
+    if (enable)
+        ret = gsc->m_gsc_m2m_acquire_peer(handle);
+    else
+        gsc->m_gsc_m2m_release_peer(handle);
+
+    Exynos_gsc_Out();
+
+    return ret;
+}
+
+int exynos_gsc_convert_split(void *handle,
+    exynos_mpp_img *src_img, exynos_mpp_img *dst_img)
+{
+    Exynos_gsc_In();
+
+    int ret;
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+#ifdef USES_SCALER
+    if (gsc->gsc_id >= HW_SCAL0) {
+        Exynos_gsc_Out();
+        return -1;
+    }
+#endif
+    if (gsc->mode != GSC_M2M_MODE) {
+        ALOGE("%s::split needs an M2M handle", __func__);
+        return -1;
+    }
+
+    ret = gsc->m_gsc_m2m_run_split(handle, src_img, dst_img);
+
+    Exynos_gsc_Out();
+
+    return ret;
+}
+
+void *exynos_gsc_create_dispatch(int priority)
+{
+    if ((priority < 0) || (priority >= GSC_PRIORITY_MAX)) {
+        ALOGE("%s::fail:: priority is not valid(%d) ", __func__, priority);
+        return NULL;
+    }
+
+    CGscDispatch *dispatch = new CGscDispatch(priority);
+    if (!dispatch) {
+        ALOGE("%s:: failed to allocate dispatcher handle", __func__);
+        return NULL;
+    }
+
+    return reinterpret_cast<void *>(dispatch);
+}
+
+int exynos_gsc_dispatch_convert(void *handle,
+    exynos_mpp_img *src_img, exynos_mpp_img *dst_img)
+{
+    Exynos_gsc_In();
+
+    int ret;
+    CGscDispatch *dispatch = GetGscDispatch(handle);
+    if (dispatch == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+
+    ret = dispatch->m_dispatch_run(src_img, dst_img);
+
+    Exynos_gsc_Out();
+
+    return ret;
+}
+
+int exynos_gsc_dispatch_get_stats(void *handle,
+    exynos_gsc_dispatch_stats *stats)
+{
+    CGscDispatch *dispatch = GetGscDispatch(handle);
+    if ((dispatch == NULL) || (stats == NULL)) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+
+    memcpy(stats, &dispatch->stats, sizeof(*stats));
+    stats->hw_open_ns = dispatch->cost.hw_open_ns;
+    stats->hw_config_ns = dispatch->cost.hw_config_ns;
+    stats->hw_fixed_ns = dispatch->cost.hw_fixed_ns;
+    stats->hw_mpix_ns = dispatch->cost.hw_mpix_ns;
+    stats->sw_copy_mb_ns = dispatch->cost.sw_mb_ns[0];
+    stats->sw_scale_mb_ns = dispatch->cost.sw_mb_ns[1];
+
+    return 0;
+}
+
+void exynos_gsc_destroy_dispatch(void *handle)
+{
+    Exynos_gsc_In();
+
+    CGscDispatch *dispatch = GetGscDispatch(handle);
+    if (dispatch == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return;
+    }
+
+    delete dispatch;
+
+    Exynos_gsc_Out();
+}
+
+int exynos_gsc_select_session(void *handle, const char *name)
+{
+    Exynos_gsc_In();
+
+    int ret;
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+
+    if ((name == NULL) || (name[0] == '\0')) {
+        ALOGE("%s::session name is not valid", __func__);
+        return -1;
+    }
+#ifdef USES_SCALER
+    if (gsc->gsc_id >= HW_SCAL0) {
+        Exynos_gsc_Out();
+        return -1;
+    }
+#endif
+    if ((gsc->mode != GSC_M2M_MODE) || gsc->allow_drm) {
+        ALOGE("%s::sessions need a non-drm M2M handle", __func__);
+        return -1;
+    }
+
+    ret = gsc->m_gsc_m2m_select_session(handle, name);
+
+    Exynos_gsc_Out();
+
+    return ret;
+}
+
+int exynos_gsc_get_event_fd(void *handle)
+{
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+#ifdef USES_SCALER
+    if (gsc->gsc_id >= HW_SCAL0)
+        return -1;
+#endif
+    if (gsc->mode != GSC_M2M_MODE)
+        return -1;
+
+    return gsc->m_gsc_m2m_event_fd();
+}
+
+int exynos_gsc_reap_frames_exclusive(void *handle)
+{
+    Exynos_gsc_In();
+
+    int ret = -1;
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+#ifdef USES_SCALER
+    if (gsc->gsc_id >= HW_SCAL0) {
+        Exynos_gsc_Out();
+        return -1;
+    }
+#endif
+    if (gsc->mode == GSC_M2M_MODE)
+        ret = gsc->m_gsc_m2m_reap(handle);
+
+    Exynos_gsc_Out();
+
+    return ret;
+}
+
+int exynos_gsc_pending_frames(void *handle)
+{
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+
+    if (gsc->mode != GSC_M2M_MODE)
+        return 0;
+
+    return gsc->dst_info.qbuf_cnt;
+}
+
 int exynos_gsc_stop_exclusive(void *handle)
 {
     Exynos_gsc_In();
@@ -0,0 +1,388 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*!
+ * \file      libgscaler_arbiter.cpp
+ * \brief     cross-process arbiter of the M2M gscaler units
+ *
+ * The units are shared by every process that calls exynos_gsc_create().
+ * Their ownership is kept in a lock table in a shared file mapping, guarded
+ * by a process-shared mutex. A free unit is handed out at once; otherwise
+ * the caller queues and is woken when a unit is released. Waiters are
+ * served by priority class, then in arrival order; a waiter none of whose
+ * units is free does not hold up the ones behind it.
+ *
+ * The file outlives the processes, and a reboot. The table records the
+ * boot it was set up in and is set up again in a new one. The mutex is
+ * robust, so a process dying while it holds the lock does not wedge the
+ * others, and units and queue slots of dead processes are reclaimed.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "libgscaler_obj.h"
+
+#define GSC_ARBITER_MAGIC           0x47534341  /* "GSCA" */
+#define GSC_ARBITER_MAX_WAITERS     (16)
+#define GSC_ARBITER_BOOT_ID_PATH    "/proc/sys/kernel/random/boot_id"
+#define GSC_ARBITER_BOOT_ID_LEN     (36)
+/* waiters recheck for dead owners at least this often */
+#define GSC_ARBITER_RECHECK_NS      (100 * 1000000LL)
+
+struct gsc_arbiter_unit {
+    pid_t owner;                    /* 0 if free */
+    long long blocked_until;        /* held by a client outside the arbiter */
+};
+
+struct gsc_arbiter_waiter {
+    pid_t pid;                      /* 0 if the slot is free */
+    int priority;
+    unsigned int ticket;
+    unsigned int mask;              /* units it can take */
+};
+
+struct gsc_arbiter_table {
+    unsigned int magic;
+    unsigned int size;
+    char boot_id[GSC_ARBITER_BOOT_ID_LEN + 1];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned int next_ticket;
+    struct gsc_arbiter_unit units[NUM_OF_GSC_HW];
+    struct gsc_arbiter_waiter waiters[GSC_ARBITER_MAX_WAITERS];
+};
+
+static pthread_once_t arbiter_once = PTHREAD_ONCE_INIT;
+static struct gsc_arbiter_table *arbiter;
+
+static long long gsc_arbiter_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Reads the id the kernel picks for each boot. Empty if it is not available */
+static void gsc_arbiter_boot_id(char boot_id[GSC_ARBITER_BOOT_ID_LEN + 1])
+{
+    ssize_t len = 0;
+    int fd;
+
+    fd = open(GSC_ARBITER_BOOT_ID_PATH, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        len = read(fd, boot_id, GSC_ARBITER_BOOT_ID_LEN);
+        close(fd);
+    }
+    boot_id[(len > 0) ? len : 0] = '\0';
+}
+
+static void gsc_arbiter_init(void)
+{
+    struct gsc_arbiter_table *table;
+    pthread_mutexattr_t mattr;
+    pthread_condattr_t cattr;
+    char boot_id[GSC_ARBITER_BOOT_ID_LEN + 1];
+    struct stat st;
+    int fd;
+
+    gsc_arbiter_boot_id(boot_id);
+
+    fd = open(GSC_ARBITER_PATH, O_RDWR | O_CREAT | O_CLOEXEC, 0660);
+    if (fd < 0) {
+        ALOGW("%s::open(%s) fail, falling back to polling", __func__,
+              GSC_ARBITER_PATH);
+        return;
+    }
+
+    /* the first process to take the file lock sets the table up */
+    flock(fd, LOCK_EX);
+    if ((fstat(fd, &st) < 0) ||
+            ((st.st_size < (off_t)sizeof(*table)) &&
+             (ftruncate(fd, sizeof(*table)) < 0))) {
+        ALOGE("%s::resizing %s fail", __func__, GSC_ARBITER_PATH);
+        goto out;
+    }
+
+    table = (struct gsc_arbiter_table *)mmap(NULL, sizeof(*table),
+                            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (table == MAP_FAILED) {
+        ALOGE("%s::mmap(%s) fail", __func__, GSC_ARBITER_PATH);
+        goto out;
+    }
+
+    /* a table of an earlier boot names pids that are gone or reused */
+    if ((table->magic != GSC_ARBITER_MAGIC) || (table->size != sizeof(*table)) ||
+            strcmp(table->boot_id, boot_id)) {
+        memset(table, 0, sizeof(*table));
+
+        pthread_mutexattr_init(&mattr);
+        pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&table->lock, &mattr);
+        pthread_mutexattr_destroy(&mattr);
+
+        pthread_condattr_init(&cattr);
+        pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+        pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+        pthread_cond_init(&table->cond, &cattr);
+        pthread_condattr_destroy(&cattr);
+
+        strcpy(table->boot_id, boot_id);
+        table->size = sizeof(*table);
+        table->magic = GSC_ARBITER_MAGIC;
+    }
+
+    arbiter = table;
+
+out:
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+static bool gsc_arbiter_pid_dead(pid_t pid)
+{
+    return (kill(pid, 0) < 0) && (errno == ESRCH);
+}
+
+/* Must be called with the table lock held */
+static void gsc_arbiter_reclaim(struct gsc_arbiter_table *table)
+{
+    bool freed = false;
+    int i;
+
+    for (i = 0; i < NUM_OF_GSC_HW; i++) {
+        if (table->units[i].owner && gsc_arbiter_pid_dead(table->units[i].owner)) {
+            ALOGW("%s::gscaler%d held by dead pid %d, reclaimed", __func__, i,
+                  table->units[i].owner);
+            table->units[i].owner = 0;
+            freed = true;
+        }
+    }
+
+    for (i = 0; i < GSC_ARBITER_MAX_WAITERS; i++) {
+        if (table->waiters[i].pid && gsc_arbiter_pid_dead(table->waiters[i].pid)) {
+            table->waiters[i].pid = 0;
+            freed = true;
+        }
+    }
+
+    if (freed)
+        pthread_cond_broadcast(&table->cond);
+}
+
+/*
+ * Called with the table lock held, after a lock call returned EOWNERDEAD:
+ * its last holder died, maybe halfway through an update. Whatever it held
+ * is dropped, then the lock is marked usable again.
+ */
+static void gsc_arbiter_recover(struct gsc_arbiter_table *table)
+{
+    ALOGW("%s::the arbiter lock holder died, recovering", __func__);
+    gsc_arbiter_reclaim(table);
+    pthread_mutex_consistent(&table->lock);
+}
+
+static int gsc_arbiter_lock(struct gsc_arbiter_table *table)
+{
+    int ret = pthread_mutex_lock(&table->lock);
+
+    if (ret == EOWNERDEAD) {
+        gsc_arbiter_recover(table);
+        ret = 0;
+    }
+
+    return -ret;
+}
+
+/*
+ * Must be called with the table lock held. Returns a free unit of mask, or
+ * -1. *next_unblock is lowered to the time a blocked unit becomes eligible.
+ */
+static int gsc_arbiter_find_free(struct gsc_arbiter_table *table,
+                                 unsigned int mask, long long now,
+                                 long long *next_unblock)
+{
+    int i;
+
+    for (i = 0; i < NUM_OF_GSC_HW; i++) {
+        if (!(mask & (1 << i)) || table->units[i].owner)
+            continue;
+        if (table->units[i].blocked_until > now) {
+            if (table->units[i].blocked_until < *next_unblock)
+                *next_unblock = table->units[i].blocked_until;
+            continue;
+        }
+        return i;
+    }
+
+    return -1;
+}
+
+/* Must be called with the table lock held */
+static bool gsc_arbiter_can_take(struct gsc_arbiter_table *table,
+                                 unsigned int mask, long long now)
+{
+    long long next_unblock = now;
+
+    return gsc_arbiter_find_free(table, mask, now, &next_unblock) >= 0;
+}
+
+/*
+ * Must be called with the table lock held. Waiters that rank before slot
+ * but have no free unit in their mask are passed over.
+ */
+static bool gsc_arbiter_is_head(struct gsc_arbiter_table *table, int slot,
+                                long long now)
+{
+    struct gsc_arbiter_waiter *self = &table->waiters[slot];
+    struct gsc_arbiter_waiter *w;
+    int i;
+
+    for (i = 0; i < GSC_ARBITER_MAX_WAITERS; i++) {
+        w = &table->waiters[i];
+        if ((i == slot) || !w->pid)
+            continue;
+        if (!gsc_arbiter_can_take(table, w->mask, now))
+            continue;
+        if ((w->priority < self->priority) ||
+                ((w->priority == self->priority) &&
+                 ((int)(w->ticket - self->ticket) < 0)))
+            return false;
+    }
+
+    return true;
+}
+
+/* Must be called with the table lock held. Counts waiters a unit is free for */
+static bool gsc_arbiter_has_waiters(struct gsc_arbiter_table *table,
+                                    long long now)
+{
+    int i;
+
+    for (i = 0; i < GSC_ARBITER_MAX_WAITERS; i++) {
+        if (table->waiters[i].pid &&
+                gsc_arbiter_can_take(table, table->waiters[i].mask, now))
+            return true;
+    }
+
+    return false;
+}
+
+int gsc_arbiter_acquire(int priority, unsigned int mask, unsigned int timeout_us)
+{
+    struct gsc_arbiter_table *table;
+    long long now, deadline, wake;
+    struct timespec ts;
+    int unit = -1, slot;
+    pid_t pid = getpid();
+
+    pthread_once(&arbiter_once, gsc_arbiter_init);
+    table = arbiter;
+    if (!table)
+        return -ENODEV;
+
+    if (gsc_arbiter_lock(table) < 0)
+        return -ENODEV;
+
+    now = gsc_arbiter_now();
+    deadline = now + (long long)timeout_us * 1000;
+
+    /* units of dead owners count as free, also for callers that do not wait */
+    gsc_arbiter_reclaim(table);
+
+    /* fast path, nobody queued before us could take a unit now */
+    wake = deadline;
+    if (!gsc_arbiter_has_waiters(table, now))
+        unit = gsc_arbiter_find_free(table, mask, now, &wake);
+    if (unit >= 0) {
+        table->units[unit].owner = pid;
+        pthread_mutex_unlock(&table->lock);
+        return unit;
+    }
+
+    for (slot = 0; slot < GSC_ARBITER_MAX_WAITERS; slot++) {
+        if (!table->waiters[slot].pid)
+            break;
+    }
+    if (slot == GSC_ARBITER_MAX_WAITERS) {
+        pthread_mutex_unlock(&table->lock);
+        return -EBUSY;
+    }
+    table->waiters[slot].pid = pid;
+    table->waiters[slot].priority = priority;
+    table->waiters[slot].ticket = table->next_ticket++;
+    table->waiters[slot].mask = mask;
+
+    while (true) {
+        now = gsc_arbiter_now();
+        wake = deadline;
+        if (gsc_arbiter_is_head(table, slot, now)) {
+            unit = gsc_arbiter_find_free(table, mask, now, &wake);
+            if (unit >= 0)
+                break;
+        }
+
+        if (now >= deadline) {
+            unit = -ETIMEDOUT;
+            break;
+        }
+
+        gsc_arbiter_reclaim(table);
+
+        if (wake > now + GSC_ARBITER_RECHECK_NS)
+            wake = now + GSC_ARBITER_RECHECK_NS;
+        ts.tv_sec = wake / 1000000000LL;
+        ts.tv_nsec = wake % 1000000000LL;
+        if (pthread_cond_timedwait(&table->cond, &table->lock, &ts) == EOWNERDEAD)
+            gsc_arbiter_recover(table);
+    }
+
+    table->waiters[slot].pid = 0;
+    if (unit >= 0)
+        table->units[unit].owner = pid;
+    /* the next waiter may be the head now */
+    pthread_cond_broadcast(&table->cond);
+    pthread_mutex_unlock(&table->lock);
+
+    return unit;
+}
+
+void gsc_arbiter_release(int unit, bool open_failed)
+{
+    struct gsc_arbiter_table *table = arbiter;
+
+    if (!table || (unit < 0) || (unit >= NUM_OF_GSC_HW))
+        return;
+
+    if (gsc_arbiter_lock(table) < 0)
+        return;
+    table->units[unit].owner = 0;
+    /*
+     * The unit could not be opened, so a client that does not use the
+     * arbiter holds it. Leave it alone for a while instead of handing it
+     * straight back out.
+     */
+    if (open_failed)
+        table->units[unit].blocked_until = gsc_arbiter_now() +
+                                   GSC_WAITING_TIME_FOR_TRYLOCK * 1000LL;
+    pthread_cond_broadcast(&table->cond);
+    pthread_mutex_unlock(&table->lock);
+}
@@ -0,0 +1,348 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*!
+ * \file      libgscaler_dispatch.cpp
+ * \brief     picks the scaler or the CPU for every job
+ *
+ * A job on a unit costs a fixed amount for the ioctls and the interrupt,
+ * plus the time to configure the unit when the job differs from the last
+ * one, plus the time to take and open a unit when none is held, plus a
+ * time per pixel. A job on the CPU costs a time per byte written. All of
+ * them are running averages of the jobs measured so far, and every few
+ * jobs the backend estimated slower is run anyway so that its estimate
+ * keeps up with the load of the system.
+ */
+
+#include "libgscaler_obj.h"
+
+/* a new measurement weighs 1/8 of the estimate */
+#define GSC_DISPATCH_EWMA_WEIGHT    (8)
+/* every this many jobs the other backend is measured again ... */
+#define GSC_DISPATCH_EXPLORE_JOBS   (64)
+/* ... unless it is expected to be this many times slower */
+#define GSC_DISPATCH_EXPLORE_RATIO  (4)
+/* a unit unused for this many jobs is given back */
+#define GSC_DISPATCH_IDLE_JOBS      (32)
+/* after no unit was free, the CPU takes every job this long */
+#define GSC_DISPATCH_RETRY_NS       (50 * 1000000LL)
+/* jobs this small measure the fixed cost of a unit */
+#define GSC_DISPATCH_SMALL_PIX      (64 * 1024)
+
+/* first estimates, until the jobs tell better */
+#define GSC_DISPATCH_HW_OPEN_NS     (2 * 1000000LL)
+#define GSC_DISPATCH_HW_CONFIG_NS   (1 * 1000000LL)
+#define GSC_DISPATCH_HW_FIXED_NS    (200 * 1000LL)
+#define GSC_DISPATCH_HW_MPIX_NS     (4 * 1000000LL)    /* 250 Mpixel/s */
+#define GSC_DISPATCH_SW_COPY_MB_NS  (1 * 1000000LL)    /* 1 GiB/s */
+#define GSC_DISPATCH_SW_SCALE_MB_NS (4 * 1000000LL)
+
+static long long m_dispatch_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void m_dispatch_update(long long *estimate, long long sample)
+{
+    if (sample < 0)
+        sample = 0;
+    *estimate += (sample - *estimate) / GSC_DISPATCH_EWMA_WEIGHT;
+}
+
+static long long m_dispatch_pixels(exynos_mpp_img *src, exynos_mpp_img *dst)
+{
+    long long src_pix = (long long)src->w * src->h;
+    long long dst_pix = (long long)dst->w * dst->h;
+
+    return (src_pix > dst_pix) ? src_pix : dst_pix;
+}
+
+static bool m_dispatch_is_scaled(exynos_mpp_img *src, exynos_mpp_img *dst)
+{
+    return (src->w != dst->w) || (src->h != dst->h);
+}
+
+/* whether the unit runs img without being configured again */
+static bool m_dispatch_same_img(exynos_mpp_img *a, exynos_mpp_img *b)
+{
+    return (a->x == b->x) && (a->y == b->y) &&
+           (a->w == b->w) && (a->h == b->h) &&
+           (a->fw == b->fw) && (a->fh == b->fh) &&
+           (a->format == b->format) && (a->rot == b->rot) &&
+           (a->cacheable == b->cacheable) && (a->mem_type == b->mem_type);
+}
+
+CGscDispatch::CGscDispatch(int __priority)
+{
+    hw = NULL;
+    memset(&src_img, 0, sizeof(exynos_mpp_img));
+    memset(&dst_img, 0, sizeof(exynos_mpp_img));
+    memset(&hw_src, 0, sizeof(exynos_mpp_img));
+    memset(&hw_dst, 0, sizeof(exynos_mpp_img));
+    priority = __priority;
+    csc_set = false;
+    eq_auto = 0;            /* user mode */
+    range_full = 0;         /* narrow */
+    v4l2_colorspace = 1;    /* SMPTE170M (601) */
+
+    cost.hw_open_ns = GSC_DISPATCH_HW_OPEN_NS;
+    cost.hw_config_ns = GSC_DISPATCH_HW_CONFIG_NS;
+    cost.hw_fixed_ns = GSC_DISPATCH_HW_FIXED_NS;
+    cost.hw_mpix_ns = GSC_DISPATCH_HW_MPIX_NS;
+    cost.sw_mb_ns[0] = GSC_DISPATCH_SW_COPY_MB_NS;
+    cost.sw_mb_ns[1] = GSC_DISPATCH_SW_SCALE_MB_NS;
+
+    memset(&stats, 0, sizeof(stats));
+    jobs = 0;
+    hw_idle_jobs = 0;
+    hw_retry_at = 0;
+}
+
+CGscDispatch::~CGscDispatch()
+{
+    m_dispatch_release_hw();
+}
+
+void CGscDispatch::m_dispatch_release_hw(void)
+{
+    if (hw == NULL)
+        return;
+
+    hw->DestroyMpp(hw);
+    hw = NULL;
+    hw_idle_jobs = 0;
+}
+
+long long CGscDispatch::m_dispatch_hw_cost(exynos_mpp_img *src,
+                                           exynos_mpp_img *dst)
+{
+    long long ns;
+
+    ns = cost.hw_fixed_ns +
+         m_dispatch_pixels(src, dst) * cost.hw_mpix_ns / 1000000;
+    if (hw == NULL)
+        ns += cost.hw_open_ns + cost.hw_config_ns;
+    else if (!m_dispatch_same_img(&hw_src, src) ||
+             !m_dispatch_same_img(&hw_dst, dst))
+        ns += cost.hw_config_ns;
+
+    return ns;
+}
+
+long long CGscDispatch::m_dispatch_sw_cost(exynos_mpp_img *src,
+                                           exynos_mpp_img *dst)
+{
+    return (long long)CSwMpp::m_sw_dst_bytes(dst) *
+           cost.sw_mb_ns[m_dispatch_is_scaled(src, dst)] / (1024 * 1024);
+}
+
+/*
+ * Returns -EAGAIN if no unit could be taken without waiting, which only
+ * happens when can_wait is false.
+ */
+int CGscDispatch::m_dispatch_run_hw(exynos_mpp_img *src, exynos_mpp_img *dst,
+                                    bool can_wait)
+{
+    exynos_gsc_batch_stats batch;
+    exynos_gsc_job job;
+    long long start, pix, ns;
+
+    if (hw == NULL) {
+        start = m_dispatch_now();
+        hw = new CGscaler(GSC_M2M_MODE);
+        hw->priority = priority;
+        if (!can_wait)
+            hw->wait_us = 0;
+        if (hw->m_gsc_find_and_create(hw) == false) {
+            delete hw;
+            hw = NULL;
+            if (!can_wait) {
+                hw_retry_at = m_dispatch_now() + GSC_DISPATCH_RETRY_NS;
+                return -EAGAIN;
+            }
+            ALOGE("%s::no gscaler is available", __func__);
+            stats.failed++;
+            return -1;
+        }
+        m_dispatch_update(&cost.hw_open_ns, m_dispatch_now() - start);
+
+        if (csc_set)
+            hw->SetCSCProperty(hw, eq_auto, range_full, v4l2_colorspace);
+        memset(&hw_src, 0, sizeof(exynos_mpp_img));
+        memset(&hw_dst, 0, sizeof(exynos_mpp_img));
+    }
+    hw_idle_jobs = 0;
+
+    memset(&job, 0, sizeof(job));
+    memcpy(&job.src, src, sizeof(exynos_mpp_img));
+    memcpy(&job.dst, dst, sizeof(exynos_mpp_img));
+    if (hw->m_gsc_m2m_run_batch(hw, &job, 1, &batch) < 0) {
+        ALOGE("%s::m_gsc_m2m_run_batch fail", __func__);
+        memset(&hw_src, 0, sizeof(exynos_mpp_img));
+        stats.failed++;
+        return -1;
+    }
+    /* the unit consumed the acquire fences, the job is complete */
+    src->acquireFenceFd = -1;
+    dst->acquireFenceFd = -1;
+    src->releaseFenceFd = -1;
+    dst->releaseFenceFd = -1;
+
+    memcpy(&hw_src, src, sizeof(exynos_mpp_img));
+    memcpy(&hw_dst, dst, sizeof(exynos_mpp_img));
+    stats.hw_jobs++;
+
+    /* the sample goes to the part of the cost it says most about */
+    pix = m_dispatch_pixels(src, dst);
+    ns = batch.total_ns;
+    if (batch.reconfigs)
+        m_dispatch_update(&cost.hw_config_ns, ns - cost.hw_fixed_ns -
+                          pix * cost.hw_mpix_ns / 1000000);
+    else if (pix < GSC_DISPATCH_SMALL_PIX)
+        m_dispatch_update(&cost.hw_fixed_ns, ns -
+                          pix * cost.hw_mpix_ns / 1000000);
+    else
+        m_dispatch_update(&cost.hw_mpix_ns,
+                          (ns - cost.hw_fixed_ns) * 1000000 / pix);
+
+    return 0;
+}
+
+int CGscDispatch::m_dispatch_run_sw(exynos_mpp_img *src, exynos_mpp_img *dst)
+{
+    unsigned long bytes;
+    long long start, ns;
+    int ret;
+
+    start = m_dispatch_now();
+    ret = sw.RunMpp(&sw, src, dst);
+    if (ret == -EAGAIN) {
+        /* the buffers could not be synced for the CPU, a unit can do it */
+        return m_dispatch_run_hw(src, dst, true);
+    }
+    if (ret < 0) {
+        ALOGE("%s::CSwMpp::RunMpp fail", __func__);
+        stats.failed++;
+        return -1;
+    }
+    ns = m_dispatch_now() - start;
+    stats.sw_jobs++;
+
+    bytes = CSwMpp::m_sw_dst_bytes(dst);
+    if (bytes)
+        m_dispatch_update(&cost.sw_mb_ns[m_dispatch_is_scaled(src, dst)],
+                          ns * 1024 * 1024 / (long long)bytes);
+
+    /* let the other processes have the unit while the CPU does the work */
+    if (hw && (++hw_idle_jobs >= GSC_DISPATCH_IDLE_JOBS))
+        m_dispatch_release_hw();
+
+    return 0;
+}
+
+int CGscDispatch::m_dispatch_run(exynos_mpp_img *src, exynos_mpp_img *dst)
+{
+    long long hw_ns, sw_ns;
+    bool use_sw;
+    int ret;
+
+    jobs++;
+
+    if (!sw.m_sw_can_run(src, dst))
+        return m_dispatch_run_hw(src, dst, true);
+
+    /* no unit was free a moment ago, do not ask again yet */
+    if ((hw == NULL) && (m_dispatch_now() < hw_retry_at))
+        return m_dispatch_run_sw(src, dst);
+
+    hw_ns = m_dispatch_hw_cost(src, dst);
+    sw_ns = m_dispatch_sw_cost(src, dst);
+    use_sw = (sw_ns <= hw_ns);
+
+    if ((jobs % GSC_DISPATCH_EXPLORE_JOBS) == 0) {
+        if (use_sw ? (hw_ns <= sw_ns * GSC_DISPATCH_EXPLORE_RATIO) :
+                     (sw_ns <= hw_ns * GSC_DISPATCH_EXPLORE_RATIO)) {
+            use_sw = !use_sw;
+            stats.explored++;
+        }
+    }
+
+    ALOGV("%s::%ux%u -> %ux%u: hw %lldus, sw %lldus, on %s", __func__,
+          src->w, src->h, dst->w, dst->h, hw_ns / 1000, sw_ns / 1000,
+          use_sw ? "sw" : "hw");
+
+    if (!use_sw) {
+        ret = m_dispatch_run_hw(src, dst, false);
+        if (ret != -EAGAIN)
+            return ret;
+        /* every unit is taken, the CPU is faster than waiting */
+    }
+
+    return m_dispatch_run_sw(src, dst);
+}
+
+int CGscDispatch::ConfigMpp(void *handle, exynos_mpp_img *src,
+                            exynos_mpp_img *dst)
+{
+    /* the backend is only known when the job runs */
+    memcpy(&src_img, src, sizeof(exynos_mpp_img));
+    memcpy(&dst_img, dst, sizeof(exynos_mpp_img));
+
+    return 0;
+}
+
+int CGscDispatch::RunMpp(void *handle, exynos_mpp_img *src,
+                         exynos_mpp_img *dst)
+{
+    return m_dispatch_run(src, dst);
+}
+
+int CGscDispatch::StopMpp(void *handle)
+{
+    if (hw == NULL)
+        return 0;
+
+    return hw->StopMpp(hw);
+}
+
+void CGscDispatch::DestroyMpp(void *handle)
+{
+    delete reinterpret_cast<CGscDispatch *>(handle);
+}
+
+int CGscDispatch::SetCSCProperty(void *handle, unsigned int eqAuto,
+                                 unsigned int fullRange, unsigned int colorspace)
+{
+    csc_set = true;
+    eq_auto = eqAuto;
+    range_full = fullRange;
+    v4l2_colorspace = colorspace;
+
+    if (hw == NULL)
+        return 0;
+
+    return hw->SetCSCProperty(hw, eqAuto, fullRange, colorspace);
+}
+
+int CGscDispatch::FreeMpp(void *handle)
+{
+    m_dispatch_release_hw();
+
+    return 0;
+}
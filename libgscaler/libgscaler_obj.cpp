@@ -26,6 +26,7 @@
  *   Create
  */
 
+#include <sys/epoll.h>
 #include "libgscaler_obj.h"
 #include "content_protect.h"
 
@@ -381,42 +382,88 @@ bool CGscaler::m_gsc_find_and_create(void *handle)
     Exynos_gsc_In();
 
     int          i                 = 0;
+    int          unit              = -1;
+    unsigned int mask              = 0;
     bool         flag_find_new_gsc = false;
     unsigned int total_sleep_time  = 0;
+    long long    start;
+    struct timespec ts;
     CGscaler* gsc = GetGscaler(handle);
     if (gsc == NULL) {
         ALOGE("%s::handle == NULL() fail", __func__);
         return false;
     }
 
-    do {
-        for (i = 0; i < NUM_OF_GSC_HW; i++) {
+    for (i = 0; i < NUM_OF_GSC_HW; i++) {
 #ifndef USES_ONLY_GSC0_GSC1
-            if (i == 0 || i == 3)
+        if (i == 0 || i == 3)
 #else
-            if (i == 0)
+        if (i == 0)
 #endif
-                continue;
+            continue;
+        mask |= 1 << i;
+    }
 
-            gsc->gsc_id = i;
-            gsc->gsc_fd = gsc->m_gsc_m2m_create(i);
-            if (gsc->gsc_fd < 0) {
-                gsc->gsc_fd = 0;
-                continue;
+    /*
+     * Ask the arbiter for a unit first: it hands out a free one at once and
+     * wakes us when one is released, instead of sleeping between tries.
+     */
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    start = (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    do {
+        unit = gsc_arbiter_acquire(gsc->priority, mask,
+                                   gsc->wait_us - total_sleep_time);
+        if (unit >= 0) {
+            gsc->gsc_id = unit;
+            gsc->gsc_fd = gsc->m_gsc_m2m_create(unit);
+            if (gsc->gsc_fd >= 0) {
+                gsc->arb_unit = unit;
+                flag_find_new_gsc = true;
+                break;
             }
 
-            flag_find_new_gsc = true;
-            break;
+            gsc->gsc_fd = 0;
+            gsc_arbiter_release(unit, true);
         }
 
-        if (flag_find_new_gsc == false) {
-            usleep(GSC_WAITING_TIME_FOR_TRYLOCK);
-            total_sleep_time += GSC_WAITING_TIME_FOR_TRYLOCK;
-            ALOGV("%s::waiting for the gscaler availability", __func__);
-        }
+        /* the time spent in the arbiter counts against wait_us too */
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        total_sleep_time = (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 - start;
+    } while ((unit >= 0) && (total_sleep_time < gsc->wait_us));
 
-    } while(flag_find_new_gsc == false
-            && total_sleep_time < MAX_GSC_WAITING_TIME_FOR_TRYLOCK);
+    /*
+     * without the arbiter, poll the units as before, for what is left of
+     * wait_us. A caller that does not wait still gets one try, and so does
+     * one the arbiter timed out: a unit it counts as owned may still open,
+     * e.g. after its owner died with the pid reused.
+     */
+    if (!flag_find_new_gsc) {
+        do {
+            for (i = 0; i < NUM_OF_GSC_HW; i++) {
+                if (!(mask & (1 << i)))
+                    continue;
+
+                gsc->gsc_id = i;
+                gsc->gsc_fd = gsc->m_gsc_m2m_create(i);
+                if (gsc->gsc_fd < 0) {
+                    gsc->gsc_fd = 0;
+                    continue;
+                }
+
+                flag_find_new_gsc = true;
+                break;
+            }
+
+            if ((flag_find_new_gsc == false) &&
+                    (total_sleep_time < gsc->wait_us)) {
+                usleep(GSC_WAITING_TIME_FOR_TRYLOCK);
+                total_sleep_time += GSC_WAITING_TIME_FOR_TRYLOCK;
+                ALOGV("%s::waiting for the gscaler availability", __func__);
+            }
+
+        } while(flag_find_new_gsc == false
+                && total_sleep_time < gsc->wait_us);
+    }
 
     if (flag_find_new_gsc == false)
         ALOGE("%s::we don't have any available gsc.. fail", __func__);
@@ -436,6 +483,14 @@ bool CGscaler::m_gsc_m2m_destroy(void *handle)
         return false;
     }
 
+    gsc->m_gsc_m2m_release_peer(handle);
+
+    for (int i = 0; i < gsc->nr_sessions; i++) {
+        if (i != gsc->cur_session)
+            gsc->m_gsc_session_close(handle, i);
+    }
+    gsc->nr_sessions = 0;
+
     /*
      * just in case, we call stop here because we cannot afford to leave
      * secure side protection on if things failed.
@@ -446,6 +501,16 @@ bool CGscaler::m_gsc_m2m_destroy(void *handle)
         close(gsc->gsc_fd);
     gsc->gsc_fd = 0;
 
+    if (gsc->event_fd >= 0)
+        close(gsc->event_fd);
+    gsc->event_fd = -1;
+    gsc->event_target = -1;
+
+    if (gsc->arb_unit >= 0) {
+        gsc_arbiter_release(gsc->arb_unit, false);
+        gsc->arb_unit = -1;
+    }
+
     Exynos_gsc_Out();
 
     return true;
@@ -463,7 +528,8 @@ int CGscaler::m_gsc_m2m_stop(void *handle)
         return -1;
     }
 
-    if (!gsc->src_info.stream_on && !gsc->dst_info.stream_on) {
+    if (!gsc->src_info.stream_on && !gsc->dst_info.stream_on &&
+            !gsc->protection_enabled) {
         /* wasn't streaming, return success */
         return 0;
     } else if (gsc->src_info.stream_on != gsc->dst_info.stream_on) {
@@ -498,6 +564,13 @@ int CGscaler::m_gsc_m2m_stop(void *handle)
         gsc->dst_info.stream_on = false;
     }
 
+    /* stream off returned every queued buffer */
+    gsc->src_info.qbuf_cnt = 0;
+    gsc->src_info.buf.src_buf_idx = 0;
+    gsc->dst_info.qbuf_cnt = 0;
+    gsc->dst_info.buf.src_buf_idx = 0;
+    gsc->m_gsc_event_track();
+
     /* if drm is enabled */
     if (gsc->allow_drm && gsc->protection_enabled) {
         unsigned int protect_id = 0;
@@ -540,6 +613,12 @@ int CGscaler::m_gsc_m2m_stop(void *handle)
         ret = -1;
     }
 
+    /* the next run requests buffers and turns protection on again */
+    gsc->src_info.hw.bufs_valid = false;
+    gsc->dst_info.hw.bufs_valid = false;
+    gsc->src_info.dirty = true;
+    gsc->dst_info.dirty = true;
+
     Exynos_gsc_Out();
 
     return ret;
@@ -557,6 +636,12 @@ int CGscaler::m_gsc_m2m_run_core(void *handle)
         return -1;
     }
 
+    /* buffers of another memory type need new REQBUFS */
+    if (gsc->src_info.hw.mem_type != gsc->src_info.buf.mem_type)
+        gsc->src_info.dirty = true;
+    if (gsc->dst_info.hw.mem_type != gsc->dst_info.buf.mem_type)
+        gsc->dst_info.dirty = true;
+
     is_dirty = gsc->src_info.dirty || gsc->dst_info.dirty;
     is_drm = gsc->src_info.mode_drm;
 
@@ -588,11 +673,42 @@ int CGscaler::m_gsc_m2m_run_core(void *handle)
         return -1;
     }
 
-    /* dequeue buffers from previous work if necessary */
+    /*
+     * dequeue buffers from previous work if necessary: all of them before
+     * a reconfiguration, otherwise the oldest one once every slot is in use,
+     * so that up to queue_depth jobs overlap with the CPU setup of the next.
+     * New formats and buffers can only be set on stopped queues; a change
+     * of crop or controls alone keeps them streaming.
+     */
     if (gsc->src_info.stream_on == true) {
-        if (gsc->m_gsc_m2m_wait_frame_done(handle) < 0) {
-            ALOGE("%s::exynos_gsc_m2m_wait_frame_done fail", __func__);
-            return -1;
+        if (is_dirty) {
+            if (gsc->m_gsc_m2m_drain(handle) < 0) {
+                ALOGE("%s::m_gsc_m2m_drain fail", __func__);
+                return -1;
+            }
+            /*
+             * the buffers belong to one content protection state: a change
+             * of drm mode goes through stop, which also turns protection
+             * off, and requests them again below
+             */
+            if (gsc->src_info.hw.mode_drm != gsc->src_info.mode_drm) {
+                if (gsc->m_gsc_m2m_stop(handle) < 0) {
+                    ALOGE("%s::m_gsc_m2m_stop fail", __func__);
+                    return -1;
+                }
+            } else if (((gsc->src_info.dirty && CGscaler::m_gsc_needs_reqbufs(
+                      &gsc->src_info, gsc->queue_depth)) ||
+                 (gsc->dst_info.dirty && CGscaler::m_gsc_needs_reqbufs(
+                      &gsc->dst_info, gsc->queue_depth))) &&
+                    gsc->m_gsc_m2m_streamoff(handle) < 0) {
+                ALOGE("%s::m_gsc_m2m_streamoff fail", __func__);
+                return -1;
+            }
+        } else if (gsc->src_info.qbuf_cnt >= gsc->src_info.buf_count) {
+            if (gsc->m_gsc_m2m_wait_frame_done(handle) < 0) {
+                ALOGE("%s::exynos_gsc_m2m_wait_frame_done fail", __func__);
+                return -1;
+            }
         }
     }
 
@@ -614,6 +730,7 @@ int CGscaler::m_gsc_m2m_run_core(void *handle)
      */
 
     if (gsc->src_info.dirty) {
+        gsc->src_info.buf_count = gsc->queue_depth;
         if (CGscaler::m_gsc_set_format(gsc->gsc_fd, &gsc->src_info) == false) {
             ALOGE("%s::m_gsc_set_format(src) fail", __func__);
             goto done;
@@ -622,6 +739,7 @@ int CGscaler::m_gsc_m2m_run_core(void *handle)
     }
 
     if (gsc->dst_info.dirty) {
+        gsc->dst_info.buf_count = gsc->queue_depth;
         if (CGscaler::m_gsc_set_format(gsc->gsc_fd, &gsc->dst_info) == false) {
             ALOGE("%s::m_gsc_set_format(dst) fail", __func__);
             goto done;
@@ -633,23 +751,44 @@ int CGscaler::m_gsc_m2m_run_core(void *handle)
      * set up csc equation property
      */
     if (is_dirty) {
-        if (exynos_v4l2_s_ctrl(gsc->gsc_fd,
-               V4L2_CID_CSC_EQ_MODE, gsc->eq_auto) < 0) {
-            ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_CSC_EQ_MODE) fail", __func__);
-            return -1;
+        if (!gsc->hw_csc.valid || (gsc->hw_csc.eq_auto != gsc->eq_auto)) {
+            gsc->hw_csc.valid = false;
+            if (exynos_v4l2_s_ctrl(gsc->gsc_fd,
+                   V4L2_CID_CSC_EQ_MODE, gsc->eq_auto) < 0) {
+                ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_CSC_EQ_MODE) fail", __func__);
+                return -1;
+            }
+        } else {
+            gsc->dst_info.ioctls_saved++;
         }
 
-        if (exynos_v4l2_s_ctrl(gsc->gsc_fd,
-               V4L2_CID_CSC_EQ, gsc->v4l2_colorspace) < 0) {
-            ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_CSC_EQ) fail", __func__);
-            return -1;
+        if (!gsc->hw_csc.valid ||
+                (gsc->hw_csc.v4l2_colorspace != gsc->v4l2_colorspace)) {
+            gsc->hw_csc.valid = false;
+            if (exynos_v4l2_s_ctrl(gsc->gsc_fd,
+                   V4L2_CID_CSC_EQ, gsc->v4l2_colorspace) < 0) {
+                ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_CSC_EQ) fail", __func__);
+                return -1;
+            }
+        } else {
+            gsc->dst_info.ioctls_saved++;
         }
 
-        if (exynos_v4l2_s_ctrl(gsc->gsc_fd,
-               V4L2_CID_CSC_RANGE, gsc->range_full) < 0) {
-            ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_CSC_RANGE) fail", __func__);
-            return -1;
+        if (!gsc->hw_csc.valid || (gsc->hw_csc.range_full != gsc->range_full)) {
+            gsc->hw_csc.valid = false;
+            if (exynos_v4l2_s_ctrl(gsc->gsc_fd,
+                   V4L2_CID_CSC_RANGE, gsc->range_full) < 0) {
+                ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_CSC_RANGE) fail", __func__);
+                return -1;
+            }
+        } else {
+            gsc->dst_info.ioctls_saved++;
         }
+
+        gsc->hw_csc.eq_auto = gsc->eq_auto;
+        gsc->hw_csc.v4l2_colorspace = gsc->v4l2_colorspace;
+        gsc->hw_csc.range_full = gsc->range_full;
+        gsc->hw_csc.valid = true;
     }
 
     /* if we are enabling drm, make sure to enable hw protection.
@@ -706,6 +845,8 @@ int CGscaler::m_gsc_m2m_run_core(void *handle)
         gsc->dst_info.stream_on = true;
     }
 
+    gsc->m_gsc_event_track();
+
     Exynos_gsc_Out();
 
     return 0;
@@ -803,20 +944,20 @@ int CGscaler::m_gsc_m2m_wait_frame_done(void *handle)
         return -1;
     }
 
-    if (gsc->src_info.buf.buffer_queued) {
-        if (exynos_v4l2_dqbuf(gsc->gsc_fd, &gsc->src_info.buf.buffer) < 0) {
+    /* M2M buffers complete in queueing order, this is the oldest job */
+    if (gsc->src_info.qbuf_cnt > 0) {
+        if (CGscaler::m_gsc_dqbuf(gsc->gsc_fd, &gsc->src_info) == false) {
             ALOGE("%s::exynos_v4l2_dqbuf(src) fail", __func__);
             return -1;
         }
-        gsc->src_info.buf.buffer_queued = false;
     }
 
-    if (gsc->dst_info.buf.buffer_queued) {
-        if (exynos_v4l2_dqbuf(gsc->gsc_fd, &gsc->dst_info.buf.buffer) < 0) {
+    if (gsc->dst_info.qbuf_cnt > 0) {
+        if (CGscaler::m_gsc_dqbuf(gsc->gsc_fd, &gsc->dst_info) == false) {
             ALOGE("%s::exynos_v4l2_dqbuf(dst) fail", __func__);
             return -1;
         }
-        gsc->dst_info.buf.buffer_queued = false;
+        gsc->m_gsc_event_track();
     }
 
     Exynos_gsc_Out();
@@ -824,12 +965,770 @@ int CGscaler::m_gsc_m2m_wait_frame_done(void *handle)
     return 0;
 }
 
+int CGscaler::m_gsc_m2m_drain(void *handle)
+{
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+
+    while (gsc->src_info.qbuf_cnt > 0 || gsc->dst_info.qbuf_cnt > 0) {
+        if (gsc->m_gsc_m2m_wait_frame_done(handle) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+static long long m_gsc_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Jobs with the same configuration run without reconfiguring the unit */
+static bool m_gsc_same_config(exynos_gsc_job *a, exynos_gsc_job *b)
+{
+    return (a->src.x == b->src.x) && (a->src.y == b->src.y) &&
+           (a->src.w == b->src.w) && (a->src.h == b->src.h) &&
+           (a->src.fw == b->src.fw) && (a->src.fh == b->src.fh) &&
+           (a->src.format == b->src.format) &&
+           (a->src.cacheable == b->src.cacheable) &&
+           (a->src.mem_type == b->src.mem_type) &&
+           (a->src.drmMode == b->src.drmMode) &&
+           (a->dst.x == b->dst.x) && (a->dst.y == b->dst.y) &&
+           (a->dst.w == b->dst.w) && (a->dst.h == b->dst.h) &&
+           (a->dst.fw == b->dst.fw) && (a->dst.fh == b->dst.fh) &&
+           (a->dst.format == b->dst.format) &&
+           (a->dst.cacheable == b->dst.cacheable) &&
+           (a->dst.mem_type == b->dst.mem_type) &&
+           (a->dst.drmMode == b->dst.drmMode) &&
+           (a->dst.rot == b->dst.rot);
+}
+
+/*
+ * Dequeues the oldest job of the batch, the in-flight jobs are kept in
+ * submission order in ring.
+ */
+static int m_gsc_batch_complete(CGscaler *gsc, exynos_gsc_job *jobs,
+                                int *ring, int *head, int *pending)
+{
+    exynos_gsc_job *job = &jobs[ring[*head]];
+    int ret;
+
+    ret = gsc->m_gsc_m2m_wait_frame_done(gsc);
+    job->time_ns = m_gsc_now() - job->time_ns;
+    if (ret < 0)
+        job->status = -1;
+
+    *head = (*head + 1) % GSC_M2M_MAX_QUEUE_DEPTH;
+    (*pending)--;
+
+    return ret;
+}
+
+int CGscaler::m_gsc_m2m_run_batch(void *handle, exynos_gsc_job *jobs,
+                                  int count, exynos_gsc_batch_stats *stats)
+{
+    int ring[GSC_M2M_MAX_QUEUE_DEPTH];
+    int head = 0, pending = 0;
+    unsigned long saved, restarts_avoided = 0;
+    long long start;
+    bool restart;
+    bool *done;
+    int i, j, n = 0;
+    exynos_gsc_job *job;
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+
+    done = new bool[count];
+    memset(done, 0, count * sizeof(bool));
+    memset(stats, 0, sizeof(*stats));
+    saved = gsc->src_info.ioctls_saved + gsc->dst_info.ioctls_saved;
+    start = m_gsc_now();
+
+    /*
+     * Jobs are grouped by configuration, keeping their order within a
+     * group, so that every configuration is programmed once.
+     */
+    for (i = 0; i < count; i++) {
+        if (done[i])
+            continue;
+
+        for (j = i; j < count; j++) {
+            if (done[j] || !m_gsc_same_config(&jobs[i], &jobs[j]))
+                continue;
+            done[j] = true;
+            job = &jobs[j];
+            job->status = 0;
+            n++;
+
+            if (gsc->m_gsc_m2m_config(handle, &job->src, &job->dst) < 0) {
+                ALOGE("%s::job %d: m_gsc_m2m_config fail", __func__, j);
+                job->status = -1;
+                job->time_ns = 0;
+                /* the job is never queued, consume its fences here */
+                if (job->src.acquireFenceFd >= 0) {
+                    close(job->src.acquireFenceFd);
+                    job->src.acquireFenceFd = -1;
+                }
+                if (job->dst.acquireFenceFd >= 0) {
+                    close(job->dst.acquireFenceFd);
+                    job->dst.acquireFenceFd = -1;
+                }
+                continue;
+            }
+
+            /* the job restarts the stream unless it is queued on a running one */
+            restart = gsc->src_info.dirty || gsc->dst_info.dirty ||
+                      !gsc->src_info.stream_on;
+
+            /* a new configuration drains the unit, collect those first */
+            if (gsc->src_info.dirty || gsc->dst_info.dirty) {
+                stats->reconfigs++;
+                while (pending > 0)
+                    m_gsc_batch_complete(gsc, jobs, ring, &head, &pending);
+            } else if (pending >= gsc->queue_depth) {
+                m_gsc_batch_complete(gsc, jobs, ring, &head, &pending);
+            }
+
+            job->time_ns = m_gsc_now();
+            if (gsc->m_gsc_m2m_run(handle, &job->src, &job->dst) < 0) {
+                ALOGE("%s::job %d: m_gsc_m2m_run fail", __func__, j);
+                job->status = -1;
+                job->time_ns = 0;
+                /* stop the unit, which drops the jobs still queued */
+                gsc->m_gsc_m2m_stop(handle);
+                while (pending > 0) {
+                    jobs[ring[head]].status = -1;
+                    head = (head + 1) % GSC_M2M_MAX_QUEUE_DEPTH;
+                    pending--;
+                }
+                continue;
+            }
+
+            /* the batch waits for completion, the fences are not needed */
+            if (job->src.releaseFenceFd >= 0) {
+                close(job->src.releaseFenceFd);
+                job->src.releaseFenceFd = -1;
+            }
+            if (job->dst.releaseFenceFd >= 0) {
+                close(job->dst.releaseFenceFd);
+                job->dst.releaseFenceFd = -1;
+            }
+
+            if (!restart)
+                restarts_avoided++;
+
+            ring[(head + pending) % GSC_M2M_MAX_QUEUE_DEPTH] = j;
+            pending++;
+        }
+    }
+
+    while (pending > 0)
+        m_gsc_batch_complete(gsc, jobs, ring, &head, &pending);
+
+    for (i = 0; i < count; i++) {
+        if (jobs[i].status < 0)
+            stats->failed++;
+    }
+    stats->jobs = n;
+    stats->total_ns = m_gsc_now() - start;
+    stats->ioctls_saved = gsc->src_info.ioctls_saved +
+                          gsc->dst_info.ioctls_saved - saved;
+    /* exynos_gsc_convert() stops and restarts the unit for every job */
+    stats->ioctls_saved += restarts_avoided * GSC_STOP_START_IOCTLS;
+
+    delete[] done;
+
+    return stats->failed ? -1 : 0;
+}
+
+int CGscaler::m_gsc_m2m_run_tiled(void *handle, exynos_mpp_img *src_img,
+                                  exynos_mpp_img *dst_img)
+{
+    unsigned int sx[GSC_MAX_TILES + 1], sy[GSC_MAX_TILES + 1];
+    unsigned int ox[GSC_MAX_TILES + 1], oy[GSC_MAX_TILES + 1];
+    unsigned int out_w, out_h, max_w, max_h;
+    exynos_gsc_batch_stats stats;
+    exynos_gsc_job *jobs, *job;
+    bool rot90 = !!(dst_img->rot & HAL_TRANSFORM_ROT_90);
+    int nx, ny, i, j, ret;
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+
+    if ((src_img->fw > GSC_MAX_FRAME_W) || (src_img->fh > GSC_MAX_FRAME_H) ||
+            (dst_img->fw > GSC_MAX_FRAME_W) || (dst_img->fh > GSC_MAX_FRAME_H)) {
+        ALOGE("%s::buffer too large (src %ux%u dst %ux%u)", __func__,
+              src_img->fw, src_img->fh, dst_img->fw, dst_img->fh);
+        return -1;
+    }
+
+    /* the output extent in source orientation */
+    out_w = rot90 ? dst_img->h : dst_img->w;
+    out_h = rot90 ? dst_img->w : dst_img->h;
+    max_w = rot90 ? GSC_MAX_ROT_CROP_W : GSC_MAX_CROP_W;
+    max_h = rot90 ? GSC_MAX_ROT_CROP_H : GSC_MAX_CROP_H;
+
+    nx = m_gsc_tile_axis(src_img->w, out_w, max_w, sx, ox);
+    ny = m_gsc_tile_axis(src_img->h, out_h, max_h, sy, oy);
+    if ((nx < 0) || (ny < 0)) {
+        ALOGE("%s::cannot tile %ux%u -> %ux%u", __func__,
+              src_img->w, src_img->h, dst_img->w, dst_img->h);
+        return -1;
+    }
+
+    jobs = new exynos_gsc_job[nx * ny];
+
+    for (j = 0; j < ny; j++) {
+        for (i = 0; i < nx; i++) {
+            job = &jobs[j * nx + i];
+            m_gsc_make_tile(job, src_img, dst_img, sx[i], sx[i + 1],
+                            sy[j], sy[j + 1], ox[i], ox[i + 1],
+                            oy[j], oy[j + 1]);
+
+            /* the first tile waits for the buffers, the rest queue behind it */
+            if (j || i) {
+                job->src.acquireFenceFd = -1;
+                job->dst.acquireFenceFd = -1;
+            }
+        }
+    }
+
+    ALOGV("%s::%ux%u -> %ux%u in %dx%d tiles", __func__, src_img->w,
+          src_img->h, dst_img->w, dst_img->h, nx, ny);
+
+    ret = gsc->m_gsc_m2m_run_batch(handle, jobs, nx * ny, &stats);
+
+    /* the batch consumed the acquire fences and completed every tile */
+    src_img->acquireFenceFd = -1;
+    dst_img->acquireFenceFd = -1;
+    src_img->releaseFenceFd = -1;
+    dst_img->releaseFenceFd = -1;
+
+    delete[] jobs;
+
+    return ret;
+}
+
+/*
+ * Takes a second unit for split conversions, without waiting for one.
+ * The peer is an ordinary M2M handle holding its unit until released.
+ */
+int CGscaler::m_gsc_m2m_acquire_peer(void *handle)
+{
+    CGscaler *peer;
+    unsigned int mask = 0;
+    int i, unit;
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+
+    if (gsc->split_peer)
+        return 0;
+
+    peer = new CGscaler(GSC_M2M_MODE);
+    peer->priority = gsc->priority;
+    peer->queue_depth = gsc->queue_depth;
+
+    for (i = 0; i < NUM_OF_GSC_HW; i++) {
+#ifndef USES_ONLY_GSC0_GSC1
+        if (i == 0 || i == 3 || i == gsc->gsc_id)
+#else
+        if (i == 0 || i == gsc->gsc_id)
+#endif
+            continue;
+        mask |= 1 << i;
+    }
+
+    unit = gsc_arbiter_acquire(peer->priority, mask, 0);
+    if (unit >= 0) {
+        peer->gsc_id = unit;
+        peer->gsc_fd = peer->m_gsc_m2m_create(unit);
+        if (peer->gsc_fd < 0) {
+            peer->gsc_fd = 0;
+            gsc_arbiter_release(unit, true);
+        } else {
+            peer->arb_unit = unit;
+        }
+    } else if (unit == -ENODEV) {
+        /* no arbiter, take whichever unit opens */
+        for (i = 0; i < NUM_OF_GSC_HW; i++) {
+            if (!(mask & (1 << i)))
+                continue;
+            peer->gsc_id = i;
+            peer->gsc_fd = peer->m_gsc_m2m_create(i);
+            if (peer->gsc_fd > 0)
+                break;
+            peer->gsc_fd = 0;
+        }
+    }
+
+    if (peer->gsc_fd <= 0) {
+        ALOGV("%s::no second unit free for gsc%d", __func__, gsc->gsc_id);
+        delete peer;
+        return -1;
+    }
+
+    gsc->split_peer = peer;
+
+    return 0;
+}
+
+void CGscaler::m_gsc_m2m_release_peer(void *handle)
+{
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL || gsc->split_peer == NULL)
+        return;
+
+    gsc->split_peer->m_gsc_m2m_destroy(gsc->split_peer);
+    delete gsc->split_peer;
+    gsc->split_peer = NULL;
+}
+
+/* Runs one job on a handle and leaves it queued */
+static int m_gsc_queue_job(CGscaler *gsc, exynos_gsc_job *job)
+{
+    if (gsc->m_gsc_m2m_config(gsc, &job->src, &job->dst) < 0 ||
+            gsc->m_gsc_m2m_run(gsc, &job->src, &job->dst) < 0)
+        return -1;
+
+    if (job->src.releaseFenceFd >= 0) {
+        close(job->src.releaseFenceFd);
+        job->src.releaseFenceFd = -1;
+    }
+    if (job->dst.releaseFenceFd >= 0) {
+        close(job->dst.releaseFenceFd);
+        job->dst.releaseFenceFd = -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Cuts the conversion in two strips across the longer output axis and runs
+ * them on this unit and the peer at the same time. The seam is placed like
+ * the tile seams, see m_gsc_split_axis(): the pixels next to it are not
+ * those of a single pass, gsc_tile_test models by how much, nothing checks
+ * it on the hardware.
+ */
+int CGscaler::m_gsc_m2m_run_split(void *handle, exynos_mpp_img *src_img,
+                                  exynos_mpp_img *dst_img)
+{
+    unsigned int sb[3], ob[3];
+    unsigned int out_w, out_h;
+    exynos_gsc_job jobs[2];
+    bool rot90 = !!(dst_img->rot & HAL_TRANSFORM_ROT_90);
+    bool split = false;
+    int ret = 0;
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+
+    out_w = rot90 ? dst_img->h : dst_img->w;
+    out_h = rot90 ? dst_img->w : dst_img->h;
+
+    if (gsc->split_peer) {
+        if (out_w >= out_h) {
+            split = (src_img->w / 2 >= GSC_MIN_SRC_W_SIZE) &&
+                    m_gsc_split_axis(src_img->w, out_w, 2,
+                        rot90 ? GSC_MAX_ROT_CROP_W : GSC_MAX_CROP_W, sb, ob);
+            if (split) {
+                m_gsc_make_tile(&jobs[0], src_img, dst_img, sb[0], sb[1],
+                                0, src_img->h, ob[0], ob[1], 0, out_h);
+                m_gsc_make_tile(&jobs[1], src_img, dst_img, sb[1], sb[2],
+                                0, src_img->h, ob[1], ob[2], 0, out_h);
+            }
+        } else {
+            split = (src_img->h / 2 >= GSC_MIN_SRC_H_SIZE) &&
+                    m_gsc_split_axis(src_img->h, out_h, 2,
+                        rot90 ? GSC_MAX_ROT_CROP_H : GSC_MAX_CROP_H, sb, ob);
+            if (split) {
+                m_gsc_make_tile(&jobs[0], src_img, dst_img, 0, src_img->w,
+                                sb[0], sb[1], 0, out_w, ob[0], ob[1]);
+                m_gsc_make_tile(&jobs[1], src_img, dst_img, 0, src_img->w,
+                                sb[1], sb[2], 0, out_w, ob[1], ob[2]);
+            }
+        }
+    }
+
+    if (!split) {
+        memcpy(&jobs[0].src, src_img, sizeof(*src_img));
+        memcpy(&jobs[0].dst, dst_img, sizeof(*dst_img));
+        if (m_gsc_queue_job(gsc, &jobs[0]) < 0 || gsc->m_gsc_m2m_drain(gsc) < 0)
+            ret = -1;
+        goto out;
+    }
+
+    /* the peer takes the colour settings of this handle, which may change */
+    if ((gsc->split_peer->eq_auto != gsc->eq_auto) ||
+            (gsc->split_peer->range_full != gsc->range_full) ||
+            (gsc->split_peer->v4l2_colorspace != gsc->v4l2_colorspace)) {
+        gsc->split_peer->eq_auto = gsc->eq_auto;
+        gsc->split_peer->range_full = gsc->range_full;
+        gsc->split_peer->v4l2_colorspace = gsc->v4l2_colorspace;
+        gsc->split_peer->dst_info.dirty = true;
+    }
+
+    /* both strips wait for the same buffers */
+    jobs[1].src.acquireFenceFd = (src_img->acquireFenceFd >= 0) ?
+                                 dup(src_img->acquireFenceFd) : -1;
+    jobs[1].dst.acquireFenceFd = (dst_img->acquireFenceFd >= 0) ?
+                                 dup(dst_img->acquireFenceFd) : -1;
+
+    if (m_gsc_queue_job(gsc, &jobs[0]) < 0) {
+        ALOGE("%s::first strip on gsc%d fail", __func__, gsc->gsc_id);
+        ret = -1;
+    }
+
+    if (m_gsc_queue_job(gsc->split_peer, &jobs[1]) < 0) {
+        ALOGE("%s::second strip on gsc%d fail", __func__,
+              gsc->split_peer->gsc_id);
+        ret = -1;
+    }
+    if (jobs[1].src.acquireFenceFd >= 0)
+        close(jobs[1].src.acquireFenceFd);
+    if (jobs[1].dst.acquireFenceFd >= 0)
+        close(jobs[1].dst.acquireFenceFd);
+
+    if (gsc->src_info.stream_on && gsc->m_gsc_m2m_drain(gsc) < 0)
+        ret = -1;
+    if (gsc->split_peer->src_info.stream_on &&
+            gsc->split_peer->m_gsc_m2m_drain(gsc->split_peer) < 0)
+        ret = -1;
+
+out:
+    /* m_gsc_m2m_run consumed the acquire fences and every strip is done */
+    src_img->acquireFenceFd = -1;
+    dst_img->acquireFenceFd = -1;
+    src_img->releaseFenceFd = -1;
+    dst_img->releaseFenceFd = -1;
+
+    return ret;
+}
+
+/*
+ * Stops both queues for a new format, keeping their buffers and the
+ * content protection state, unlike m_gsc_m2m_stop().
+ */
+int CGscaler::m_gsc_m2m_streamoff(void *handle)
+{
+    int ret = 0;
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+
+    if (gsc->src_info.stream_on == true) {
+        if (exynos_v4l2_streamoff(gsc->gsc_fd,
+            gsc->src_info.buf.buf_type) < 0) {
+            ALOGE("%s::exynos_v4l2_streamoff(src) fail", __func__);
+            ret = -1;
+        }
+        gsc->src_info.stream_on = false;
+    }
+
+    if (gsc->dst_info.stream_on == true) {
+        if (exynos_v4l2_streamoff(gsc->gsc_fd,
+            gsc->dst_info.buf.buf_type) < 0) {
+            ALOGE("%s::exynos_v4l2_streamoff(dst) fail", __func__);
+            ret = -1;
+        }
+        gsc->dst_info.stream_on = false;
+    }
+
+    gsc->src_info.qbuf_cnt = 0;
+    gsc->src_info.buf.src_buf_idx = 0;
+    gsc->dst_info.qbuf_cnt = 0;
+    gsc->dst_info.buf.src_buf_idx = 0;
+    gsc->m_gsc_event_track();
+
+    return ret;
+}
+
+void CGscaler::m_gsc_session_save(int idx)
+{
+    sessions[idx].fd = gsc_fd;
+    memcpy(&sessions[idx].src_info, &src_info, sizeof(GscInfo));
+    memcpy(&sessions[idx].dst_info, &dst_info, sizeof(GscInfo));
+    memcpy(&sessions[idx].hw_csc, &hw_csc, sizeof(hw_csc));
+}
+
+void CGscaler::m_gsc_session_load(int idx)
+{
+    gsc_fd = sessions[idx].fd;
+    memcpy(&src_info, &sessions[idx].src_info, sizeof(GscInfo));
+    memcpy(&dst_info, &sessions[idx].dst_info, sizeof(GscInfo));
+    memcpy(&hw_csc, &sessions[idx].hw_csc, sizeof(hw_csc));
+}
+
+/* Stops and closes a session other than the current one */
+void CGscaler::m_gsc_session_close(void *handle, int idx)
+{
+    m_gsc_session_save(cur_session);
+    m_gsc_session_load(idx);
+    m_gsc_m2m_stop(handle);
+    if (0 < gsc_fd) {
+        /* closing drops it from event_fd, the number may come back */
+        if (gsc_fd == event_target)
+            event_target = -1;
+        close(gsc_fd);
+    }
+    m_gsc_session_load(cur_session);
+    sessions[idx].fd = 0;
+}
+
+/*
+ * The fd handed out by exynos_gsc_get_event_fd() is an epoll fd watching
+ * the context of the current session, so it stays valid when sessions are
+ * switched or closed.
+ */
+int CGscaler::m_gsc_m2m_event_fd(void)
+{
+    if (event_fd < 0) {
+        event_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (event_fd < 0) {
+            ALOGE("%s::epoll_create1 fail (%d)", __func__, errno);
+            return -1;
+        }
+    }
+
+    m_gsc_event_track();
+
+    return event_fd;
+}
+
+/*
+ * Points event_fd at the current context while it has a job queued. A
+ * context with no buffer queued polls POLLERR, which epoll reports whatever
+ * it asks for, so an idle context would keep event_fd readable. Called
+ * whenever dst_info.qbuf_cnt changes.
+ */
+void CGscaler::m_gsc_event_track(void)
+{
+    struct epoll_event ev;
+    int target = (dst_info.qbuf_cnt > 0) ? gsc_fd : -1;
+
+    if ((event_fd < 0) || (event_target == target))
+        return;
+
+    if (event_target > 0)
+        epoll_ctl(event_fd, EPOLL_CTL_DEL, event_target, NULL);
+    event_target = -1;
+
+    if (target < 0)
+        return;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    if (epoll_ctl(event_fd, EPOLL_CTL_ADD, gsc_fd, &ev) < 0) {
+        ALOGE("%s::epoll_ctl(%d) fail (%d)", __func__, gsc_fd, errno);
+        return;
+    }
+    event_target = gsc_fd;
+}
+
+/*
+ * Every session is a driver context of its own on the unit, opened on the
+ * same video node. Switching only swaps the fd and the shadowed state, the
+ * formats and buffers programmed in the context stay valid.
+ */
+int CGscaler::m_gsc_m2m_select_session(void *handle, const char *name)
+{
+    GscSession *session;
+    int i, idx, fd;
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+
+    if (gsc->nr_sessions == 0) {
+        /* the context opened at create time becomes the first session */
+        session = &gsc->sessions[0];
+        memset(session, 0, sizeof(*session));
+        strncpy(session->name, name, sizeof(session->name) - 1);
+        session->last_used = ++gsc->session_clock;
+        gsc->nr_sessions = 1;
+        gsc->cur_session = 0;
+        return 0;
+    }
+
+    for (i = 0; i < gsc->nr_sessions; i++) {
+        if (!strncmp(gsc->sessions[i].name, name, sizeof(gsc->sessions[i].name) - 1))
+            break;
+    }
+
+    if (i == gsc->cur_session) {
+        gsc->sessions[i].last_used = ++gsc->session_clock;
+        return 0;
+    }
+
+    /* the jobs of a context that is not current could not be dequeued */
+    if (gsc->src_info.stream_on && gsc->m_gsc_m2m_drain(handle) < 0) {
+        ALOGE("%s::m_gsc_m2m_drain fail", __func__);
+        return -1;
+    }
+
+    if (i < gsc->nr_sessions) {
+        gsc->m_gsc_session_save(gsc->cur_session);
+        gsc->m_gsc_session_load(i);
+        gsc->cur_session = i;
+        gsc->sessions[i].last_used = ++gsc->session_clock;
+        gsc->m_gsc_event_track();
+        return 0;
+    }
+
+    if (gsc->nr_sessions < GSC_MAX_SESSIONS) {
+        idx = gsc->nr_sessions;
+    } else {
+        /* reuse the least recently used session */
+        idx = -1;
+        for (i = 0; i < gsc->nr_sessions; i++) {
+            if ((i != gsc->cur_session) && ((idx < 0) ||
+                    (gsc->sessions[i].last_used < gsc->sessions[idx].last_used)))
+                idx = i;
+        }
+        ALOGV("%s::closing session %s for %s", __func__,
+              gsc->sessions[idx].name, name);
+        gsc->m_gsc_session_close(handle, idx);
+    }
+
+    fd = gsc->m_gsc_m2m_create(gsc->gsc_id);
+    if (fd < 0) {
+        ALOGE("%s::no context left on gsc%d for session %s", __func__,
+              gsc->gsc_id, name);
+        if (idx < gsc->nr_sessions) {
+            /* drop the slot of the closed session */
+            gsc->nr_sessions--;
+            if (gsc->cur_session == gsc->nr_sessions)
+                gsc->cur_session = idx;
+            if (idx != gsc->nr_sessions)
+                memcpy(&gsc->sessions[idx], &gsc->sessions[gsc->nr_sessions],
+                       sizeof(GscSession));
+        }
+        return -1;
+    }
+
+    gsc->m_gsc_session_save(gsc->cur_session);
+
+    /* the new context starts from the requested configuration */
+    session = &gsc->sessions[idx];
+    memset(session->name, 0, sizeof(session->name));
+    strncpy(session->name, name, sizeof(session->name) - 1);
+    session->last_used = ++gsc->session_clock;
+    if (idx == gsc->nr_sessions)
+        gsc->nr_sessions++;
+
+    gsc->gsc_fd = fd;
+    memset(&gsc->src_info.hw, 0, sizeof(gsc->src_info.hw));
+    memset(&gsc->dst_info.hw, 0, sizeof(gsc->dst_info.hw));
+    gsc->src_info.stream_on = false;
+    gsc->dst_info.stream_on = false;
+    gsc->src_info.qbuf_cnt = 0;
+    gsc->dst_info.qbuf_cnt = 0;
+    gsc->src_info.buf.src_buf_idx = 0;
+    gsc->dst_info.buf.src_buf_idx = 0;
+    gsc->src_info.dirty = true;
+    gsc->dst_info.dirty = true;
+    memset(&gsc->hw_csc, 0, sizeof(gsc->hw_csc));
+    gsc->cur_session = idx;
+    gsc->m_gsc_event_track();
+
+    return 0;
+}
+
+/*
+ * Dequeues the jobs that are already done without blocking. The capture
+ * queue signals POLLIN for each finished destination buffer, and the source
+ * buffer of a job is always released before its destination.
+ */
+int CGscaler::m_gsc_m2m_reap(void *handle)
+{
+    struct pollfd pfd;
+    int reaped = 0;
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+
+    pfd.fd = gsc->gsc_fd;
+    pfd.events = POLLIN;
+
+    while (gsc->dst_info.qbuf_cnt > 0) {
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & POLLIN))
+            break;
+
+        if (gsc->m_gsc_m2m_wait_frame_done(handle) < 0)
+            return -1;
+        reaped++;
+    }
+
+    return reaped;
+}
+
+bool CGscaler::m_gsc_dqbuf(int fd, GscInfo *info)
+{
+    struct v4l2_buffer buffer;
+    struct v4l2_plane  planes[NUM_OF_GSC_PLANES];
+
+    memset(&buffer, 0, sizeof(buffer));
+    memset(planes, 0, sizeof(planes));
+
+    buffer.type     = info->buf.buf_type;
+    buffer.memory   = info->buf.mem_type;
+    buffer.m.planes = planes;
+    buffer.length   = info->format.fmt.pix_mp.num_planes;
+
+    if (exynos_v4l2_dqbuf(fd, &buffer) < 0)
+        return false;
+
+    info->qbuf_cnt--;
+    info->buf.buffer_queued = info->qbuf_cnt > 0;
+
+    return true;
+}
+
+/*
+ * True if the buffers of the queue have to be requested again, which also
+ * requires the queue to be streamed off.
+ */
+bool CGscaler::m_gsc_needs_reqbufs(GscInfo *info, int buf_count)
+{
+    return !info->hw.fmt_valid || !info->hw.bufs_valid ||
+           (info->hw.width != info->width) ||
+           (info->hw.height != info->height) ||
+           (info->hw.v4l2_colorformat != info->v4l2_colorformat) ||
+           (info->hw.buf_count != buf_count) ||
+           (info->hw.mem_type != info->buf.mem_type) ||
+           (info->hw.mode_drm != info->mode_drm);
+}
+
 bool CGscaler::m_gsc_set_format(int fd, GscInfo *info)
 {
     Exynos_gsc_In();
 
     struct v4l2_requestbuffers req_buf;
     int                        plane_count;
+    bool                       valid = info->hw.fmt_valid;
+    bool                       fmt_changed;
+    bool                       realloc;
 
     plane_count = m_gsc_get_plane_count(info->v4l2_colorformat);
     if (plane_count < 0) {
@@ -837,56 +1736,120 @@ bool CGscaler::m_gsc_set_format(int fd, GscInfo *info)
         return false;
     }
 
-    if (exynos_v4l2_s_ctrl(fd, V4L2_CID_ROTATE, info->rotation) < 0) {
-        ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_ROTATE) fail", __func__);
-        return false;
+    fmt_changed = !valid || (info->hw.width != info->width) ||
+                  (info->hw.height != info->height) ||
+                  (info->hw.v4l2_colorformat != info->v4l2_colorformat);
+    realloc = m_gsc_needs_reqbufs(info, info->buf_count);
+
+    /* if anything below fails, the next call programs everything again */
+    info->hw.fmt_valid = false;
+
+    if (!valid || (info->hw.rotation != info->rotation)) {
+        if (exynos_v4l2_s_ctrl(fd, V4L2_CID_ROTATE, info->rotation) < 0) {
+            ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_ROTATE) fail", __func__);
+            return false;
+        }
+    } else {
+        info->ioctls_saved++;
     }
 
-    if (exynos_v4l2_s_ctrl(fd, V4L2_CID_VFLIP, info->flip_horizontal) < 0) {
-        ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_VFLIP) fail", __func__);
-        return false;
+    if (!valid || (info->hw.flip_horizontal != info->flip_horizontal)) {
+        if (exynos_v4l2_s_ctrl(fd, V4L2_CID_VFLIP, info->flip_horizontal) < 0) {
+            ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_VFLIP) fail", __func__);
+            return false;
+        }
+    } else {
+        info->ioctls_saved++;
     }
 
-    if (exynos_v4l2_s_ctrl(fd, V4L2_CID_HFLIP, info->flip_vertical) < 0) {
-        ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_HFLIP) fail", __func__);
-        return false;
+    if (!valid || (info->hw.flip_vertical != info->flip_vertical)) {
+        if (exynos_v4l2_s_ctrl(fd, V4L2_CID_HFLIP, info->flip_vertical) < 0) {
+            ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_HFLIP) fail", __func__);
+            return false;
+        }
+    } else {
+        info->ioctls_saved++;
     }
 
-    info->format.type = info->buf.buf_type;
-    info->format.fmt.pix_mp.width       = info->width;
-    info->format.fmt.pix_mp.height      = info->height;
-    info->format.fmt.pix_mp.pixelformat = info->v4l2_colorformat;
-    info->format.fmt.pix_mp.field       = V4L2_FIELD_ANY;
-    info->format.fmt.pix_mp.num_planes  = plane_count;
+    if (fmt_changed) {
+        info->format.type = info->buf.buf_type;
+        info->format.fmt.pix_mp.width       = info->width;
+        info->format.fmt.pix_mp.height      = info->height;
+        info->format.fmt.pix_mp.pixelformat = info->v4l2_colorformat;
+        info->format.fmt.pix_mp.field       = V4L2_FIELD_ANY;
+        info->format.fmt.pix_mp.num_planes  = plane_count;
 
-    if (exynos_v4l2_s_fmt(fd, &info->format) < 0) {
-        ALOGE("%s::exynos_v4l2_s_fmt() fail", __func__);
-        return false;
+        if (exynos_v4l2_s_fmt(fd, &info->format) < 0) {
+            ALOGE("%s::exynos_v4l2_s_fmt() fail", __func__);
+            return false;
+        }
+    } else {
+        info->ioctls_saved++;
     }
 
-    info->crop.type     = info->buf.buf_type;
-    info->crop.c.left   = info->crop_left;
-    info->crop.c.top    = info->crop_top;
-    info->crop.c.width  = info->crop_width;
-    info->crop.c.height = info->crop_height;
+    if (!valid || (info->hw.crop_left != info->crop_left) ||
+            (info->hw.crop_top != info->crop_top) ||
+            (info->hw.crop_width != info->crop_width) ||
+            (info->hw.crop_height != info->crop_height)) {
+        info->crop.type     = info->buf.buf_type;
+        info->crop.c.left   = info->crop_left;
+        info->crop.c.top    = info->crop_top;
+        info->crop.c.width  = info->crop_width;
+        info->crop.c.height = info->crop_height;
 
-    if (exynos_v4l2_s_crop(fd, &info->crop) < 0) {
-        ALOGE("%s::exynos_v4l2_s_crop() fail", __func__);
-        return false;
+        if (exynos_v4l2_s_crop(fd, &info->crop) < 0) {
+            ALOGE("%s::exynos_v4l2_s_crop() fail", __func__);
+            return false;
+        }
+    } else {
+        info->ioctls_saved++;
     }
 
-    if (exynos_v4l2_s_ctrl(fd, V4L2_CID_CACHEABLE, info->cacheable) < 0) {
-        ALOGE("%s::exynos_v4l2_s_ctrl() fail", __func__);
-        return false;
+    if (!valid || (info->hw.cacheable != info->cacheable)) {
+        if (exynos_v4l2_s_ctrl(fd, V4L2_CID_CACHEABLE, info->cacheable) < 0) {
+            ALOGE("%s::exynos_v4l2_s_ctrl() fail", __func__);
+            return false;
+        }
+    } else {
+        info->ioctls_saved++;
     }
 
-    req_buf.count  = 1;
-    req_buf.type   = info->buf.buf_type;
-    req_buf.memory = info->buf.mem_type;
-    if (exynos_v4l2_reqbufs(fd, &req_buf) < 0) {
-        ALOGE("%s::exynos_v4l2_reqbufs() fail", __func__);
-        return false;
-    }
+    if (realloc) {
+        info->hw.bufs_valid = false;
+
+        req_buf.count  = info->buf_count > 0 ? info->buf_count : 1;
+        req_buf.type   = info->buf.buf_type;
+        req_buf.memory = info->buf.mem_type;
+        if (exynos_v4l2_reqbufs(fd, &req_buf) < 0) {
+            ALOGE("%s::exynos_v4l2_reqbufs() fail", __func__);
+            return false;
+        }
+
+        info->hw.bufs_valid = true;
+        info->hw.buf_count  = info->buf_count;
+        info->hw.mem_type   = info->buf.mem_type;
+        info->hw.mode_drm   = info->mode_drm;
+        /* the driver may grant fewer buffers than requested */
+        info->hw.granted    = req_buf.count;
+        info->qbuf_cnt = 0;
+        info->buf.src_buf_idx = 0;
+    } else {
+        info->ioctls_saved++;
+    }
+    info->buf_count = info->hw.granted;
+
+    info->hw.width            = info->width;
+    info->hw.height           = info->height;
+    info->hw.crop_left        = info->crop_left;
+    info->hw.crop_top         = info->crop_top;
+    info->hw.crop_width       = info->crop_width;
+    info->hw.crop_height      = info->crop_height;
+    info->hw.v4l2_colorformat = info->v4l2_colorformat;
+    info->hw.cacheable        = info->cacheable;
+    info->hw.rotation         = info->rotation;
+    info->hw.flip_horizontal  = info->flip_horizontal;
+    info->hw.flip_vertical    = info->flip_vertical;
+    info->hw.fmt_valid        = true;
 
     Exynos_gsc_Out();
 
@@ -942,7 +1905,7 @@ bool CGscaler::m_gsc_set_addr(int fd, GscInfo *info)
     CGscaler::m_gsc_get_plane_size(plane_size, info->width,
                          info->height, info->v4l2_colorformat);
 
-    info->buf.buffer.index    = 0;
+    info->buf.buffer.index    = info->buf.src_buf_idx;
     info->buf.buffer.flags    = V4L2_BUF_FLAG_USE_SYNC;
     info->buf.buffer.type     = info->buf.buf_type;
     info->buf.buffer.memory   = info->buf.mem_type;
@@ -965,6 +1928,9 @@ bool CGscaler::m_gsc_set_addr(int fd, GscInfo *info)
         return false;
     }
     info->buf.buffer_queued = true;
+    if (++info->buf.src_buf_idx >= info->buf_count)
+        info->buf.src_buf_idx = 0;
+    info->qbuf_cnt++;
 
     info->releaseFenceFd = info->buf.buffer.reserved;
 
@@ -35,6 +35,8 @@ extern "C" {
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <errno.h>
+#include <poll.h>
 #include <system/graphics.h>
 #include "exynos_gscaler.h"
 
@@ -53,6 +55,8 @@ extern "C" {
 #define MIXER_V_SUBDEV_PAD_SOURCE   (3)
 #define FIMD_SUBDEV_PAD_SINK     (0)
 #define MAX_BUFFERS                 (6)
+/* Jobs that may be in flight in M2M mode, see exynos_gsc_set_queue_depth() */
+#define GSC_M2M_MAX_QUEUE_DEPTH     MAX_BUFFERS
 
 #ifdef USES_DT
 #define NUM_OF_GSC_HW               (3)
@@ -90,9 +94,45 @@ extern "C" {
 #define GSC_MIN_DST_W_SIZE (32)
 #define GSC_MIN_DST_H_SIZE (16)
 
+/* largest crop the scaler takes per pass, larger ones are tiled */
+#define GSC_MAX_CROP_W              (4800)
+#define GSC_MAX_CROP_H              (3344)
+#define GSC_MAX_ROT_CROP_W          (2048)
+#define GSC_MAX_ROT_CROP_H          (2048)
+/* largest buffer a tile can be cropped from */
+#define GSC_MAX_FRAME_W             (8192)
+#define GSC_MAX_FRAME_H             (8192)
+#define GSC_MAX_TILES               (8)     /* per axis */
+#define GSC_TILE_ALIGN              (8)
+
+/* streamoff and REQBUFS(0) of both queues, content protection, streamon */
+#define GSC_STOP_START_IOCTLS       (7)
+
 #define MAX_GSC_WAITING_TIME_FOR_TRYLOCK (16000) // 16msec
 #define GSC_WAITING_TIME_FOR_TRYLOCK      (8000) //  8msec
 
+/* lock table shared by the processes using exynos_gsc_create() */
+#ifndef GSC_ARBITER_PATH
+#define GSC_ARBITER_PATH            "/data/misc/gscaler/arbiter"
+#endif
+
+int gsc_arbiter_acquire(int priority, unsigned int mask, unsigned int timeout_us);
+void gsc_arbiter_release(int unit, bool open_failed);
+
+/* tile geometry, see libgscaler_tile.cpp */
+bool m_gsc_split_axis(unsigned int src_len, unsigned int out_len,
+                      unsigned int n, unsigned int max_len,
+                      unsigned int *src_bounds, unsigned int *out_bounds);
+int m_gsc_tile_axis(unsigned int src_len, unsigned int out_len,
+                    unsigned int max_len, unsigned int *src_bounds,
+                    unsigned int *out_bounds);
+void m_gsc_make_tile(exynos_gsc_job *job, exynos_mpp_img *src_img,
+                     exynos_mpp_img *dst_img,
+                     unsigned int sx0, unsigned int sx1,
+                     unsigned int sy0, unsigned int sy1,
+                     unsigned int ox0, unsigned int ox1,
+                     unsigned int oy0, unsigned int oy1);
+
 typedef struct GscalerInfo {
     unsigned int width;
     unsigned int height;
@@ -107,10 +147,12 @@ typedef struct GscalerInfo {
     int flip_horizontal;
     int flip_vertical;
     int qbuf_cnt;
+    int buf_count;
     int acquireFenceFd;
     int releaseFenceFd;
     bool stream_on;
     bool dirty;
+    unsigned long ioctls_saved;     /* skipped thanks to the shadowed state */
     struct v4l2_format format;
     struct v4l2_crop crop;
     struct Buffer_Info {
@@ -122,8 +164,52 @@ typedef struct GscalerInfo {
         struct v4l2_buffer buffer;
         int src_buf_idx;
     }buf;
+    /*
+     * What the driver was last given on this queue, so that unchanged
+     * controls and formats are not programmed again.
+     */
+    struct Hw_State {
+        bool fmt_valid;             /* controls, format and crop */
+        bool bufs_valid;            /* REQBUFS */
+        unsigned int width;
+        unsigned int height;
+        unsigned int crop_left;
+        unsigned int crop_top;
+        unsigned int crop_width;
+        unsigned int crop_height;
+        unsigned int v4l2_colorformat;
+        unsigned int cacheable;
+        int rotation;
+        int flip_horizontal;
+        int flip_vertical;
+        int buf_count;              /* requested */
+        int granted;                /* granted by the driver */
+        enum v4l2_memory mem_type;
+        unsigned int mode_drm;      /* protection the buffers were requested with */
+    }hw;
 }GscInfo;
 
+/* CSC controls last programmed on a driver context */
+struct GscCscState {
+    bool valid;
+    unsigned int eq_auto;
+    unsigned int range_full;
+    unsigned int v4l2_colorspace;
+};
+
+#define GSC_MAX_SESSIONS            (4)
+#define GSC_SESSION_NAME_LEN        (16)
+
+/* a named driver context of the unit, see exynos_gsc_select_session() */
+struct GscSession {
+    char name[GSC_SESSION_NAME_LEN];
+    int fd;
+    unsigned long last_used;
+    GscInfo src_info;
+    GscInfo dst_info;
+    struct GscCscState hw_csc;
+};
+
 struct MediaDevice {
     struct media_device *media0;
     struct media_entity *gsc_sd_entity;
@@ -147,6 +233,18 @@ public:
     unsigned int eq_auto;           /* 0: user, 1: auto */
     unsigned int range_full;        /* 0: narrow, 1: full */
     unsigned int v4l2_colorspace;   /* 1: 601, 3: 709, see csc.h or videodev2.h */
+    int queue_depth;                /* M2M jobs in flight before run blocks */
+    int priority;                   /* GSC_PRIORITY_*, for the arbiter */
+    int arb_unit;                   /* unit held from the arbiter, or -1 */
+    unsigned int wait_us;           /* how long creation waits for a unit */
+    struct GscCscState hw_csc;
+    struct GscSession sessions[GSC_MAX_SESSIONS];
+    int nr_sessions;                /* 0 until a session is selected */
+    int cur_session;
+    unsigned long session_clock;
+    int event_fd;                   /* epoll fd of exynos_gsc_get_event_fd(), or -1 */
+    int event_target;               /* context fd registered in event_fd, or -1 */
+    CGscaler *split_peer;           /* second unit for split conversions */
 #ifdef USES_SCALER
     void *scaler;
 #endif
@@ -161,6 +259,17 @@ public:
         out_mode = __out_mode;
         gsc_id = __gsc_id;
         allow_drm = __allow_drm;
+        queue_depth = 1;
+        priority = GSC_PRIORITY_NORMAL;
+        arb_unit = -1;
+        wait_us = MAX_GSC_WAITING_TIME_FOR_TRYLOCK;
+        memset(&hw_csc, 0, sizeof(hw_csc));
+        nr_sessions = 0;
+        cur_session = 0;
+        session_clock = 0;
+        event_fd = -1;
+        event_target = -1;
+        split_peer = NULL;
     }
 
     CGscaler(int __mode)
@@ -217,6 +326,23 @@ public:
     int m_gsc_m2m_stop(void *handle);
     int m_gsc_m2m_run_core(void *handle);
     int m_gsc_m2m_wait_frame_done(void *handle);
+    int m_gsc_m2m_drain(void *handle);
+    int m_gsc_m2m_reap(void *handle);
+    int m_gsc_m2m_streamoff(void *handle);
+    int m_gsc_m2m_run_batch(void *handle, exynos_gsc_job *jobs, int count,
+        exynos_gsc_batch_stats *stats);
+    int m_gsc_m2m_run_tiled(void *handle,
+        exynos_mpp_img *src_img, exynos_mpp_img *dst_img);
+    int m_gsc_m2m_acquire_peer(void *handle);
+    void m_gsc_m2m_release_peer(void *handle);
+    int m_gsc_m2m_run_split(void *handle,
+        exynos_mpp_img *src_img, exynos_mpp_img *dst_img);
+    int m_gsc_m2m_select_session(void *handle, const char *name);
+    void m_gsc_session_save(int idx);
+    void m_gsc_session_load(int idx);
+    void m_gsc_session_close(void *handle, int idx);
+    int m_gsc_m2m_event_fd(void);
+    void m_gsc_event_track(void);
     int m_gsc_m2m_config(void *handle,
         exynos_mpp_img *src_img, exynos_mpp_img *dst_img);
     int m_gsc_out_config(void *handle,
@@ -227,6 +353,8 @@ public:
     static bool m_gsc_set_format(int fd, GscInfo *info);
     static unsigned int m_gsc_get_plane_count(int v4l_pixel_format);
     static bool m_gsc_set_addr(int fd, GscInfo *info);
+    static bool m_gsc_dqbuf(int fd, GscInfo *info);
+    static bool m_gsc_needs_reqbufs(GscInfo *info, int buf_count);
     static unsigned int m_gsc_get_plane_size(
         unsigned int *plane_size, unsigned int width,
         unsigned int height, int v4l_pixel_format);
@@ -256,6 +384,102 @@ inline CGscaler *GetGscaler(void* handle)
 
     return gsc;
 }
+
+/*
+ * CPU backend of the LibMpp interface, for the conversions it can do with
+ * the same output layout as the scaler: no colour space conversion and no
+ * rotation. The job is done when RunMpp() returns, no release fence is made.
+ */
+class CSwMpp : public LibMpp {
+public:
+    exynos_mpp_img src_img;
+    exynos_mpp_img dst_img;
+    int ion_fd;                     /* for cache maintenance, -1 until needed */
+    bool cpu_sync_ok;               /* false once the kernel refused SYNC_FOR_CPU */
+
+    CSwMpp()
+    {
+        memset(&src_img, 0, sizeof(exynos_mpp_img));
+        memset(&dst_img, 0, sizeof(exynos_mpp_img));
+        ion_fd = -1;
+        cpu_sync_ok = true;
+    }
+    ~CSwMpp();
+    virtual int ConfigMpp(void *handle, exynos_mpp_img *src,
+                          exynos_mpp_img *dst);
+    virtual int RunMpp(void *handle, exynos_mpp_img *src,
+                       exynos_mpp_img *dst);
+    virtual int StopMpp(void *handle);
+    virtual void DestroyMpp(void *handle);
+    virtual int SetCSCProperty(void *handle, unsigned int eqAuto,
+                               unsigned int fullRange, unsigned int colorspace);
+    virtual int FreeMpp(void *handle);
+    static bool m_sw_supports(exynos_mpp_img *src, exynos_mpp_img *dst);
+    bool m_sw_can_run(exynos_mpp_img *src, exynos_mpp_img *dst);
+    static unsigned long m_sw_dst_bytes(exynos_mpp_img *dst);
+};
+
+/* running estimates of the dispatcher, in ns */
+struct GscCostModel {
+    long long hw_open_ns;           /* taking a unit and opening it */
+    long long hw_config_ns;         /* extra cost of a new configuration */
+    long long hw_fixed_ns;          /* per job: qbuf, interrupt, dqbuf */
+    long long hw_mpix_ns;           /* per million pixels */
+    long long sw_mb_ns[2];          /* per MiB written, copy and scaled */
+};
+
+/*
+ * LibMpp that runs every job on a scaler unit or on CSwMpp, whichever the
+ * cost model expects to finish first. A unit is only held while it is used.
+ */
+class CGscDispatch : public LibMpp {
+public:
+    CGscaler *hw;                   /* NULL while no unit is held */
+    CSwMpp sw;
+    exynos_mpp_img src_img;
+    exynos_mpp_img dst_img;
+    exynos_mpp_img hw_src;          /* configuration programmed on hw */
+    exynos_mpp_img hw_dst;
+    int priority;
+    bool csc_set;                   /* CSC property to program on a new unit */
+    unsigned int eq_auto;
+    unsigned int range_full;
+    unsigned int v4l2_colorspace;
+    struct GscCostModel cost;
+    exynos_gsc_dispatch_stats stats;
+    unsigned int jobs;
+    unsigned int hw_idle_jobs;      /* jobs since hw was last used */
+    long long hw_retry_at;          /* no unit was free, do not ask before */
+
+    CGscDispatch(int __priority);
+    ~CGscDispatch();
+    virtual int ConfigMpp(void *handle, exynos_mpp_img *src,
+                          exynos_mpp_img *dst);
+    virtual int RunMpp(void *handle, exynos_mpp_img *src,
+                       exynos_mpp_img *dst);
+    virtual int StopMpp(void *handle);
+    virtual void DestroyMpp(void *handle);
+    virtual int SetCSCProperty(void *handle, unsigned int eqAuto,
+                               unsigned int fullRange, unsigned int colorspace);
+    virtual int FreeMpp(void *handle);
+    int m_dispatch_run(exynos_mpp_img *src, exynos_mpp_img *dst);
+    int m_dispatch_run_hw(exynos_mpp_img *src, exynos_mpp_img *dst,
+                          bool can_wait);
+    int m_dispatch_run_sw(exynos_mpp_img *src, exynos_mpp_img *dst);
+    long long m_dispatch_hw_cost(exynos_mpp_img *src, exynos_mpp_img *dst);
+    long long m_dispatch_sw_cost(exynos_mpp_img *src, exynos_mpp_img *dst);
+    void m_dispatch_release_hw(void);
+};
+
+inline CGscDispatch *GetGscDispatch(void* handle)
+{
+    if (handle == NULL) {
+        ALOGE("%s::NULL dispatcher handle", __func__);
+        return NULL;
+    }
+
+    return reinterpret_cast<CGscDispatch *>(handle);
+}
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,433 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*!
+ * \file      libgscaler_sw.cpp
+ * \brief     CPU backend of the LibMpp interface
+ *
+ * Copies or scales images whose format is the same on both sides. The
+ * planes are laid out like the scaler reads and writes them, so a buffer
+ * written here can not be told apart from one written by a unit, except
+ * that scaled images are sampled from the nearest source pixel instead of
+ * being filtered.
+ */
+
+#include <sys/mman.h>
+#include <sync/sync.h>
+#include "ion.h"
+#include "swconverter.h"
+#include "libgscaler_obj.h"
+
+#define GSC_SW_MAX_PLANES           (3)
+#define GSC_SW_FENCE_TIMEOUT_MS     (1000)
+
+/*
+ * Per plane: bytes per sample, and the horizontal and vertical subsampling
+ * shifts relative to the image size. A packed 4:2:2 sample is a pixel pair.
+ */
+struct GscSwPlane {
+    unsigned int bpp;
+    unsigned int h_shift;
+    unsigned int v_shift;
+};
+
+struct GscSwFormat {
+    unsigned int v4l2_fmt;
+    unsigned int nr_planes;
+    bool contiguous;                /* all planes in the first buffer */
+    struct GscSwPlane planes[GSC_SW_MAX_PLANES];
+};
+
+static const struct GscSwFormat sw_formats[] = {
+    { V4L2_PIX_FMT_RGB32,   1, true,  { { 4, 0, 0 } } },
+    { V4L2_PIX_FMT_BGR32,   1, true,  { { 4, 0, 0 } } },
+    { V4L2_PIX_FMT_RGB565,  1, true,  { { 2, 0, 0 } } },
+    { V4L2_PIX_FMT_YUYV,    1, true,  { { 4, 1, 0 } } },
+    { V4L2_PIX_FMT_UYVY,    1, true,  { { 4, 1, 0 } } },
+    { V4L2_PIX_FMT_NV12,    2, true,  { { 1, 0, 0 }, { 2, 1, 1 } } },
+    { V4L2_PIX_FMT_NV21,    2, true,  { { 1, 0, 0 }, { 2, 1, 1 } } },
+    { V4L2_PIX_FMT_NV12M,   2, false, { { 1, 0, 0 }, { 2, 1, 1 } } },
+    { V4L2_PIX_FMT_NV21M,   2, false, { { 1, 0, 0 }, { 2, 1, 1 } } },
+    { V4L2_PIX_FMT_NV16,    2, true,  { { 1, 0, 0 }, { 2, 1, 0 } } },
+    { V4L2_PIX_FMT_NV61,    2, true,  { { 1, 0, 0 }, { 2, 1, 0 } } },
+    { V4L2_PIX_FMT_YUV420,  3, true,  { { 1, 0, 0 }, { 1, 1, 1 }, { 1, 1, 1 } } },
+    { V4L2_PIX_FMT_YUV420M, 3, false, { { 1, 0, 0 }, { 1, 1, 1 }, { 1, 1, 1 } } },
+};
+
+/* One image, mapped for the CPU */
+struct GscSwImage {
+    unsigned char *plane[GSC_SW_MAX_PLANES];
+    unsigned int stride[GSC_SW_MAX_PLANES];
+    void *map[GSC_SW_MAX_PLANES];   /* dma-bufs mapped with ion_map_cached() */
+    int fd[GSC_SW_MAX_PLANES];
+    unsigned int len[GSC_SW_MAX_PLANES];
+    int nr_maps;
+};
+
+static const struct GscSwFormat *m_sw_find_format(uint32_t hal_format)
+{
+    unsigned int v4l2_fmt = HAL_PIXEL_FORMAT_2_V4L2_PIX(hal_format);
+    unsigned int i;
+
+    for (i = 0; i < sizeof(sw_formats) / sizeof(sw_formats[0]); i++) {
+        if (sw_formats[i].v4l2_fmt == v4l2_fmt)
+            return &sw_formats[i];
+    }
+
+    return NULL;
+}
+
+static bool m_sw_check_img(exynos_mpp_img *img, const struct GscSwFormat *fmt)
+{
+    unsigned int i, h_mask, v_mask;
+
+    if ((img->mem_type != GSC_MEM_USERPTR) && (img->mem_type != GSC_MEM_DMABUF))
+        return false;
+    if (img->drmMode)
+        return false;
+    if (!img->w || !img->h || (img->x + img->w > img->fw) ||
+            (img->y + img->h > img->fh))
+        return false;
+
+    /* the subsampled planes must start and end on whole samples */
+    for (i = 0; i < fmt->nr_planes; i++) {
+        h_mask = (1 << fmt->planes[i].h_shift) - 1;
+        v_mask = (1 << fmt->planes[i].v_shift) - 1;
+        if ((img->x | img->w | img->fw) & h_mask)
+            return false;
+        if ((img->y | img->h | img->fh) & v_mask)
+            return false;
+    }
+
+    return true;
+}
+
+bool CSwMpp::m_sw_supports(exynos_mpp_img *src, exynos_mpp_img *dst)
+{
+    const struct GscSwFormat *fmt = m_sw_find_format(src->format);
+
+    if (!fmt || (m_sw_find_format(dst->format) != fmt))
+        return false;
+    if (src->rot || dst->rot)
+        return false;
+
+    return m_sw_check_img(src, fmt) && m_sw_check_img(dst, fmt);
+}
+
+static bool m_sw_needs_cpu_sync(exynos_mpp_img *img)
+{
+    return (img->mem_type == GSC_MEM_DMABUF) && img->cacheable;
+}
+
+/*
+ * Without IMSYNC_SYNC_FOR_CPU the CPU could read stale lines of a cached
+ * dma-buf the unit wrote, so such jobs are left to the units.
+ */
+bool CSwMpp::m_sw_can_run(exynos_mpp_img *src, exynos_mpp_img *dst)
+{
+    if (!m_sw_supports(src, dst))
+        return false;
+
+    return cpu_sync_ok || (!m_sw_needs_cpu_sync(src) && !m_sw_needs_cpu_sync(dst));
+}
+
+unsigned long CSwMpp::m_sw_dst_bytes(exynos_mpp_img *dst)
+{
+    const struct GscSwFormat *fmt = m_sw_find_format(dst->format);
+    const struct GscSwPlane *plane;
+    unsigned long bytes = 0;
+    unsigned int i;
+
+    if (!fmt)
+        return 0;
+
+    for (i = 0; i < fmt->nr_planes; i++) {
+        plane = &fmt->planes[i];
+        bytes += (unsigned long)(dst->w >> plane->h_shift) *
+                 (dst->h >> plane->v_shift) * plane->bpp;
+    }
+
+    return bytes;
+}
+
+static void m_sw_unmap(struct GscSwImage *image)
+{
+    int i;
+
+    for (i = 0; i < image->nr_maps; i++)
+        ion_unmap_cached(image->map[i]);
+    image->nr_maps = 0;
+}
+
+static bool m_sw_map(exynos_mpp_img *img, const struct GscSwFormat *fmt,
+                     struct GscSwImage *image)
+{
+    unsigned int plane_size[NUM_OF_GSC_PLANES];
+    uint32_t addr[GSC_SW_MAX_PLANES] = { img->yaddr, img->uaddr, img->vaddr };
+    unsigned char *base = NULL;
+    unsigned int i, b, offset = 0;
+    void *map;
+
+    memset(image, 0, sizeof(*image));
+    memset(plane_size, 0, sizeof(plane_size));
+    CGscaler::m_gsc_get_plane_size(plane_size, img->fw, img->fh, fmt->v4l2_fmt);
+
+    for (i = 0; i < fmt->nr_planes; i++) {
+        if ((i == 0) || !fmt->contiguous) {
+            b = fmt->contiguous ? 0 : i;
+            if (img->mem_type == GSC_MEM_DMABUF) {
+                map = ion_map_cached((int)addr[b], plane_size[b], 0);
+                if (map == MAP_FAILED) {
+                    ALOGE("%s::mapping plane %d fail", __func__, b);
+                    m_sw_unmap(image);
+                    return false;
+                }
+                image->map[image->nr_maps] = map;
+                image->fd[image->nr_maps] = (int)addr[b];
+                image->len[image->nr_maps] = plane_size[b];
+                image->nr_maps++;
+                base = (unsigned char *)map;
+            } else {
+                base = (unsigned char *)(uintptr_t)addr[b];
+            }
+            offset = 0;
+        }
+
+        image->stride[i] = (img->fw >> fmt->planes[i].h_shift) *
+                           fmt->planes[i].bpp;
+        image->plane[i] = base + offset;
+        offset += image->stride[i] * (img->fh >> fmt->planes[i].v_shift);
+    }
+
+    return true;
+}
+
+/*
+ * cached dma-bufs are shared with the units, keep them coherent. A kernel
+ * without range sync fails IMSYNC_SYNC_FOR_CPU with -ENOTTY; the backend
+ * then stops taking cached dma-bufs, see m_sw_can_run().
+ */
+static int m_sw_sync(CSwMpp *sw, exynos_mpp_img *img,
+                     struct GscSwImage *image, long flags)
+{
+    int i, ret;
+
+    if (!img->cacheable || !image->nr_maps)
+        return 0;
+
+    if (sw->ion_fd < 0) {
+        sw->ion_fd = ion_client_create();
+        if (sw->ion_fd < 0) {
+            ALOGE("%s::ion_client_create() fail", __func__);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < image->nr_maps; i++) {
+        ret = ion_msync(sw->ion_fd, image->fd[i], flags, image->len[i], 0);
+        if (ret < 0) {
+            ALOGE("%s::ion_msync(%d, 0x%lx) fail (%d)", __func__,
+                  image->fd[i], flags, ret);
+            if ((ret == -ENOTTY) && (flags & IMSYNC_SYNC_FOR_CPU))
+                sw->cpu_sync_ok = false;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Nearest source sample for every destination sample, by pixel centers */
+static void m_sw_scale_plane(unsigned char *dst, unsigned int dst_stride,
+                             unsigned int dst_w, unsigned int dst_h,
+                             unsigned char *src, unsigned int src_stride,
+                             unsigned int src_w, unsigned int src_h,
+                             unsigned int bpp)
+{
+    unsigned int *cols = new unsigned int[dst_w];
+    unsigned int i, j, sy, prev_sy = 0;
+    unsigned char *s, *d;
+
+    for (i = 0; i < dst_w; i++)
+        cols[i] = (2 * i + 1) * src_w / (2 * dst_w);
+
+    for (j = 0; j < dst_h; j++) {
+        sy = (2 * j + 1) * src_h / (2 * dst_h);
+        d = dst + j * dst_stride;
+
+        /* an upscaled line repeats the one above */
+        if ((j > 0) && (sy == prev_sy)) {
+            memcpy(d, d - dst_stride, dst_w * bpp);
+            continue;
+        }
+        prev_sy = sy;
+        s = src + sy * src_stride;
+
+        switch (bpp) {
+        case 1:
+            for (i = 0; i < dst_w; i++)
+                d[i] = s[cols[i]];
+            break;
+        case 2:
+            for (i = 0; i < dst_w; i++)
+                ((uint16_t *)d)[i] = ((uint16_t *)s)[cols[i]];
+            break;
+        case 4:
+            for (i = 0; i < dst_w; i++)
+                ((uint32_t *)d)[i] = ((uint32_t *)s)[cols[i]];
+            break;
+        default:
+            for (i = 0; i < dst_w; i++)
+                memcpy(d + i * bpp, s + cols[i] * bpp, bpp);
+            break;
+        }
+    }
+
+    delete[] cols;
+}
+
+static int m_sw_wait_fence(int *fence)
+{
+    int ret = 0;
+
+    if (*fence < 0)
+        return 0;
+
+    if (sync_wait(*fence, GSC_SW_FENCE_TIMEOUT_MS) < 0) {
+        ALOGE("%s::sync_wait(%d) fail", __func__, *fence);
+        ret = -1;
+    }
+    close(*fence);
+    *fence = -1;
+
+    return ret;
+}
+
+CSwMpp::~CSwMpp()
+{
+    if (ion_fd >= 0)
+        ion_client_destroy(ion_fd);
+}
+
+int CSwMpp::ConfigMpp(void *handle, exynos_mpp_img *src, exynos_mpp_img *dst)
+{
+    if (!m_sw_supports(src, dst)) {
+        ALOGE("%s::unsupported conversion (format 0x%x to 0x%x, rot %d)",
+              __func__, src->format, dst->format, dst->rot);
+        return -1;
+    }
+
+    memcpy(&src_img, src, sizeof(exynos_mpp_img));
+    memcpy(&dst_img, dst, sizeof(exynos_mpp_img));
+
+    return 0;
+}
+
+int CSwMpp::RunMpp(void *handle, exynos_mpp_img *src, exynos_mpp_img *dst)
+{
+    const struct GscSwFormat *fmt;
+    const struct GscSwPlane *plane;
+    struct GscSwImage s, d;
+    unsigned char *sp, *dp;
+    bool scaled;
+    unsigned int i;
+    int ret = 0;
+
+    if (!m_sw_supports(src, dst)) {
+        ALOGE("%s::unsupported conversion (format 0x%x to 0x%x, rot %d)",
+              __func__, src->format, dst->format, dst->rot);
+        return -1;
+    }
+
+    if (m_sw_wait_fence(&src->acquireFenceFd) < 0)
+        ret = -1;
+    if (m_sw_wait_fence(&dst->acquireFenceFd) < 0)
+        ret = -1;
+    src->releaseFenceFd = -1;
+    dst->releaseFenceFd = -1;
+    if (ret < 0)
+        return ret;
+
+    fmt = m_sw_find_format(src->format);
+    if (!m_sw_map(src, fmt, &s))
+        return -1;
+    if (!m_sw_map(dst, fmt, &d)) {
+        m_sw_unmap(&s);
+        return -1;
+    }
+
+    /*
+     * The fences are consumed already, a unit can still run the job. Tell
+     * the caller to use one instead of reading stale lines.
+     */
+    if ((m_sw_sync(this, src, &s, IMSYNC_DEV_TO_WRITE | IMSYNC_SYNC_FOR_CPU) < 0) ||
+            (m_sw_sync(this, dst, &d, IMSYNC_DEV_TO_WRITE | IMSYNC_SYNC_FOR_CPU) < 0)) {
+        m_sw_unmap(&d);
+        m_sw_unmap(&s);
+        return -EAGAIN;
+    }
+
+    scaled = (src->w != dst->w) || (src->h != dst->h);
+    for (i = 0; i < fmt->nr_planes; i++) {
+        plane = &fmt->planes[i];
+        sp = s.plane[i] + (src->y >> plane->v_shift) * s.stride[i] +
+             (src->x >> plane->h_shift) * plane->bpp;
+        dp = d.plane[i] + (dst->y >> plane->v_shift) * d.stride[i] +
+             (dst->x >> plane->h_shift) * plane->bpp;
+
+        if (scaled)
+            m_sw_scale_plane(dp, d.stride[i],
+                             dst->w >> plane->h_shift, dst->h >> plane->v_shift,
+                             sp, s.stride[i],
+                             src->w >> plane->h_shift, src->h >> plane->v_shift,
+                             plane->bpp);
+        else
+            csc_memcpy_2d(dp, d.stride[i], sp, s.stride[i],
+                          (dst->w >> plane->h_shift) * plane->bpp,
+                          dst->h >> plane->v_shift);
+    }
+
+    if (m_sw_sync(this, dst, &d, IMSYNC_DEV_TO_READ | IMSYNC_SYNC_FOR_DEV) < 0)
+        ret = -1;
+
+    m_sw_unmap(&d);
+    m_sw_unmap(&s);
+
+    return ret;
+}
+
+int CSwMpp::StopMpp(void *handle)
+{
+    /* nothing is left running after RunMpp() */
+    return 0;
+}
+
+void CSwMpp::DestroyMpp(void *handle)
+{
+    delete reinterpret_cast<CSwMpp *>(handle);
+}
+
+int CSwMpp::SetCSCProperty(void *handle, unsigned int eqAuto,
+                           unsigned int fullRange, unsigned int colorspace)
+{
+    /* the format is never converted, so there is no CSC to set */
+    return 0;
+}
+
+int CSwMpp::FreeMpp(void *handle)
+{
+    return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*!
+ * \file      libgscaler_tile.cpp
+ * \brief     tile geometry of the tiled and split M2M conversions
+ *
+ * Kept apart from the driver code so that gsc_tile_test can check it on
+ * its own.
+ */
+
+#include "libgscaler_obj.h"
+
+static unsigned int m_gsc_gcd(unsigned int a, unsigned int b)
+{
+    unsigned int t;
+
+    while (b) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+/*
+ * Splits one axis of a conversion into n parts no longer than max_len on
+ * both the source and the output side. bounds get the n + 1 boundaries,
+ * relative to the crop origins. Returns false if the parts do not fit.
+ *
+ * The scaler has no control of its initial phase, so a filter margin read
+ * past a tile edge could not be dropped from the output again. Instead the
+ * seams are only put where the source and output grids coincide on aligned
+ * pixels: every tile then has the ratio and phase of a single pass. A
+ * conversion whose grids do not meet often enough for n parts is refused;
+ * giving each part a ratio and phase of its own would change the whole
+ * output, not only the pixels next to the seams.
+ *
+ * The filter taps within a few pixels of a seam still read the tile edge
+ * instead of the neighbouring pixels, so those output pixels differ from a
+ * single pass unless the image is not scaled. gsc_tile_test checks that no
+ * other pixel does.
+ */
+bool m_gsc_split_axis(unsigned int src_len, unsigned int out_len,
+                      unsigned int n, unsigned int max_len,
+                      unsigned int *src_bounds, unsigned int *out_bounds)
+{
+    unsigned int g, step_out, step_src, m_src, m_out, m, ideal;
+    unsigned int k;
+
+    /* smallest step on which both grids meet on aligned pixels */
+    g = m_gsc_gcd(src_len, out_len);
+    m_out = GSC_TILE_ALIGN / m_gsc_gcd(GSC_TILE_ALIGN, out_len / g);
+    m_src = GSC_TILE_ALIGN / m_gsc_gcd(GSC_TILE_ALIGN, src_len / g);
+    m = m_out * m_src / m_gsc_gcd(m_out, m_src);
+    step_out = m * (out_len / g);
+    step_src = m * (src_len / g);
+    if ((step_out > max_len) || (step_src > max_len))
+        return false;
+
+    src_bounds[0] = out_bounds[0] = 0;
+    src_bounds[n] = src_len;
+    out_bounds[n] = out_len;
+
+    for (k = 1; k < n; k++) {
+        ideal = (unsigned long long)out_len * k / n;
+        out_bounds[k] = (ideal + step_out / 2) / step_out * step_out;
+        src_bounds[k] = out_bounds[k] / step_out * step_src;
+    }
+
+    for (k = 0; k < n; k++) {
+        if ((out_bounds[k + 1] <= out_bounds[k]) ||
+                (src_bounds[k + 1] <= src_bounds[k]) ||
+                (out_bounds[k + 1] - out_bounds[k] > max_len) ||
+                (src_bounds[k + 1] - src_bounds[k] > max_len))
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * Splits one axis of a conversion into at most GSC_MAX_TILES tiles no longer
+ * than max_len on both the source and the output side. bounds get the
+ * n + 1 tile boundaries, relative to the crop origins. Returns n, or -1,
+ * also if the grids do not meet often enough, see m_gsc_split_axis().
+ */
+int m_gsc_tile_axis(unsigned int src_len, unsigned int out_len,
+                    unsigned int max_len, unsigned int *src_bounds,
+                    unsigned int *out_bounds)
+{
+    unsigned int n;
+
+    if (src_len <= max_len && out_len <= max_len) {
+        src_bounds[0] = out_bounds[0] = 0;
+        src_bounds[1] = src_len;
+        out_bounds[1] = out_len;
+        return 1;
+    }
+
+    for (n = 2; n <= GSC_MAX_TILES; n++) {
+        if (m_gsc_split_axis(src_len, out_len, n, max_len,
+                             src_bounds, out_bounds))
+            return n;
+    }
+
+    return -1;
+}
+
+/*
+ * Fills job with the tile [sx0, sx1) x [sy0, sy1) of the source crop and
+ * [ox0, ox1) x [oy0, oy1) of the output, in source orientation. The output
+ * rect goes through the flips, then the 90 degree clockwise rotation, as in
+ * HAL.
+ */
+void m_gsc_make_tile(exynos_gsc_job *job, exynos_mpp_img *src_img,
+                     exynos_mpp_img *dst_img,
+                     unsigned int sx0, unsigned int sx1,
+                     unsigned int sy0, unsigned int sy1,
+                     unsigned int ox0, unsigned int ox1,
+                     unsigned int oy0, unsigned int oy1)
+{
+    bool rot90 = !!(dst_img->rot & HAL_TRANSFORM_ROT_90);
+    unsigned int out_w = rot90 ? dst_img->h : dst_img->w;
+    unsigned int out_h = rot90 ? dst_img->w : dst_img->h;
+    unsigned int t;
+
+    memcpy(&job->src, src_img, sizeof(*src_img));
+    memcpy(&job->dst, dst_img, sizeof(*dst_img));
+
+    job->src.x = src_img->x + sx0;
+    job->src.y = src_img->y + sy0;
+    job->src.w = sx1 - sx0;
+    job->src.h = sy1 - sy0;
+
+    if (dst_img->rot & HAL_TRANSFORM_FLIP_H) {
+        t = ox0;
+        ox0 = out_w - ox1;
+        ox1 = out_w - t;
+    }
+    if (dst_img->rot & HAL_TRANSFORM_FLIP_V) {
+        t = oy0;
+        oy0 = out_h - oy1;
+        oy1 = out_h - t;
+    }
+    if (rot90) {
+        job->dst.x = dst_img->x + out_h - oy1;
+        job->dst.y = dst_img->y + ox0;
+        job->dst.w = oy1 - oy0;
+        job->dst.h = ox1 - ox0;
+    } else {
+        job->dst.x = dst_img->x + ox0;
+        job->dst.y = dst_img->y + oy0;
+        job->dst.w = ox1 - ox0;
+        job->dst.h = oy1 - oy0;
+    }
+}
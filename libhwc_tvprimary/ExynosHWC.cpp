@@ -757,7 +757,7 @@ int runCompositor(exynos5_hwc_composer_device_1_t *pdev,
         if (srcAddress) {
             srcYAddress = srcAddress;
         } else {
-            srcYAddress = (long unsigned)ion_map(src_handle->fd, srcImageSize*srcG2d_bpp, 0);
+            srcYAddress = (long unsigned)ion_map_cached(src_handle->fd, srcImageSize*srcG2d_bpp, 0);
             src_ion_mapped = true;
         }
 
@@ -786,12 +786,12 @@ int runCompositor(exynos5_hwc_composer_device_1_t *pdev,
         } else {
 #ifdef USES_WFD
             if (dstImgRect.colorFormat == EXYNOS5_WFD_FORMAT) {
-                dstYAddress = (long unsigned)ion_map(dst_handle->fd, dstImageSize, 0);
-                dstCbCrAddress = (long unsigned)ion_map(dst_handle->fd1, dstImageSize / 2, 0);
+                dstYAddress = (long unsigned)ion_map_cached(dst_handle->fd, dstImageSize, 0);
+                dstCbCrAddress = (long unsigned)ion_map_cached(dst_handle->fd1, dstImageSize / 2, 0);
             } else
 #else
             {
-                dstYAddress = (long unsigned)ion_map(dst_handle->fd, dstImageSize*dstG2d_bpp, 0);
+                dstYAddress = (long unsigned)ion_map_cached(dst_handle->fd, dstImageSize*dstG2d_bpp, 0);
             }
 #endif
             dst_ion_mapped = true;
@@ -824,17 +824,17 @@ int runCompositor(exynos5_hwc_composer_device_1_t *pdev,
     ret = stretchFimgApi(&BlitParam);
 
     if (src_ion_mapped)
-        ion_unmap((void *)srcYAddress, srcImageSize*srcG2d_bpp);
+        ion_unmap_cached((void *)srcYAddress);
 
     if (dst_ion_mapped)
 #ifdef USES_WFD
         if (pdev->wfd_hpd) {
-            ion_unmap((void *)dstYAddress, dstImageSize);
-            ion_unmap((void *)dstCbCrAddress, dstImageSize / 2);
+            ion_unmap_cached((void *)dstYAddress);
+            ion_unmap_cached((void *)dstCbCrAddress);
         } else
 #else
         {
-            ion_unmap((void *)dstYAddress, dstImageSize*dstG2d_bpp);
+            ion_unmap_cached((void *)dstYAddress);
         }
 #endif
 
@@ -876,7 +876,7 @@ static buffer_handle_t *exynos5_external_layer_composite(exynos5_hwc_composer_de
             (pdev->composite_buf_height && (pdev->composite_buf_height != pdev->hdmi_h))) {
         for (size_t i = 0; i < NUM_COMPOSITE_BUFFER_FOR_EXTERNAL; i++) {
             ion_unmap((void *)pdev->va_composite_buffer_for_external[i],
-                    pdev->composite_buf_width * pdev->composite_buf_height * 4);
+                    pdev->composite_buf_stride * pdev->composite_buf_height * 4);
             pdev->va_composite_buffer_for_external[i] = NULL;
             pdev->alloc_device->free(pdev->alloc_device, pdev->composite_buffer_for_external[i]);
             pdev->composite_buffer_for_external[i] = NULL;
@@ -903,8 +903,9 @@ static buffer_handle_t *exynos5_external_layer_composite(exynos5_hwc_composer_de
             pdev->composite_buf_height = pdev->hdmi_h;
             buffer_handle_t dst_buf = pdev->composite_buffer_for_external[i];
             private_handle_t *dst_handle = private_handle_t::dynamicCast(dst_buf);
+            pdev->composite_buf_stride = dst_handle->stride;
             pdev->va_composite_buffer_for_external[i]
-                = (unsigned long)ion_map(dst_handle->fd, pdev->composite_buf_width * pdev->composite_buf_height * 4, 0);
+                = (unsigned long)ion_map(dst_handle->fd, pdev->composite_buf_stride * pdev->composite_buf_height * 4, 0);
             ALOGD("composite_buffer_for_external[%d] ion_mapped address: 0x%08x\n", i, pdev->va_composite_buffer_for_external[i]);
         }
     }
@@ -919,7 +920,12 @@ static buffer_handle_t *exynos5_external_layer_composite(exynos5_hwc_composer_de
     }
 
     /* clear composite buffer */
-    if (clear)
+    if (clear && pdev->va_composite_buffer_for_external[buf_index] &&
+            (pdev->composite_buf_stride * pdev->composite_buf_height * 4 <= HWC_CPU_FILL_MAX_SIZE))
+        csc_fill_rect_ARGB8888((unsigned char *)pdev->va_composite_buffer_for_external[buf_index],
+                dst_handle->stride * 4, 0, 0,
+                pdev->composite_buf_width, pdev->composite_buf_height, 0xff000000);
+    else if (clear)
         ret = runCompositor(pdev, layer, dst_handle, 0, 0xff, 0xff000000, BLIT_OP_SRC_OVER, true,
                 0, pdev->va_composite_buffer_for_external[buf_index]);
 
@@ -1078,7 +1084,7 @@ static void hdmi_disable(struct exynos5_hwc_composer_device_1_t *dev)
 #if defined(USE_G2D_SCALE_DOWN_FOR_LOW_RESOLUTION_HDMI)
     for (size_t i = 0; i < NUM_COMPOSITE_BUFFER_FOR_EXTERNAL; i++) {
         ion_unmap((void *)dev->va_composite_buffer_for_external[i],
-                dev->composite_buf_width * dev->composite_buf_height * 4);
+                dev->composite_buf_stride * dev->composite_buf_height * 4);
         dev->va_composite_buffer_for_external[i] = NULL;
         dev->alloc_device->free(dev->alloc_device, dev->composite_buffer_for_external[i]);
         dev->composite_buffer_for_external[i] = NULL;
@@ -2584,8 +2590,13 @@ static int exynos5_config_gsc_m2m(hwc_layer_1_t &layer,
                  /* Default color will be black */
                  char * uv_addr;
                  dst_handle = private_handle_t::dynamicCast(gsc_data->dst_buf[i]);
-                 uv_addr = (char *)ion_map(dst_handle->fd1, w * h / 2, 0);
-                 memset(uv_addr, 0x7f, w * h / 2);
+                 uv_addr = (char *)ion_map_ext(dst_handle->fd1, w * h / 2, 0,
+                         ION_MAP_WRITE | ION_MAP_PREFAULT);
+                 if (uv_addr != MAP_FAILED) {
+                     csc_fill_rect_YUV420SP(NULL, (unsigned char *)uv_addr, w, w,
+                             0, 0, w, h, 0, 0x7f, 0x7f);
+                     ion_unmap(uv_addr, w * h / 2);
+                 }
              }
 #endif
 
@@ -3874,6 +3885,12 @@ static void exynos5_dump(hwc_composer_device_1* dev, char *buff, int buff_len)
             result.appendFormat(" | %10s","DISABLED");
         result.append("\n");
     }
+
+    char ion_stats[1024];
+    ion_stats_dump(ion_stats, sizeof(ion_stats));
+    result.append(ion_stats);
+    if (ion_track_dump(ion_stats, sizeof(ion_stats), 0))
+        result.append(ion_stats);
     strlcpy(buff, result.string(), buff_len);
 }
 
@@ -4225,6 +4242,7 @@ static int exynos5_open(const struct hw_module_t *module, const char *name,
     }
     dev->composite_buf_width  = 0;
     dev->composite_buf_height = 0;
+    dev->composite_buf_stride = 0;
     dev->already_mapped_vfb = false;
 
 #ifdef USES_U4A
@@ -4339,7 +4357,7 @@ static int exynos5_close(hw_device_t *device)
 #if defined(USE_G2D_SCALE_DOWN_FOR_LOW_RESOLUTION_HDMI)
     for (size_t i = 0; i < NUM_COMPOSITE_BUFFER_FOR_EXTERNAL; i++) {
         ion_unmap((void *)dev->va_composite_buffer_for_external[i],
-                dev->composite_buf_width * dev->composite_buf_height * 4);
+                dev->composite_buf_stride * dev->composite_buf_height * 4);
         dev->va_composite_buffer_for_external[i] = NULL;
         dev->alloc_device->free(dev->alloc_device, dev->composite_buffer_for_external[i]);
         dev->composite_buffer_for_external[i] = NULL;
@@ -52,6 +52,7 @@
 #include "exynos_v4l2.h"
 #include "s5p_tvout_v4l2.h"
 #include "ExynosRect.h"
+#include "swconverter.h"
 #include <linux/videodev2.h>
 #ifdef USE_FB_PHY_LINEAR
 const size_t NUM_HW_WIN_FB_PHY = 2;
@@ -103,6 +104,8 @@ const size_t NUM_GSC_UNITS = sizeof(AVAILABLE_GSC_UNITS) /
         sizeof(AVAILABLE_GSC_UNITS[0]);
 const size_t BURSTLEN_BYTES = 16 * 8;
 const size_t NUM_HDMI_BUFFERS = 3;
+/* Solid fills up to this size are done by the CPU instead of a G2D job */
+const size_t HWC_CPU_FILL_MAX_SIZE = 1280 * 720 * 4;
 #define DIRECT_FB_SRC_BUF_WA
 
 #ifdef SKIP_STATIC_LAYER_COMP
@@ -377,6 +380,7 @@ struct exynos5_hwc_composer_device_1_t {
     size_t                  composite_buf_index;
     int                     composite_buf_width;
     int                     composite_buf_height;
+    int                     composite_buf_stride;   /* in pixels, from gralloc */
     struct sec_rect         saved_layer_for_external[4];
     int                     saved_layer_count;
     bool                    is_change_external_surface;
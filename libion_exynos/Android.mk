@@ -21,12 +21,52 @@ include $(CLEAR_VARS)
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/../include
 
 LOCAL_SRC_FILES:= \
-	libion.cpp
+	libion.cpp \
+	ion_pool.cpp \
+	ion_map_cache.cpp \
+	ion_prealloc.cpp \
+	ion_stats.cpp \
+	ion_emul.cpp \
+	ion_chain.cpp \
+	ion_image.cpp \
+	ion_track.cpp
 
 LOCAL_CFLAGS += -DGAIA_FW_BETA
 
+LOCAL_SHARED_LIBRARIES := liblog
+
 LOCAL_MODULE := libion_exynos
 
 LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../include
+
+LOCAL_SRC_FILES:= \
+	ion_bench.cpp
+
+LOCAL_SHARED_LIBRARIES := libion_exynos
+
+LOCAL_MODULE := ion_bench
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../include
+
+LOCAL_SRC_FILES:= \
+	ion_test.cpp
+
+LOCAL_SHARED_LIBRARIES := libion_exynos
+
+LOCAL_MODULE := ion_test
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
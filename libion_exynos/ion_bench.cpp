@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * ion_bench - measures alloc/free and map/unmap cost of libion_exynos
+ *
+ * usage: ion_bench [-b kernel|memfd] [-n iterations] [-h heap_mask] [-c]
+ *
+ * Every test is run for typical frame buffer sizes, through the raw calls
+ * and through the pool and map cache. -c allocates ION_FLAG_CACHED buffers.
+ */
+
+#include <ion.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+struct bench_size {
+    const char *name;
+    size_t len;
+};
+
+static const struct bench_size bench_sizes[] = {
+    { "720p RGBA",      1280 * 720 * 4 },
+    { "1080p NV12",     1920 * 1088 * 3 / 2 },
+    { "1080p RGBA",     1920 * 1080 * 4 },
+    { "2160p NV12",     3840 * 2160 * 3 / 2 },
+};
+
+struct bench_result {
+    long long total;
+    long long max;
+    unsigned int count;
+    unsigned int fails;
+};
+
+static long long bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void bench_account(struct bench_result *r, long long ns, bool ok)
+{
+    if (!ok) {
+        r->fails++;
+        return;
+    }
+    r->total += ns;
+    if (ns > r->max)
+        r->max = ns;
+    r->count++;
+}
+
+static void bench_print(const char *test, const char *size,
+                        const struct bench_result *r)
+{
+    if (!r->count) {
+        printf("  %-18s %-12s all %u iterations failed\n", test, size, r->fails);
+        return;
+    }
+
+    printf("  %-18s %-12s avg %8.1f us  max %8.1f us  %9.0f ops/s  fails %u\n",
+           test, size, r->total / 1000.0 / r->count, r->max / 1000.0,
+           r->count * 1000000000.0 / r->total, r->fails);
+}
+
+static void bench_alloc(ion_client client, const struct bench_size *size,
+                        unsigned int heap_mask, unsigned int flags,
+                        unsigned int iterations, bool pooled)
+{
+    struct bench_result r;
+    ion_buffer buffer;
+    long long start;
+    unsigned int i;
+
+    memset(&r, 0, sizeof(r));
+    for (i = 0; i < iterations; i++) {
+        start = bench_now();
+        if (pooled)
+            buffer = ion_pool_alloc(client, size->len, 0, heap_mask, flags);
+        else
+            buffer = ion_alloc(client, size->len, 0, heap_mask, flags);
+        if (buffer >= 0) {
+            if (pooled)
+                ion_pool_free(buffer);
+            else
+                ion_free(buffer);
+        }
+        bench_account(&r, bench_now() - start, buffer >= 0);
+    }
+
+    bench_print(pooled ? "pool alloc+free" : "alloc+free", size->name, &r);
+}
+
+static void bench_map(ion_client client, const struct bench_size *size,
+                      unsigned int heap_mask, unsigned int flags,
+                      unsigned int iterations, bool cached)
+{
+    struct bench_result r;
+    ion_buffer buffer;
+    long long start;
+    unsigned int i;
+    void *addr;
+
+    buffer = ion_alloc(client, size->len, 0, heap_mask, flags);
+    if (buffer < 0) {
+        printf("  %-18s %-12s allocation failed\n",
+               cached ? "cached map+unmap" : "map+unmap", size->name);
+        return;
+    }
+
+    memset(&r, 0, sizeof(r));
+    for (i = 0; i < iterations; i++) {
+        start = bench_now();
+        if (cached)
+            addr = ion_map_cached(buffer, size->len, 0);
+        else
+            addr = ion_map(buffer, size->len, 0);
+        if (addr != MAP_FAILED) {
+            /* touch one byte per page, like a CPU writer would */
+            for (size_t off = 0; off < size->len; off += 4096)
+                ((volatile char *)addr)[off] = 0;
+            if (cached)
+                ion_unmap_cached(addr);
+            else
+                ion_unmap(addr, size->len);
+        }
+        bench_account(&r, bench_now() - start, addr != MAP_FAILED);
+    }
+
+    bench_print(cached ? "cached map+unmap" : "map+unmap", size->name, &r);
+
+    ion_map_cache_flush();
+    ion_free(buffer);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int iterations = 100;
+    unsigned int heap_mask = ION_HEAP_SYSTEM_MASK;
+    unsigned int flags = 0;
+    ion_client client;
+    unsigned int i;
+    char stats[4096];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:n:h:c")) != -1) {
+        switch (opt) {
+        case 'b':
+            if (ion_select_backend(optarg) < 0) {
+                fprintf(stderr, "unknown backend %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'n':
+            iterations = strtoul(optarg, NULL, 0);
+            break;
+        case 'h':
+            heap_mask = strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            flags |= ION_FLAG_CACHED;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-b kernel|memfd] [-n iterations] "
+                    "[-h heap_mask] [-c]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    client = ion_client_create();
+    if (client < 0) {
+        fprintf(stderr, "failed to create an ion client\n");
+        return 1;
+    }
+
+    printf("heap 0x%x, flags 0x%x, %u iterations\n", heap_mask, flags, iterations);
+    for (i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++) {
+        bench_alloc(client, &bench_sizes[i], heap_mask, flags, iterations, false);
+        bench_alloc(client, &bench_sizes[i], heap_mask, flags, iterations, true);
+        bench_map(client, &bench_sizes[i], heap_mask, flags, iterations, false);
+        bench_map(client, &bench_sizes[i], heap_mask, flags, iterations, true);
+    }
+
+    ion_pool_trim(0, 0);
+    ion_stats_dump(stats, sizeof(stats));
+    printf("%s", stats);
+
+    ion_client_destroy(client);
+
+    return 0;
+}
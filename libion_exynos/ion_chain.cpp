@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <cutils/log.h>
+#include "ion_priv.h"
+
+/* A step that failed this many times in a row is skipped for a while */
+#define ION_CHAIN_BACKOFF_FAILURES  2
+#define ION_CHAIN_BACKOFF_NS        (500 * 1000000LL)
+
+struct ion_chain_step {
+    unsigned int heap_mask;
+    unsigned int consecutive_fails;
+    long long backoff_until;
+};
+
+struct ion_chain {
+    char name[16];
+    unsigned int nr_steps;
+    struct ion_chain_step steps[ION_CHAIN_MAX_STEPS];
+    struct ion_chain_stats stats;
+};
+
+static pthread_mutex_t chain_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ion_chain chains[ION_CHAIN_MAX_CHAINS];
+static unsigned int nr_chains;
+
+int ion_chain_register(const char *name, const unsigned int *heap_masks,
+                       unsigned int nr_steps)
+{
+    struct ion_chain *chain;
+    unsigned int i;
+    int id;
+
+    if (!heap_masks || (nr_steps == 0) || (nr_steps > ION_CHAIN_MAX_STEPS))
+        return -EINVAL;
+
+    pthread_mutex_lock(&chain_lock);
+    if (nr_chains == ION_CHAIN_MAX_CHAINS) {
+        pthread_mutex_unlock(&chain_lock);
+        return -ENOSPC;
+    }
+
+    id = nr_chains;
+    chain = &chains[id];
+    memset(chain, 0, sizeof(*chain));
+    strncpy(chain->name, name ? name : "", sizeof(chain->name) - 1);
+    chain->nr_steps = nr_steps;
+    for (i = 0; i < nr_steps; i++)
+        chain->steps[i].heap_mask = heap_masks[i];
+    nr_chains++;
+    pthread_mutex_unlock(&chain_lock);
+
+    return id;
+}
+
+/*
+ * Tries one step. When it fails and the pool holds buffers of that heap,
+ * they are returned to the kernel and the step is retried once, since a
+ * fragmented contiguous heap often only needs the cached buffers back.
+ */
+static ion_buffer ion_chain_try(ion_client client, size_t len, size_t align,
+                                unsigned int heap_mask, unsigned int flags)
+{
+    ion_buffer buffer = ion_alloc(client, len, align, heap_mask, flags);
+
+    if ((buffer < 0) && ion_pool_cached_size(heap_mask)) {
+        ion_pool_trim(heap_mask, 0);
+        buffer = ion_alloc(client, len, align, heap_mask, flags);
+    }
+
+    return buffer;
+}
+
+ion_buffer ion_alloc_chain(ion_client client, int id, size_t len, size_t align,
+                           unsigned int flags, unsigned int *heap_used)
+{
+    struct ion_chain *chain;
+    struct ion_chain_step *step;
+    ion_buffer buffer = -ENODEV;
+    unsigned int i, last;
+    long long now;
+    bool skip;
+
+    if ((id < 0) || ((unsigned int)id >= nr_chains))
+        return -EINVAL;
+
+    chain = &chains[id];
+    last = chain->nr_steps - 1;
+
+    for (i = 0; i <= last; i++) {
+        step = &chain->steps[i];
+
+        /* the last step is always tried, there is nothing left after it */
+        now = ion_stats_now();
+        pthread_mutex_lock(&chain_lock);
+        skip = (i != last) && (step->backoff_until > now);
+        if (skip)
+            chain->stats.skipped[i]++;
+        pthread_mutex_unlock(&chain_lock);
+        if (skip)
+            continue;
+
+        buffer = ion_chain_try(client, len, align, step->heap_mask, flags);
+
+        pthread_mutex_lock(&chain_lock);
+        chain->stats.attempts[i]++;
+        if (buffer >= 0) {
+            chain->stats.served[i]++;
+            if (i != 0)
+                chain->stats.fallbacks++;
+            step->consecutive_fails = 0;
+            step->backoff_until = 0;
+        } else if (++step->consecutive_fails >= ION_CHAIN_BACKOFF_FAILURES) {
+            step->backoff_until = ion_stats_now() + ION_CHAIN_BACKOFF_NS;
+        }
+        pthread_mutex_unlock(&chain_lock);
+
+        if (buffer >= 0) {
+            if (i != 0)
+                ALOGV("%s: chain %s: %zu bytes from heap 0x%x instead of 0x%x",
+                      __func__, chain->name, len, step->heap_mask,
+                      chain->steps[0].heap_mask);
+            if (heap_used)
+                *heap_used = step->heap_mask;
+            return buffer;
+        }
+    }
+
+    pthread_mutex_lock(&chain_lock);
+    chain->stats.failures++;
+    pthread_mutex_unlock(&chain_lock);
+
+    ALOGE("%s: chain %s: no heap could serve %zu bytes", __func__, chain->name, len);
+
+    return buffer;
+}
+
+int ion_chain_get_stats(int id, struct ion_chain_stats *stats)
+{
+    if ((id < 0) || ((unsigned int)id >= nr_chains) || !stats)
+        return -EINVAL;
+
+    pthread_mutex_lock(&chain_lock);
+    memcpy(stats, &chains[id].stats, sizeof(*stats));
+    pthread_mutex_unlock(&chain_lock);
+
+    return 0;
+}
@@ -0,0 +1,435 @@
+/*
+ * Copyright (C) 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Userspace emulation of the legacy ION ioctl interface on top of memfd.
+ *
+ * Every client is an eventfd that only serves as an identity, every buffer
+ * is a memfd. Handles are per-client indices into a table of buffers, like
+ * the kernel's idr. SHARE hands out a dup of the memfd, so the resulting
+ * fds can be mmap()ed, passed around and closed exactly like dma-bufs.
+ * Memory is coherent, so SYNC and MSYNC only validate their arguments.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "ion_priv.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+#define ION_EMUL_MAX_CLIENTS    16
+#define ION_EMUL_PAGE_SIZE      4096
+#define ION_EMUL_PRIVATE_FD_MIN 64
+
+struct ion_emul_heap {
+    unsigned int mask;
+    const char *name;
+};
+
+/* Heaps are tried in this order when a mask names several of them */
+static const struct ion_emul_heap emul_heaps[] = {
+    { ION_HEAP_SYSTEM_MASK,         "system" },
+    { ION_HEAP_SYSTEM_CONTIG_MASK,  "system_contig" },
+    { ION_HEAP_EXYNOS_CONTIG_MASK,  "exynos_contig" },
+    { ION_HEAP_EXYNOS_MASK,         "exynos" },
+    { ION_EXYNOS_VIDEO_MASK,        "video" },
+    { ION_EXYNOS_FIMD_VIDEO_MASK,   "fimd_video" },
+    { ION_EXYNOS_GSC_MASK,          "gsc" },
+    { ION_EXYNOS_MFC_OUTPUT_MASK,   "mfc_output" },
+    { ION_EXYNOS_MFC_INPUT_MASK,    "mfc_input" },
+};
+
+struct ion_emul_buffer {
+    int fd;             /* memfd, -1 if the slot is free */
+    unsigned int refs;
+    unsigned int heap_mask;
+    unsigned int flags;
+    size_t len;
+    dev_t dev;
+    ino_t ino;
+};
+
+struct ion_emul_client {
+    int fd;             /* -1 if the slot is free */
+    struct ion_emul_buffer *buffers;
+    unsigned int nr_buffers;
+};
+
+static pthread_mutex_t emul_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ion_emul_client emul_clients[ION_EMUL_MAX_CLIENTS] = {
+    { -1, NULL, 0 }, { -1, NULL, 0 }, { -1, NULL, 0 }, { -1, NULL, 0 },
+    { -1, NULL, 0 }, { -1, NULL, 0 }, { -1, NULL, 0 }, { -1, NULL, 0 },
+    { -1, NULL, 0 }, { -1, NULL, 0 }, { -1, NULL, 0 }, { -1, NULL, 0 },
+    { -1, NULL, 0 }, { -1, NULL, 0 }, { -1, NULL, 0 }, { -1, NULL, 0 },
+};
+
+/*
+ * The memfd stands in for a buffer held by the kernel, which takes no fd of
+ * the process. It is kept away from the low fds so that the fds handed to
+ * the caller are numbered as the kernel would number them.
+ */
+static int ion_emul_memfd(const char *name)
+{
+#ifdef __NR_memfd_create
+    int fd, high_fd;
+
+    fd = syscall(__NR_memfd_create, name, MFD_CLOEXEC);
+    if ((fd < 0) || (fd >= ION_EMUL_PRIVATE_FD_MIN))
+        return fd;
+
+    high_fd = fcntl(fd, F_DUPFD_CLOEXEC, ION_EMUL_PRIVATE_FD_MIN);
+    if (high_fd < 0)
+        return fd;
+    close(fd);
+
+    return high_fd;
+#else
+    (void)name;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/* Must be called with emul_lock held */
+static struct ion_emul_client *ion_emul_find_client(int client)
+{
+    int i;
+
+    for (i = 0; i < ION_EMUL_MAX_CLIENTS; i++) {
+        if ((emul_clients[i].fd >= 0) && (emul_clients[i].fd == client))
+            return &emul_clients[i];
+    }
+
+    return NULL;
+}
+
+/* Must be called with emul_lock held */
+static struct ion_emul_buffer *ion_emul_find_handle(struct ion_emul_client *c,
+                                                    unsigned long handle)
+{
+    if ((handle == 0) || (handle > c->nr_buffers) ||
+            (c->buffers[handle - 1].fd < 0))
+        return NULL;
+
+    return &c->buffers[handle - 1];
+}
+
+/* Must be called with emul_lock held. Returns the handle of a free slot */
+static unsigned long ion_emul_new_handle(struct ion_emul_client *c)
+{
+    struct ion_emul_buffer *buffers;
+    unsigned int i, nr;
+
+    for (i = 0; i < c->nr_buffers; i++) {
+        if (c->buffers[i].fd < 0)
+            return i + 1;
+    }
+
+    nr = c->nr_buffers ? c->nr_buffers * 2 : 16;
+    buffers = (struct ion_emul_buffer *)realloc(c->buffers, nr * sizeof(*buffers));
+    if (!buffers)
+        return 0;
+
+    for (i = c->nr_buffers; i < nr; i++)
+        buffers[i].fd = -1;
+
+    i = c->nr_buffers;
+    c->buffers = buffers;
+    c->nr_buffers = nr;
+
+    return i + 1;
+}
+
+static int ion_emul_alloc(struct ion_emul_client *c,
+                          struct ion_allocation_data *data)
+{
+    const struct ion_emul_heap *heap = NULL;
+    struct ion_emul_buffer *buf;
+    struct stat st;
+    unsigned long handle;
+    char name[32];
+    size_t len;
+    unsigned int i;
+    int fd;
+
+    for (i = 0; i < sizeof(emul_heaps) / sizeof(emul_heaps[0]); i++) {
+        if (data->heap_mask & emul_heaps[i].mask) {
+            heap = &emul_heaps[i];
+            break;
+        }
+    }
+
+    if (!heap)
+        return -ENODEV;
+
+    if ((data->len == 0) || (data->align & (data->align - 1)))
+        return -EINVAL;
+
+    len = (data->len + ION_EMUL_PAGE_SIZE - 1) & ~(ION_EMUL_PAGE_SIZE - 1);
+
+    snprintf(name, sizeof(name), "ion-%s", heap->name);
+    fd = ion_emul_memfd(name);
+    if (fd < 0)
+        return -errno;
+
+    if ((ftruncate(fd, len) < 0) || (fstat(fd, &st) < 0)) {
+        int err = errno;
+        close(fd);
+        return -err;
+    }
+
+    handle = ion_emul_new_handle(c);
+    if (!handle) {
+        close(fd);
+        return -ENOMEM;
+    }
+
+    buf = &c->buffers[handle - 1];
+    buf->fd = fd;
+    buf->refs = 1;
+    buf->heap_mask = heap->mask;
+    buf->flags = data->flags;
+    buf->len = len;
+    buf->dev = st.st_dev;
+    buf->ino = st.st_ino;
+
+    data->handle = handle;
+
+    return 0;
+}
+
+static int ion_emul_free(struct ion_emul_client *c, struct ion_handle_data *data)
+{
+    struct ion_emul_buffer *buf = ion_emul_find_handle(c, data->handle);
+
+    if (!buf)
+        return -EINVAL;
+
+    if (--buf->refs == 0) {
+        close(buf->fd);
+        buf->fd = -1;
+    }
+
+    return 0;
+}
+
+static int ion_emul_share(struct ion_emul_client *c, struct ion_fd_data *data)
+{
+    struct ion_emul_buffer *buf = ion_emul_find_handle(c, data->handle);
+
+    if (!buf)
+        return -EINVAL;
+
+    data->fd = fcntl(buf->fd, F_DUPFD_CLOEXEC, 0);
+    if (data->fd < 0)
+        return -errno;
+
+    return 0;
+}
+
+/* Importing a buffer the client already holds returns the same handle */
+static int ion_emul_import(struct ion_emul_client *c, struct ion_fd_data *data)
+{
+    struct ion_emul_buffer *buf;
+    struct stat st;
+    unsigned long handle;
+    unsigned int i;
+    int fd;
+
+    if (fstat(data->fd, &st) < 0)
+        return -EINVAL;
+
+    for (i = 0; i < c->nr_buffers; i++) {
+        buf = &c->buffers[i];
+        if ((buf->fd >= 0) && (buf->dev == st.st_dev) && (buf->ino == st.st_ino)) {
+            buf->refs++;
+            data->handle = i + 1;
+            return 0;
+        }
+    }
+
+    fd = fcntl(data->fd, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0)
+        return -errno;
+
+    handle = ion_emul_new_handle(c);
+    if (!handle) {
+        close(fd);
+        return -ENOMEM;
+    }
+
+    /* a buffer from outside the emulation: treat it as system heap memory */
+    buf = &c->buffers[handle - 1];
+    buf->fd = fd;
+    buf->refs = 1;
+    buf->heap_mask = ION_HEAP_SYSTEM_MASK;
+    buf->flags = 0;
+    buf->len = st.st_size;
+    buf->dev = st.st_dev;
+    buf->ino = st.st_ino;
+
+    data->handle = handle;
+
+    return 0;
+}
+
+static int ion_emul_sync(struct ion_fd_data *data)
+{
+    struct stat st;
+
+    if (fstat(data->fd, &st) < 0)
+        return -EINVAL;
+
+    return 0;
+}
+
+static int ion_emul_custom(struct ion_custom_data *data)
+{
+    struct ion_msync_data *msync;
+    struct stat st;
+
+    if (data->cmd != ION_EXYNOS_CUSTOM_MSYNC)
+        return -ENOTTY;
+
+    msync = (struct ion_msync_data *)data->arg;
+    if (!(msync->flags & (IMSYNC_SYNC_FOR_DEV | IMSYNC_SYNC_FOR_CPU)))
+        return -EINVAL;
+
+    if (fstat(msync->buf, &st) < 0)
+        return -EINVAL;
+
+    if ((msync->offset < 0) || ((off_t)(msync->offset + msync->size) > st.st_size))
+        return -EINVAL;
+
+    return 0;
+}
+
+static int ion_emul_open(void)
+{
+    struct ion_emul_client *c = NULL;
+    int i, fd;
+
+    fd = eventfd(0, EFD_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    pthread_mutex_lock(&emul_lock);
+    for (i = 0; i < ION_EMUL_MAX_CLIENTS; i++) {
+        if (emul_clients[i].fd < 0) {
+            c = &emul_clients[i];
+            break;
+        }
+    }
+
+    if (!c) {
+        pthread_mutex_unlock(&emul_lock);
+        close(fd);
+        errno = EMFILE;
+        return -1;
+    }
+
+    c->fd = fd;
+    c->buffers = NULL;
+    c->nr_buffers = 0;
+    pthread_mutex_unlock(&emul_lock);
+
+    return fd;
+}
+
+static void ion_emul_close(int client)
+{
+    struct ion_emul_client *c;
+    unsigned int i;
+
+    pthread_mutex_lock(&emul_lock);
+    c = ion_emul_find_client(client);
+    if (c) {
+        for (i = 0; i < c->nr_buffers; i++) {
+            if (c->buffers[i].fd >= 0)
+                close(c->buffers[i].fd);
+        }
+        free(c->buffers);
+        c->buffers = NULL;
+        c->nr_buffers = 0;
+        c->fd = -1;
+    }
+    pthread_mutex_unlock(&emul_lock);
+
+    close(client);
+}
+
+static int ion_emul_ioctl(int client, unsigned long request, void *arg)
+{
+    struct ion_emul_client *c;
+    int ret;
+
+    pthread_mutex_lock(&emul_lock);
+    c = ion_emul_find_client(client);
+    if (!c) {
+        pthread_mutex_unlock(&emul_lock);
+        errno = EBADF;
+        return -1;
+    }
+
+    switch (request) {
+    case ION_IOC_ALLOC:
+        ret = ion_emul_alloc(c, (struct ion_allocation_data *)arg);
+        break;
+    case ION_IOC_FREE:
+        ret = ion_emul_free(c, (struct ion_handle_data *)arg);
+        break;
+    case ION_IOC_SHARE:
+    case ION_IOC_MAP:
+        ret = ion_emul_share(c, (struct ion_fd_data *)arg);
+        break;
+    case ION_IOC_IMPORT:
+        ret = ion_emul_import(c, (struct ion_fd_data *)arg);
+        break;
+    case ION_IOC_SYNC:
+        ret = ion_emul_sync((struct ion_fd_data *)arg);
+        break;
+    case ION_IOC_CUSTOM:
+        ret = ion_emul_custom((struct ion_custom_data *)arg);
+        break;
+    default:
+        ret = -ENOTTY;
+        break;
+    }
+    pthread_mutex_unlock(&emul_lock);
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}
+
+const struct ion_backend ion_memfd_backend = {
+    "memfd",
+    ion_emul_open,
+    ion_emul_close,
+    ion_emul_ioctl,
+};
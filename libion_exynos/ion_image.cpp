@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "ion_priv.h"
+
+#define ION_IMAGE_ALIGN(x, a)   (((x) + (a) - 1) / (a) * (a))
+
+/*
+ * Per plane: bytes per pixel of the first plane's width, and the horizontal
+ * and vertical subsampling shifts relative to the first plane.
+ */
+struct ion_image_plane_desc {
+    unsigned int bpp;
+    unsigned int h_shift;
+    unsigned int v_shift;
+};
+
+struct ion_image_format_desc {
+    unsigned int nr_planes;
+    struct ion_image_plane_desc planes[ION_IMAGE_MAX_PLANES];
+};
+
+static const struct ion_image_format_desc image_formats[] = {
+    /* ION_IMAGE_YUV420SP: Y, interleaved CbCr */
+    { 2, { { 1, 0, 0 }, { 2, 1, 1 } } },
+    /* ION_IMAGE_YUV420P: Y, Cb, Cr */
+    { 3, { { 1, 0, 0 }, { 1, 1, 1 }, { 1, 1, 1 } } },
+    /* ION_IMAGE_YUV422SP: Y, interleaved CbCr at full height */
+    { 2, { { 1, 0, 0 }, { 2, 1, 0 } } },
+    /* ION_IMAGE_RGB32 */
+    { 1, { { 4, 0, 0 } } },
+};
+
+int ion_image_layout(unsigned int format, unsigned int width,
+                     unsigned int height, size_t stride_align,
+                     size_t plane_align, struct ion_image *image)
+{
+    const struct ion_image_format_desc *desc;
+    struct ion_image_plane *plane;
+    size_t offset = 0;
+    unsigned int i, w, h;
+
+    if ((format >= sizeof(image_formats) / sizeof(image_formats[0])) ||
+            !width || !height || !image)
+        return -EINVAL;
+
+    if (!stride_align)
+        stride_align = 1;
+    if (!plane_align)
+        plane_align = ION_IMAGE_DEFAULT_PLANE_ALIGN;
+
+    desc = &image_formats[format];
+
+    memset(image, 0, sizeof(*image));
+    image->buffer = -1;
+    image->addr = MAP_FAILED;
+    image->format = format;
+    image->width = width;
+    image->height = height;
+    image->nr_planes = desc->nr_planes;
+
+    for (i = 0; i < desc->nr_planes; i++) {
+        plane = &image->planes[i];
+        w = (width + (1 << desc->planes[i].h_shift) - 1) >> desc->planes[i].h_shift;
+        h = (height + (1 << desc->planes[i].v_shift) - 1) >> desc->planes[i].v_shift;
+
+        offset = ION_IMAGE_ALIGN(offset, plane_align);
+        plane->offset = offset;
+        plane->stride = ION_IMAGE_ALIGN(w * desc->planes[i].bpp, stride_align);
+        plane->height = h;
+        plane->size = plane->stride * h;
+        offset += plane->size;
+    }
+
+    image->len = ION_IMAGE_ALIGN(offset, ION_MAP_PAGE_SIZE);
+
+    return 0;
+}
+
+int ion_image_alloc(ion_client client, unsigned int format, unsigned int width,
+                    unsigned int height, size_t stride_align, size_t plane_align,
+                    unsigned int heap_mask, unsigned int flags,
+                    struct ion_image *image)
+{
+    int ret;
+
+    ret = ion_image_layout(format, width, height, stride_align, plane_align,
+                           image);
+    if (ret < 0)
+        return ret;
+
+    image->buffer = ion_alloc(client, image->len, 0, heap_mask, flags);
+    if (image->buffer < 0) {
+        ret = image->buffer;
+        image->buffer = -1;
+        return ret;
+    }
+
+    return 0;
+}
+
+void *ion_image_map(struct ion_image *image, unsigned int map_flags)
+{
+    if (image->addr != MAP_FAILED)
+        return image->addr;
+
+    image->addr = ion_map_ext(image->buffer, image->len, 0, map_flags);
+
+    return image->addr;
+}
+
+void *ion_image_plane_addr(const struct ion_image *image, unsigned int plane)
+{
+    if ((image->addr == MAP_FAILED) || (plane >= image->nr_planes))
+        return NULL;
+
+    return (char *)image->addr + image->planes[plane].offset;
+}
+
+int ion_image_plane_fd(const struct ion_image *image, unsigned int plane,
+                       int *fd, size_t *offset)
+{
+    if ((image->buffer < 0) || (plane >= image->nr_planes))
+        return -EINVAL;
+
+    *fd = image->buffer;
+    *offset = image->planes[plane].offset;
+
+    return 0;
+}
+
+void ion_image_free(struct ion_image *image)
+{
+    if (image->addr != MAP_FAILED) {
+        ion_unmap(image->addr, image->len);
+        image->addr = MAP_FAILED;
+    }
+
+    if (image->buffer >= 0) {
+        ion_free(image->buffer);
+        image->buffer = -1;
+    }
+}
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ion.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ion_priv.h"
+
+/*
+ * A mapping owned by the cache. The mapping itself holds a reference to the
+ * dma-buf, so the identity (dev, ino) cannot be recycled while it is cached.
+ * Entries with refs == 0 are idle and may be evicted, least recently used
+ * first. The list is kept in most recently used order.
+ */
+struct ion_map_entry {
+    struct ion_map_entry *prev;
+    struct ion_map_entry *next;
+    dev_t dev;
+    ino_t ino;
+    off_t offset;
+    size_t len;
+    void *addr;
+    int refs;
+    bool shared;    /* identity is not unique, never reused */
+};
+
+static pthread_mutex_t map_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ion_map_entry *map_head;
+static struct ion_map_entry *map_tail;
+static size_t map_budget = ION_MAP_CACHE_DEFAULT_BUDGET;
+static size_t map_total;
+
+/*
+ * Older kernels export every dma-buf on the single anon inode, in which case
+ * inode numbers say nothing about buffer identity. Look up the anon inode
+ * once so that such buffers bypass the cache.
+ */
+static bool anon_checked;
+static dev_t anon_dev;
+static ino_t anon_ino;
+
+/* Must be called with map_lock held */
+static void ion_map_cache_check_anon(void)
+{
+    struct stat st;
+    int fd;
+
+    if (anon_checked)
+        return;
+
+    anon_checked = true;
+    fd = eventfd(0, 0);
+    if (fd < 0)
+        return;
+    if (fstat(fd, &st) == 0) {
+        anon_dev = st.st_dev;
+        anon_ino = st.st_ino;
+    }
+    close(fd);
+}
+
+/* Must be called with map_lock held */
+static void ion_map_cache_unlink(struct ion_map_entry *entry)
+{
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        map_head = entry->next;
+
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        map_tail = entry->prev;
+
+    entry->prev = entry->next = NULL;
+}
+
+/* Must be called with map_lock held */
+static void ion_map_cache_push_front(struct ion_map_entry *entry)
+{
+    entry->prev = NULL;
+    entry->next = map_head;
+    if (map_head)
+        map_head->prev = entry;
+    else
+        map_tail = entry;
+    map_head = entry;
+}
+
+/* Must be called with map_lock held */
+static void ion_map_cache_release(struct ion_map_entry *entry)
+{
+    ion_map_cache_unlink(entry);
+    map_total -= entry->len;
+    ion_unmap(entry->addr, entry->len);
+    free(entry);
+}
+
+/* Must be called with map_lock held. Unmaps idle entries, LRU first */
+static void ion_map_cache_evict(size_t budget)
+{
+    struct ion_map_entry *entry = map_tail, *prev;
+
+    while (entry && (map_total > budget)) {
+        prev = entry->prev;
+        if (entry->refs == 0)
+            ion_map_cache_release(entry);
+        entry = prev;
+    }
+}
+
+void ion_map_cache_set_anon(int fd)
+{
+    struct stat st;
+
+    pthread_mutex_lock(&map_lock);
+    anon_checked = false;
+    anon_dev = 0;
+    anon_ino = 0;
+    if ((fd >= 0) && (fstat(fd, &st) == 0)) {
+        anon_checked = true;
+        anon_dev = st.st_dev;
+        anon_ino = st.st_ino;
+    }
+    pthread_mutex_unlock(&map_lock);
+}
+
+void *ion_map_cached(ion_buffer buffer, size_t len, off_t offset)
+{
+    struct ion_map_entry *entry;
+    struct stat st;
+    void *addr;
+
+    if (fstat(buffer, &st) < 0)
+        return MAP_FAILED;
+
+    pthread_mutex_lock(&map_lock);
+    ion_map_cache_check_anon();
+
+    for (entry = map_head; entry; entry = entry->next) {
+        if (!entry->shared && (entry->ino == st.st_ino) &&
+                (entry->dev == st.st_dev) && (entry->offset == offset) &&
+                (entry->len == len)) {
+            entry->refs++;
+            ion_map_cache_unlink(entry);
+            ion_map_cache_push_front(entry);
+            pthread_mutex_unlock(&map_lock);
+            return entry->addr;
+        }
+    }
+    pthread_mutex_unlock(&map_lock);
+
+    entry = (struct ion_map_entry *)malloc(sizeof(*entry));
+    if (!entry)
+        return MAP_FAILED;
+
+    addr = ion_map(buffer, len, offset);
+    if (addr == MAP_FAILED) {
+        free(entry);
+        return MAP_FAILED;
+    }
+
+    entry->dev = st.st_dev;
+    entry->ino = st.st_ino;
+    entry->offset = offset;
+    entry->len = len;
+    entry->addr = addr;
+    entry->refs = 1;
+
+    pthread_mutex_lock(&map_lock);
+    entry->shared = anon_checked && (st.st_dev == anon_dev) &&
+                    (st.st_ino == anon_ino);
+    ion_map_cache_push_front(entry);
+    map_total += len;
+    ion_map_cache_evict(map_budget);
+    pthread_mutex_unlock(&map_lock);
+
+    return addr;
+}
+
+int ion_unmap_cached(void *addr)
+{
+    struct ion_map_entry *entry;
+
+    pthread_mutex_lock(&map_lock);
+    for (entry = map_head; entry; entry = entry->next) {
+        if ((entry->addr == addr) && (entry->refs > 0))
+            break;
+    }
+
+    if (!entry) {
+        pthread_mutex_unlock(&map_lock);
+        return -1;
+    }
+
+    entry->refs--;
+    if ((entry->refs == 0) && entry->shared)
+        ion_map_cache_release(entry);
+    else
+        ion_map_cache_evict(map_budget);
+    pthread_mutex_unlock(&map_lock);
+
+    return 0;
+}
+
+void ion_map_cache_set_budget(size_t budget)
+{
+    pthread_mutex_lock(&map_lock);
+    map_budget = budget;
+    ion_map_cache_evict(map_budget);
+    pthread_mutex_unlock(&map_lock);
+}
+
+void ion_map_cache_flush(void)
+{
+    pthread_mutex_lock(&map_lock);
+    ion_map_cache_evict(0);
+    pthread_mutex_unlock(&map_lock);
+}
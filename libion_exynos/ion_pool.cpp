@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ion.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#define ION_POOL_PAGE_SIZE      4096
+#define ION_POOL_MAX_HEAPS      16
+
+/*
+ * A buffer owned by the pool. It is either on the free list waiting to be
+ * reused, or on the busy list while a caller holds it.
+ */
+struct ion_pool_entry {
+    struct ion_pool_entry *next;
+    ion_buffer buffer;
+    size_t len;
+    size_t align;
+    unsigned int heap_mask;
+    unsigned int flags;
+};
+
+struct ion_pool_heap {
+    unsigned int heap_mask;
+    size_t limit;
+    size_t cached;
+};
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ion_pool_entry *pool_free_list;  /* most recently freed first */
+static struct ion_pool_entry *pool_busy_list;
+static struct ion_pool_heap pool_heaps[ION_POOL_MAX_HEAPS];
+static size_t pool_cached;
+
+/*
+ * Rounds @len up to its size class. Below 64KiB classes are one page apart,
+ * above that there are eight classes per power of two so that no more than
+ * 1/8 of a buffer is wasted while same-sized frames still share a class.
+ */
+static size_t ion_pool_size_class(size_t len)
+{
+    size_t step = ION_POOL_PAGE_SIZE;
+
+    if (len > 16 * ION_POOL_PAGE_SIZE) {
+        size_t order = 16 * ION_POOL_PAGE_SIZE;
+        while (order * 2 < len)
+            order *= 2;
+        step = order / 8;
+    }
+
+    return (len + step - 1) & ~(step - 1);
+}
+
+/* Must be called with pool_lock held */
+static struct ion_pool_heap *ion_pool_get_heap(unsigned int heap_mask)
+{
+    int i;
+
+    for (i = 0; i < ION_POOL_MAX_HEAPS; i++) {
+        if (pool_heaps[i].heap_mask == heap_mask)
+            return &pool_heaps[i];
+    }
+
+    for (i = 0; i < ION_POOL_MAX_HEAPS; i++) {
+        if (pool_heaps[i].heap_mask == 0) {
+            pool_heaps[i].heap_mask = heap_mask;
+            pool_heaps[i].limit = ION_POOL_DEFAULT_LIMIT;
+            pool_heaps[i].cached = 0;
+            return &pool_heaps[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Must be called with pool_lock held. Frees the free list entry at @link */
+static void ion_pool_release(struct ion_pool_entry **link)
+{
+    struct ion_pool_entry *entry = *link;
+    struct ion_pool_heap *heap = ion_pool_get_heap(entry->heap_mask);
+
+    *link = entry->next;
+    if (heap)
+        heap->cached -= entry->len;
+    pool_cached -= entry->len;
+
+    ion_free(entry->buffer);
+    free(entry);
+}
+
+/* Must be called with pool_lock held. Frees the oldest cached buffers */
+static void ion_pool_shrink(unsigned int heap_mask, size_t limit)
+{
+    struct ion_pool_entry **link, **oldest;
+    struct ion_pool_heap *heap = NULL;
+
+    if (heap_mask) {
+        heap = ion_pool_get_heap(heap_mask);
+        if (!heap)
+            return;
+    }
+
+    while ((heap ? heap->cached : pool_cached) > limit) {
+        oldest = NULL;
+        for (link = &pool_free_list; *link; link = &(*link)->next) {
+            if (!heap_mask || (*link)->heap_mask == heap_mask)
+                oldest = link;
+        }
+        if (!oldest)
+            break;
+        ion_pool_release(oldest);
+    }
+}
+
+ion_buffer ion_pool_alloc(ion_client client, size_t len, size_t align,
+                          unsigned int heap_mask, unsigned int flags)
+{
+    struct ion_pool_entry **link, *entry;
+    struct ion_pool_heap *heap;
+    ion_buffer buffer;
+    size_t class_len = ion_pool_size_class(len);
+
+    pthread_mutex_lock(&pool_lock);
+    for (link = &pool_free_list; *link; link = &(*link)->next) {
+        entry = *link;
+        if ((entry->len == class_len) && (entry->align == align) &&
+                (entry->heap_mask == heap_mask) && (entry->flags == flags)) {
+            *link = entry->next;
+            heap = ion_pool_get_heap(heap_mask);
+            if (heap)
+                heap->cached -= entry->len;
+            pool_cached -= entry->len;
+
+            entry->next = pool_busy_list;
+            pool_busy_list = entry;
+            pthread_mutex_unlock(&pool_lock);
+            return entry->buffer;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    entry = (struct ion_pool_entry *)malloc(sizeof(*entry));
+    if (!entry)
+        return ion_alloc(client, len, align, heap_mask, flags);
+
+    buffer = ion_alloc(client, class_len, align, heap_mask, flags);
+    if (buffer < 0) {
+        free(entry);
+        return buffer;
+    }
+
+    entry->buffer = buffer;
+    entry->len = class_len;
+    entry->align = align;
+    entry->heap_mask = heap_mask;
+    entry->flags = flags;
+
+    pthread_mutex_lock(&pool_lock);
+    entry->next = pool_busy_list;
+    pool_busy_list = entry;
+    pthread_mutex_unlock(&pool_lock);
+
+    return buffer;
+}
+
+void ion_pool_free(ion_buffer buffer)
+{
+    struct ion_pool_entry **link, *entry;
+    struct ion_pool_heap *heap;
+
+    pthread_mutex_lock(&pool_lock);
+    for (link = &pool_busy_list; *link; link = &(*link)->next) {
+        if ((*link)->buffer == buffer)
+            break;
+    }
+
+    entry = *link;
+    if (!entry) {
+        pthread_mutex_unlock(&pool_lock);
+        ion_free(buffer);
+        return;
+    }
+    *link = entry->next;
+
+    heap = ion_pool_get_heap(entry->heap_mask);
+    if (!heap || (entry->len > heap->limit)) {
+        pthread_mutex_unlock(&pool_lock);
+        ion_free(entry->buffer);
+        free(entry);
+        return;
+    }
+
+    entry->next = pool_free_list;
+    pool_free_list = entry;
+    heap->cached += entry->len;
+    pool_cached += entry->len;
+
+    ion_pool_shrink(entry->heap_mask, heap->limit);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+int ion_pool_set_limit(unsigned int heap_mask, size_t limit)
+{
+    struct ion_pool_heap *heap;
+
+    pthread_mutex_lock(&pool_lock);
+    heap = ion_pool_get_heap(heap_mask);
+    if (!heap) {
+        pthread_mutex_unlock(&pool_lock);
+        return -1;
+    }
+
+    heap->limit = limit;
+    ion_pool_shrink(heap_mask, limit);
+    pthread_mutex_unlock(&pool_lock);
+
+    return 0;
+}
+
+void ion_pool_trim(unsigned int heap_mask, size_t limit)
+{
+    pthread_mutex_lock(&pool_lock);
+    ion_pool_shrink(heap_mask, limit);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+size_t ion_pool_cached_size(unsigned int heap_mask)
+{
+    struct ion_pool_heap *heap;
+    size_t cached = 0;
+
+    pthread_mutex_lock(&pool_lock);
+    if (!heap_mask) {
+        cached = pool_cached;
+    } else {
+        heap = ion_pool_get_heap(heap_mask);
+        if (heap)
+            cached = heap->cached;
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    return cached;
+}
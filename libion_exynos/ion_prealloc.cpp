@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ion.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <cutils/log.h>
+
+struct ion_prealloc {
+    pthread_t thread;
+    ion_client client;
+    size_t len;
+    size_t align;
+    unsigned int heap_mask;
+    unsigned int flags;
+    unsigned int count;
+    int result;
+    int event_fd;
+    ion_prealloc_callback callback;
+    void *data;
+    ion_buffer buffers[ION_PREALLOC_MAX_BUFFERS];
+};
+
+int ion_alloc_set(ion_client client, size_t len, size_t align,
+                  unsigned int heap_mask, unsigned int flags,
+                  unsigned int count, ion_buffer *buffers)
+{
+    unsigned int i;
+
+    for (i = 0; i < count; i++) {
+        buffers[i] = ion_alloc(client, len, align, heap_mask, flags);
+        if (buffers[i] < 0) {
+            int ret = buffers[i];
+
+            ALOGE("%s: buffer %u of %u (%zu bytes, heap 0x%x) failed",
+                  __func__, i, count, len, heap_mask);
+            while (i-- > 0) {
+                ion_free(buffers[i]);
+                buffers[i] = -1;
+            }
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+static void *ion_prealloc_thread(void *arg)
+{
+    struct ion_prealloc *req = (struct ion_prealloc *)arg;
+    uint64_t event = 1;
+
+    req->result = ion_alloc_set(req->client, req->len, req->align,
+                                req->heap_mask, req->flags,
+                                req->count, req->buffers);
+
+    if (req->callback)
+        req->callback(req, req->result, req->data);
+
+    if (write(req->event_fd, &event, sizeof(event)) != sizeof(event))
+        ALOGE("%s: failed to signal completion (%s)", __func__, strerror(errno));
+
+    return NULL;
+}
+
+struct ion_prealloc *ion_prealloc_start(ion_client client, size_t len,
+                                        size_t align, unsigned int heap_mask,
+                                        unsigned int flags, unsigned int count,
+                                        ion_prealloc_callback callback,
+                                        void *data)
+{
+    struct ion_prealloc *req;
+
+    if ((count == 0) || (count > ION_PREALLOC_MAX_BUFFERS))
+        return NULL;
+
+    req = (struct ion_prealloc *)calloc(1, sizeof(*req));
+    if (!req)
+        return NULL;
+
+    req->client = client;
+    req->len = len;
+    req->align = align;
+    req->heap_mask = heap_mask;
+    req->flags = flags;
+    req->count = count;
+    req->result = -EINPROGRESS;
+    req->callback = callback;
+    req->data = data;
+
+    req->event_fd = eventfd(0, EFD_CLOEXEC);
+    if (req->event_fd < 0) {
+        free(req);
+        return NULL;
+    }
+
+    if (pthread_create(&req->thread, NULL, ion_prealloc_thread, req) != 0) {
+        close(req->event_fd);
+        free(req);
+        return NULL;
+    }
+
+    return req;
+}
+
+int ion_prealloc_fd(struct ion_prealloc *req)
+{
+    return req->event_fd;
+}
+
+int ion_prealloc_finish(struct ion_prealloc *req, ion_buffer *buffers)
+{
+    int ret;
+
+    pthread_join(req->thread, NULL);
+
+    ret = req->result;
+    if (ret >= 0)
+        memcpy(buffers, req->buffers, req->count * sizeof(ion_buffer));
+
+    close(req->event_fd);
+    free(req);
+
+    return ret;
+}
+
+void ion_prealloc_cancel(struct ion_prealloc *req)
+{
+    unsigned int i;
+
+    pthread_join(req->thread, NULL);
+
+    if (req->result >= 0) {
+        for (i = 0; i < req->count; i++)
+            ion_free(req->buffers[i]);
+    }
+
+    close(req->event_fd);
+    free(req);
+}
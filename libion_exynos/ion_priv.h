@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIB_ION_PRIV_H_
+#define _LIB_ION_PRIV_H_
+
+#include <ion.h>
+#include <sys/ioctl.h>
+
+/* Internal hooks of libion_exynos, not exported through ion.h */
+
+#define ION_STATS_MAX_HEAPS     32
+#define ION_STATS_MAX_FDS       4096    /* buffers on higher fds are not tracked */
+
+#define ION_MAP_PAGE_SIZE           4096
+#define ION_MAP_LARGE_PAGE_SIZE     (64 * 1024)
+#define ION_MAP_SECTION_SIZE        (1024 * 1024)
+
+typedef unsigned long ion_handle;
+
+struct ion_allocation_data {
+    size_t len;
+    size_t align;
+    unsigned int heap_mask;
+    unsigned int flags;
+    ion_handle handle;
+};
+
+/* ION_IOC_ALLOC of kernels that return a dma-buf fd and have no handles */
+struct ion_fd_allocation_data {
+    unsigned long long len;
+    unsigned int heap_id_mask;
+    unsigned int flags;
+    unsigned int fd;
+    unsigned int unused;
+};
+
+struct ion_fd_data {
+    ion_handle handle;
+    int fd;
+};
+
+struct ion_handle_data {
+    ion_handle handle;
+};
+
+struct ion_custom_data {
+    unsigned int cmd;
+    unsigned long arg;
+};
+
+#define ION_IOC_MAGIC   'I'
+#define ION_IOC_ALLOC   _IOWR(ION_IOC_MAGIC, 0, struct ion_allocation_data)
+#define ION_IOC_FREE    _IOWR(ION_IOC_MAGIC, 1, struct ion_handle_data)
+#define ION_IOC_MAP     _IOWR(ION_IOC_MAGIC, 2, struct ion_fd_data)
+#define ION_IOC_SHARE   _IOWR(ION_IOC_MAGIC, 4, struct ion_fd_data)
+#define ION_IOC_IMPORT  _IOWR(ION_IOC_MAGIC, 5, struct ion_fd_data)
+#define ION_IOC_CUSTOM  _IOWR(ION_IOC_MAGIC, 6, struct ion_custom_data)
+#define ION_IOC_SYNC	_IOWR(ION_IOC_MAGIC, 7, struct ion_fd_data)
+#define ION_IOC_FD_ALLOC    _IOWR(ION_IOC_MAGIC, 0, struct ion_fd_allocation_data)
+
+struct ion_msync_data {
+    long flags;
+    ion_buffer buf;
+    size_t size;
+    off_t offset;
+};
+
+enum ION_EXYNOS_CUSTOM_CMD {
+    ION_EXYNOS_CUSTOM_MSYNC
+};
+
+/*
+ * A provider of the ION ioctl interface. The kernel backend talks to
+ * /dev/ion, the memfd backend emulates it in userspace so that the library
+ * can run and be measured without the driver.
+ */
+struct ion_backend {
+    const char *name;
+    int (*open)(void);
+    void (*close)(int client);
+    int (*ioctl)(int client, unsigned long request, void *arg);
+};
+
+extern const struct ion_backend ion_kernel_backend;
+extern const struct ion_backend ion_memfd_backend;
+
+/* The backend selected for this process */
+const struct ion_backend *ion_get_backend(void);
+
+/* Monotonic time in ns for latency measurement */
+long long ion_stats_now(void);
+
+/* Accounts an ion_alloc() that took @ns and returned @buffer */
+void ion_stats_alloc(unsigned int heap_mask, size_t len, ion_buffer buffer,
+                     long long ns);
+
+/* Accounts an ion_free() of @buffer */
+void ion_stats_free(ion_buffer buffer);
+
+/* Accounts an ion_map() that took @ns, @failed if it returned MAP_FAILED */
+void ion_stats_map(size_t len, long long ns, bool failed);
+
+/* Accounts @faults page faults taken while prefaulting a mapping */
+void ion_stats_prefault(unsigned long faults);
+
+/* Lifetime tracking hooks, no-ops unless ion_track_enable() was called */
+void ion_track_alloc(ion_buffer buffer, size_t len, unsigned int heap_mask);
+void ion_track_free(ion_buffer buffer);
+void ion_track_map(void *addr, size_t len, ion_buffer buffer,
+                   unsigned long prefaulted);
+void ion_track_unmap(void *addr);
+
+/*
+ * Test hook: buffers on the inode of @fd are taken for dma-bufs exported on
+ * the single anon inode of older kernels. -1 looks the anon inode up again.
+ */
+void ion_map_cache_set_anon(int fd);
+
+#endif /* _LIB_ION_PRIV_H_ */
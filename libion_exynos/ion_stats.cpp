@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "ion_priv.h"
+
+/*
+ * All counters are updated with atomic builtins only, so accounting never
+ * takes a lock on the allocation path. Each heap is identified by the lowest
+ * bit of the heap mask it was allocated with.
+ */
+struct ion_heap_counters {
+    size_t live_bytes;
+    size_t peak_bytes;
+    unsigned long alloc_count;
+    unsigned long free_count;
+    unsigned long fail_count;
+    unsigned long alloc_latency[ION_STATS_BUCKETS];
+};
+
+/* What ion_free() needs to know about a live buffer, indexed by its fd */
+struct ion_fd_record {
+    unsigned int heap;      /* heap bit + 1, 0 if the fd is not tracked */
+    size_t len;
+};
+
+static struct ion_heap_counters heap_counters[ION_STATS_MAX_HEAPS];
+static struct ion_fd_record fd_records[ION_STATS_MAX_FDS];
+static unsigned long map_count;
+static unsigned long map_fail_count;
+static unsigned long long map_bytes;
+static unsigned long long map_prefaulted;
+static unsigned long map_latency[ION_STATS_BUCKETS];
+
+long long ion_stats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Bucket 0 is below 1us, bucket i is [2^(i-1), 2^i) us, the last is open */
+static unsigned int ion_stats_bucket(long long ns)
+{
+    unsigned long long us = ns / 1000;
+    unsigned int bucket = 0;
+
+    while (us && (bucket < ION_STATS_BUCKETS - 1)) {
+        us >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+static unsigned int ion_stats_heap(unsigned int heap_mask)
+{
+    return heap_mask ? __builtin_ctz(heap_mask) : 0;
+}
+
+void ion_stats_alloc(unsigned int heap_mask, size_t len, ion_buffer buffer,
+                     long long ns)
+{
+    unsigned int heap = ion_stats_heap(heap_mask);
+    struct ion_heap_counters *c = &heap_counters[heap];
+    size_t live, peak;
+
+    __atomic_fetch_add(&c->alloc_latency[ion_stats_bucket(ns)], 1,
+                       __ATOMIC_RELAXED);
+
+    if (buffer < 0) {
+        __atomic_fetch_add(&c->fail_count, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    __atomic_fetch_add(&c->alloc_count, 1, __ATOMIC_RELAXED);
+
+    /* the free of a buffer without a record could not be accounted */
+    if (buffer >= ION_STATS_MAX_FDS)
+        return;
+
+    /*
+     * A record still on the fd belongs to a buffer that was closed without
+     * ion_free(), since the fd could be reused. Account it as freed now
+     * rather than leaving its bytes live forever.
+     */
+    ion_stats_free(buffer);
+
+    live = __atomic_add_fetch(&c->live_bytes, len, __ATOMIC_RELAXED);
+    peak = __atomic_load_n(&c->peak_bytes, __ATOMIC_RELAXED);
+    while ((live > peak) &&
+            !__atomic_compare_exchange_n(&c->peak_bytes, &peak, live, true,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+
+    __atomic_store_n(&fd_records[buffer].len, len, __ATOMIC_RELAXED);
+    __atomic_store_n(&fd_records[buffer].heap, heap + 1, __ATOMIC_RELEASE);
+}
+
+void ion_stats_free(ion_buffer buffer)
+{
+    struct ion_heap_counters *c;
+    unsigned int heap;
+    size_t len;
+
+    if ((buffer < 0) || (buffer >= ION_STATS_MAX_FDS))
+        return;
+
+    heap = __atomic_exchange_n(&fd_records[buffer].heap, 0, __ATOMIC_ACQUIRE);
+    if (!heap)
+        return;
+
+    len = __atomic_load_n(&fd_records[buffer].len, __ATOMIC_RELAXED);
+    c = &heap_counters[heap - 1];
+    __atomic_fetch_sub(&c->live_bytes, len, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->free_count, 1, __ATOMIC_RELAXED);
+}
+
+void ion_stats_map(size_t len, long long ns, bool failed)
+{
+    __atomic_fetch_add(&map_latency[ion_stats_bucket(ns)], 1, __ATOMIC_RELAXED);
+
+    if (failed) {
+        __atomic_fetch_add(&map_fail_count, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    __atomic_fetch_add(&map_count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&map_bytes, (unsigned long long)len, __ATOMIC_RELAXED);
+}
+
+void ion_stats_prefault(unsigned long faults)
+{
+    __atomic_fetch_add(&map_prefaulted, (unsigned long long)faults,
+                       __ATOMIC_RELAXED);
+}
+
+int ion_stats_get_heap(unsigned int heap_mask, struct ion_heap_stats *stats)
+{
+    struct ion_heap_counters *c;
+    unsigned int i;
+
+    if (!heap_mask || !stats)
+        return -1;
+
+    c = &heap_counters[ion_stats_heap(heap_mask)];
+    stats->heap_mask = 1U << ion_stats_heap(heap_mask);
+    stats->live_bytes = __atomic_load_n(&c->live_bytes, __ATOMIC_RELAXED);
+    stats->peak_bytes = __atomic_load_n(&c->peak_bytes, __ATOMIC_RELAXED);
+    stats->alloc_count = __atomic_load_n(&c->alloc_count, __ATOMIC_RELAXED);
+    stats->free_count = __atomic_load_n(&c->free_count, __ATOMIC_RELAXED);
+    stats->fail_count = __atomic_load_n(&c->fail_count, __ATOMIC_RELAXED);
+    for (i = 0; i < ION_STATS_BUCKETS; i++)
+        stats->alloc_latency[i] = __atomic_load_n(&c->alloc_latency[i],
+                                                  __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+void ion_stats_get_map(struct ion_map_stats *stats)
+{
+    unsigned int i;
+
+    stats->map_count = __atomic_load_n(&map_count, __ATOMIC_RELAXED);
+    stats->fail_count = __atomic_load_n(&map_fail_count, __ATOMIC_RELAXED);
+    stats->map_bytes = __atomic_load_n(&map_bytes, __ATOMIC_RELAXED);
+    stats->prefaulted_pages = __atomic_load_n(&map_prefaulted, __ATOMIC_RELAXED);
+    for (i = 0; i < ION_STATS_BUCKETS; i++)
+        stats->map_latency[i] = __atomic_load_n(&map_latency[i],
+                                                __ATOMIC_RELAXED);
+}
+
+static int ion_stats_dump_histogram(char *buf, size_t len,
+                                    const unsigned long *buckets)
+{
+    size_t pos = 0;
+    unsigned int i;
+
+    for (i = 0; i < ION_STATS_BUCKETS; i++) {
+        if (!buckets[i])
+            continue;
+        if (i == 0)
+            pos += snprintf(buf + pos, len - pos, " <1us:%lu", buckets[i]);
+        else
+            pos += snprintf(buf + pos, len - pos, " <%luus:%lu",
+                            1UL << i, buckets[i]);
+        if (pos >= len)
+            return len;
+    }
+    pos += snprintf(buf + pos, len - pos, "\n");
+
+    return pos < len ? pos : len;
+}
+
+int ion_stats_dump(char *buf, size_t len)
+{
+    struct ion_heap_stats hs;
+    struct ion_map_stats ms;
+    size_t pos = 0;
+    unsigned int i;
+
+    if (!buf || !len)
+        return 0;
+    buf[0] = '\0';
+
+#define ION_STATS_APPEND(...)                                           \
+    do {                                                                \
+        pos += snprintf(buf + pos, len - pos, __VA_ARGS__);             \
+        if (pos >= len)                                                 \
+            return len - 1;                                             \
+    } while (0)
+
+    ION_STATS_APPEND("ION heaps:\n");
+    for (i = 0; i < ION_STATS_MAX_HEAPS; i++) {
+        ion_stats_get_heap(1U << i, &hs);
+        if (!hs.alloc_count && !hs.fail_count)
+            continue;
+        ION_STATS_APPEND("  heap 0x%08x live %zu peak %zu allocs %lu frees %lu fails %lu\n"
+                         "    alloc latency:",
+                         hs.heap_mask, hs.live_bytes, hs.peak_bytes,
+                         hs.alloc_count, hs.free_count, hs.fail_count);
+        pos += ion_stats_dump_histogram(buf + pos, len - pos, hs.alloc_latency);
+        if (pos >= len - 1)
+            return len - 1;
+    }
+
+    ion_stats_get_map(&ms);
+    ION_STATS_APPEND("  map count %lu bytes %llu fails %lu prefaulted pages %llu\n"
+                     "    map latency:",
+                     ms.map_count, ms.map_bytes, ms.fail_count,
+                     ms.prefaulted_pages);
+    pos += ion_stats_dump_histogram(buf + pos, len - pos, ms.map_latency);
+
+#undef ION_STATS_APPEND
+
+    return pos < len ? pos : len - 1;
+}
@@ -0,0 +1,591 @@
+/*
+ * Copyright (C) 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * ion_test - functional checks of libion_exynos
+ *
+ * usage: ion_test
+ *
+ * Runs on the memfd backend, so it needs no ION driver and also runs on a
+ * build host. Whether a mapping is still in place is read from the records
+ * of ion_track. Exits with 1 if any check fails.
+ */
+
+#include <ion.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ion_priv.h"
+
+#define TEST_MAX_RECORDS    64
+
+/* no heap of the memfd backend has this mask, allocations from it fail */
+#define TEST_NO_HEAP_MASK   (1 << 2)
+
+static unsigned int test_failures;
+
+#define TEST_CHECK(cond)                                                \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            printf("  FAIL %s:%d: %s\n", __func__, __LINE__, #cond);    \
+            test_failures++;                                            \
+        }                                                               \
+    } while (0)
+
+static bool test_cloexec(int fd)
+{
+    int flags = fcntl(fd, F_GETFD);
+
+    return (flags >= 0) && (flags & FD_CLOEXEC);
+}
+
+/* Buffer fds are close-on-exec */
+static void test_alloc_cloexec(ion_client client)
+{
+    ion_buffer buffer;
+
+    buffer = ion_alloc(client, 4096, 0, ION_HEAP_SYSTEM_MASK, 0);
+    TEST_CHECK(buffer > 0);
+    if (buffer <= 0)
+        return;
+    TEST_CHECK(test_cloexec(buffer));
+    ion_free(buffer);
+}
+
+/* With stdin closed, a buffer must still not be fd 0 */
+static void test_alloc_fd0(ion_client client)
+{
+    ion_buffer buffer;
+    int stdin_fd;
+
+    stdin_fd = dup(0);
+    close(0);
+
+    buffer = ion_alloc(client, 4096, 0, ION_HEAP_SYSTEM_MASK, 0);
+    TEST_CHECK(buffer > 0);
+    if (buffer > 0) {
+        TEST_CHECK(test_cloexec(buffer));
+        /* nothing of the allocation is left on fd 0 */
+        TEST_CHECK(fcntl(0, F_GETFD) < 0);
+        ion_free(buffer);
+    }
+
+    if (stdin_fd >= 0) {
+        dup2(stdin_fd, 0);
+        close(stdin_fd);
+    }
+}
+
+/* A buffer closed without ion_free() leaves live_bytes when its fd is reused */
+static void test_stats_close_reuse(ion_client client)
+{
+    struct ion_heap_stats before, after;
+    ion_buffer first, second;
+
+    ion_stats_get_heap(ION_HEAP_SYSTEM_MASK, &before);
+
+    first = ion_alloc(client, 8192, 0, ION_HEAP_SYSTEM_MASK, 0);
+    TEST_CHECK(first > 0);
+    if (first <= 0)
+        return;
+    close(first);
+
+    second = ion_alloc(client, 4096, 0, ION_HEAP_SYSTEM_MASK, 0);
+    TEST_CHECK(second == first);
+    if (second <= 0)
+        return;
+
+    ion_stats_get_heap(ION_HEAP_SYSTEM_MASK, &after);
+    TEST_CHECK(after.live_bytes == before.live_bytes + 4096);
+
+    ion_free(second);
+    ion_stats_get_heap(ION_HEAP_SYSTEM_MASK, &after);
+    TEST_CHECK(after.live_bytes == before.live_bytes);
+}
+
+/*
+ * A prefaulted memfd mapping takes its faults in mmap(): the tracker record
+ * holds the measured count and the map statistics grow by exactly that much.
+ * A mapping without ION_MAP_PREFAULT records none.
+ */
+static void test_map_prefault(ion_client client)
+{
+    const size_t len = 16 * 4096;
+    struct ion_map_stats before, after;
+    struct ion_track_record rec[2];
+    unsigned long since;
+    ion_buffer buffer;
+    void *addr;
+
+    buffer = ion_alloc(client, len, 0, ION_HEAP_SYSTEM_MASK, 0);
+    TEST_CHECK(buffer > 0);
+    if (buffer <= 0)
+        return;
+    TEST_CHECK(ion_track_enable(1) == 0);
+    since = ion_track_snapshot();
+
+    ion_stats_get_map(&before);
+    addr = ion_map_ext(buffer, len, 0,
+                       ION_MAP_READ | ION_MAP_WRITE | ION_MAP_PREFAULT);
+    TEST_CHECK(addr != MAP_FAILED);
+    ion_stats_get_map(&after);
+    if (addr != MAP_FAILED) {
+        TEST_CHECK(ion_track_get(rec, 2, since) == 1);
+        TEST_CHECK(rec[0].type == ION_TRACK_MAP);
+        TEST_CHECK(rec[0].prefaulted > 0);
+        TEST_CHECK(rec[0].prefaulted <= len / 4096);
+        TEST_CHECK(after.prefaulted_pages ==
+                   before.prefaulted_pages + rec[0].prefaulted);
+        ion_unmap(addr, len);
+    }
+
+    since = ion_track_snapshot();
+    addr = ion_map_ext(buffer, len, 0, ION_MAP_READ | ION_MAP_WRITE);
+    TEST_CHECK(addr != MAP_FAILED);
+    if (addr != MAP_FAILED) {
+        TEST_CHECK(ion_track_get(rec, 2, since) == 1);
+        TEST_CHECK(rec[0].prefaulted == 0);
+        ion_unmap(addr, len);
+    }
+
+    ion_track_enable(0);
+    ion_free(buffer);
+}
+
+/* Whether @addr is still mapped, by the live records of ion_track */
+static bool test_mapped(void *addr)
+{
+    struct ion_track_record rec[TEST_MAX_RECORDS];
+    int i, count;
+
+    count = ion_track_get(rec, TEST_MAX_RECORDS, 0);
+    for (i = 0; (i < count) && (i < TEST_MAX_RECORDS); i++) {
+        if ((rec[i].type == ION_TRACK_MAP) && (rec[i].addr == addr))
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * The cache is keyed by the dev, inode, offset and length of the buffer:
+ * another fd of the same buffer hits, another range or buffer does not.
+ */
+static void test_map_cache_key(ion_client client)
+{
+    const size_t len = 4 * 4096;
+    ion_buffer buffer, other;
+    void *addr, *dup_addr, *off_addr, *len_addr, *other_addr;
+    int dup_fd;
+
+    buffer = ion_alloc(client, len, 0, ION_HEAP_SYSTEM_MASK, 0);
+    other = ion_alloc(client, len, 0, ION_HEAP_SYSTEM_MASK, 0);
+    dup_fd = dup(buffer);
+    TEST_CHECK((buffer > 0) && (other > 0) && (dup_fd >= 0));
+    if ((buffer <= 0) || (other <= 0) || (dup_fd < 0))
+        return;
+
+    addr = ion_map_cached(buffer, len, 0);
+    TEST_CHECK(addr != MAP_FAILED);
+    dup_addr = ion_map_cached(dup_fd, len, 0);
+    TEST_CHECK(dup_addr == addr);
+    off_addr = ion_map_cached(buffer, len / 2, len / 2);
+    TEST_CHECK((off_addr != MAP_FAILED) && (off_addr != addr));
+    len_addr = ion_map_cached(buffer, len / 2, 0);
+    TEST_CHECK((len_addr != MAP_FAILED) && (len_addr != addr));
+    TEST_CHECK(len_addr != off_addr);
+    other_addr = ion_map_cached(other, len, 0);
+    TEST_CHECK((other_addr != MAP_FAILED) && (other_addr != addr));
+
+    /* one reference per ion_map_cached(), then no more */
+    TEST_CHECK(ion_unmap_cached(addr) == 0);
+    TEST_CHECK(ion_unmap_cached(dup_addr) == 0);
+    TEST_CHECK(ion_unmap_cached(addr) == -1);
+    TEST_CHECK(ion_unmap_cached(off_addr) == 0);
+    TEST_CHECK(ion_unmap_cached(len_addr) == 0);
+    TEST_CHECK(ion_unmap_cached(other_addr) == 0);
+
+    ion_map_cache_flush();
+    close(dup_fd);
+    ion_free(other);
+    ion_free(buffer);
+}
+
+/*
+ * Buffers on the shared anon inode have no identity: every call maps anew
+ * and a mapping goes away with its last reference.
+ */
+static void test_map_cache_anon(ion_client client)
+{
+    const size_t len = 4 * 4096;
+    ion_buffer buffer;
+    void *first, *second;
+
+    buffer = ion_alloc(client, len, 0, ION_HEAP_SYSTEM_MASK, 0);
+    TEST_CHECK(buffer > 0);
+    if (buffer <= 0)
+        return;
+    TEST_CHECK(ion_track_enable(1) == 0);
+    ion_map_cache_set_anon(buffer);
+
+    first = ion_map_cached(buffer, len, 0);
+    second = ion_map_cached(buffer, len, 0);
+    TEST_CHECK((first != MAP_FAILED) && (second != MAP_FAILED));
+    TEST_CHECK(first != second);
+
+    TEST_CHECK(ion_unmap_cached(first) == 0);
+    TEST_CHECK(!test_mapped(first));
+    TEST_CHECK(test_mapped(second));
+    TEST_CHECK(ion_unmap_cached(second) == 0);
+    TEST_CHECK(!test_mapped(second));
+
+    ion_map_cache_set_anon(-1);
+    ion_track_enable(0);
+    ion_free(buffer);
+}
+
+/*
+ * Idle mappings beyond the 64MiB budget are unmapped least recently used
+ * first. Referenced mappings stay until their last reference is dropped.
+ */
+static void test_map_cache_evict(ion_client client)
+{
+    const size_t len = ION_MAP_CACHE_DEFAULT_BUDGET / 4;
+    ion_buffer buffers[5];
+    void *addr[5];
+    unsigned int i;
+
+    for (i = 0; i < 5; i++) {
+        buffers[i] = ion_alloc(client, len, 0, ION_HEAP_SYSTEM_MASK, 0);
+        TEST_CHECK(buffers[i] > 0);
+        if (buffers[i] <= 0) {
+            while (i--)
+                ion_free(buffers[i]);
+            return;
+        }
+    }
+    TEST_CHECK(ion_track_enable(1) == 0);
+    ion_map_cache_set_budget(ION_MAP_CACHE_DEFAULT_BUDGET);
+
+    /* four idle mappings fill the budget */
+    for (i = 0; i < 4; i++) {
+        addr[i] = ion_map_cached(buffers[i], len, 0);
+        TEST_CHECK(addr[i] != MAP_FAILED);
+        ion_unmap_cached(addr[i]);
+    }
+    for (i = 0; i < 4; i++)
+        TEST_CHECK(test_mapped(addr[i]));
+
+    /* a hit makes buffers[0] the most recently used, so buffers[1] goes */
+    TEST_CHECK(ion_map_cached(buffers[0], len, 0) == addr[0]);
+    ion_unmap_cached(addr[0]);
+    addr[4] = ion_map_cached(buffers[4], len, 0);
+    TEST_CHECK(addr[4] != MAP_FAILED);
+    ion_unmap_cached(addr[4]);
+    TEST_CHECK(test_mapped(addr[0]));
+    TEST_CHECK(!test_mapped(addr[1]));
+    TEST_CHECK(test_mapped(addr[2]));
+    TEST_CHECK(test_mapped(addr[4]));
+
+    /* a flush leaves the referenced mapping alone */
+    TEST_CHECK(ion_map_cached(buffers[2], len, 0) == addr[2]);
+    ion_map_cache_flush();
+    TEST_CHECK(!test_mapped(addr[0]));
+    TEST_CHECK(test_mapped(addr[2]));
+    TEST_CHECK(!test_mapped(addr[3]));
+    TEST_CHECK(!test_mapped(addr[4]));
+    TEST_CHECK(ion_unmap_cached(addr[2]) == 0);
+    ion_map_cache_flush();
+    TEST_CHECK(!test_mapped(addr[2]));
+
+    ion_track_enable(0);
+    for (i = 0; i < 5; i++)
+        ion_free(buffers[i]);
+}
+
+/*
+ * An idle mapping outlives the fd it was made from. A new buffer on the
+ * same fd number must get its own mapping, not the one of the old buffer.
+ */
+static void test_map_cache_fd_reuse(ion_client client)
+{
+    const size_t len = 4 * 4096;
+    ion_buffer first, second;
+    unsigned char *old_addr, *addr, *plain;
+
+    first = ion_alloc(client, len, 0, ION_HEAP_SYSTEM_MASK, 0);
+    TEST_CHECK(first > 0);
+    if (first <= 0)
+        return;
+    old_addr = (unsigned char *)ion_map_cached(first, len, 0);
+    TEST_CHECK(old_addr != MAP_FAILED);
+    if (old_addr == MAP_FAILED) {
+        ion_free(first);
+        return;
+    }
+    memset(old_addr, 0xa5, len);
+    ion_unmap_cached(old_addr);
+    ion_free(first);
+
+    second = ion_alloc(client, len, 0, ION_HEAP_SYSTEM_MASK, 0);
+    TEST_CHECK(second == first);
+    if (second <= 0) {
+        ion_map_cache_flush();
+        return;
+    }
+
+    addr = (unsigned char *)ion_map_cached(second, len, 0);
+    TEST_CHECK((addr != MAP_FAILED) && (addr != old_addr));
+    if (addr != MAP_FAILED) {
+        memset(addr, 0x5a, len);
+        plain = (unsigned char *)ion_map(second, len, 0);
+        TEST_CHECK(plain != MAP_FAILED);
+        if (plain != MAP_FAILED) {
+            TEST_CHECK((plain[0] == 0x5a) && (plain[len - 1] == 0x5a));
+            ion_unmap(plain, len);
+        }
+        /* the old mapping still holds the old buffer */
+        TEST_CHECK(old_addr[0] == 0xa5);
+        ion_unmap_cached(addr);
+    }
+
+    ion_map_cache_flush();
+    ion_free(second);
+}
+
+static size_t test_size(int fd)
+{
+    struct stat st;
+
+    return (fstat(fd, &st) == 0) ? st.st_size : 0;
+}
+
+/*
+ * Lengths are rounded up to their size class, and a freed buffer serves the
+ * next request of the same class, alignment, heap mask and flags.
+ */
+static void test_pool_reuse(ion_client client)
+{
+    ion_buffer buffer, again, other, large;
+
+    ion_pool_trim(0, 0);
+
+    buffer = ion_pool_alloc(client, 5000, 0, ION_HEAP_SYSTEM_MASK, 0);
+    TEST_CHECK(buffer > 0);
+    if (buffer <= 0)
+        return;
+    TEST_CHECK(test_size(buffer) == 8192);
+    ion_pool_free(buffer);
+    TEST_CHECK(ion_pool_cached_size(ION_HEAP_SYSTEM_MASK) == 8192);
+    TEST_CHECK(ion_pool_cached_size(0) == 8192);
+
+    /* another class, alignment, heap mask or flags allocates anew */
+    other = ion_pool_alloc(client, 12288, 0, ION_HEAP_SYSTEM_MASK, 0);
+    TEST_CHECK((other > 0) && (other != buffer));
+    ion_pool_free(other);
+    other = ion_pool_alloc(client, 8192, 65536, ION_HEAP_SYSTEM_MASK, 0);
+    TEST_CHECK((other > 0) && (other != buffer));
+    ion_pool_free(other);
+    other = ion_pool_alloc(client, 8192, 0, ION_HEAP_SYSTEM_CONTIG_MASK, 0);
+    TEST_CHECK((other > 0) && (other != buffer));
+    ion_pool_free(other);
+    other = ion_pool_alloc(client, 8192, 0, ION_HEAP_SYSTEM_MASK,
+                           ION_FLAG_CACHED);
+    TEST_CHECK((other > 0) && (other != buffer));
+    ion_pool_free(other);
+
+    again = ion_pool_alloc(client, 6000, 0, ION_HEAP_SYSTEM_MASK, 0);
+    TEST_CHECK(again == buffer);
+    TEST_CHECK(ion_pool_cached_size(ION_HEAP_SYSTEM_MASK) == 12288 + 8192 + 8192);
+    ion_pool_free(again);
+
+    /* eight classes per power of two above 64KiB */
+    large = ion_pool_alloc(client, 100000, 0, ION_HEAP_SYSTEM_MASK, 0);
+    TEST_CHECK(large > 0);
+    if (large > 0) {
+        TEST_CHECK(test_size(large) == 106496);
+        ion_pool_free(large);
+    }
+
+    ion_pool_trim(0, 0);
+    TEST_CHECK(ion_pool_cached_size(0) == 0);
+    TEST_CHECK(fcntl(buffer, F_GETFD) < 0);
+}
+
+/*
+ * A heap caches no more than its limit, the oldest buffers are freed first.
+ * Buffers over the limit and buffers not from the pool are freed at once.
+ */
+static void test_pool_limit(ion_client client)
+{
+    ion_buffer buffers[3], large, plain;
+    unsigned int i;
+
+    ion_pool_trim(0, 0);
+    TEST_CHECK(ion_pool_set_limit(ION_HEAP_SYSTEM_MASK, 16384) == 0);
+
+    for (i = 0; i < 3; i++) {
+        buffers[i] = ion_pool_alloc(client, 8192, 0, ION_HEAP_SYSTEM_MASK, 0);
+        TEST_CHECK(buffers[i] > 0);
+    }
+    for (i = 0; i < 3; i++)
+        ion_pool_free(buffers[i]);
+    TEST_CHECK(ion_pool_cached_size(ION_HEAP_SYSTEM_MASK) == 16384);
+    TEST_CHECK(fcntl(buffers[0], F_GETFD) < 0);
+    TEST_CHECK(fcntl(buffers[1], F_GETFD) >= 0);
+    TEST_CHECK(fcntl(buffers[2], F_GETFD) >= 0);
+
+    large = ion_pool_alloc(client, 32768, 0, ION_HEAP_SYSTEM_MASK, 0);
+    TEST_CHECK(large > 0);
+    ion_pool_free(large);
+    TEST_CHECK(fcntl(large, F_GETFD) < 0);
+
+    plain = ion_alloc(client, 4096, 0, ION_HEAP_SYSTEM_MASK, 0);
+    TEST_CHECK(plain > 0);
+    ion_pool_free(plain);
+    TEST_CHECK(fcntl(plain, F_GETFD) < 0);
+    TEST_CHECK(ion_pool_cached_size(ION_HEAP_SYSTEM_MASK) == 16384);
+
+    /* a lower limit applies to what is already cached */
+    TEST_CHECK(ion_pool_set_limit(ION_HEAP_SYSTEM_MASK, 8192) == 0);
+    TEST_CHECK(ion_pool_cached_size(ION_HEAP_SYSTEM_MASK) == 8192);
+    TEST_CHECK(fcntl(buffers[1], F_GETFD) < 0);
+
+    ion_pool_set_limit(ION_HEAP_SYSTEM_MASK, ION_POOL_DEFAULT_LIMIT);
+    ion_pool_trim(0, 0);
+}
+
+/*
+ * A failing first step falls back to the next one, and is skipped once it
+ * has failed twice in a row. The last step is always tried.
+ */
+static void test_chain_fallback(ion_client client)
+{
+    const unsigned int masks[] = { TEST_NO_HEAP_MASK, ION_HEAP_SYSTEM_MASK };
+    struct ion_chain_stats stats;
+    ion_buffer buffers[3];
+    unsigned int heap_used, i;
+    int chain;
+
+    chain = ion_chain_register("test_fallback", masks, 2);
+    TEST_CHECK(chain >= 0);
+    if (chain < 0)
+        return;
+
+    for (i = 0; i < 3; i++) {
+        heap_used = 0;
+        buffers[i] = ion_alloc_chain(client, chain, 4096, 0, 0, &heap_used);
+        TEST_CHECK(buffers[i] > 0);
+        TEST_CHECK(heap_used == ION_HEAP_SYSTEM_MASK);
+    }
+
+    TEST_CHECK(ion_chain_get_stats(chain, &stats) == 0);
+    TEST_CHECK(stats.attempts[0] == 2);
+    TEST_CHECK(stats.skipped[0] == 1);
+    TEST_CHECK(stats.attempts[1] == 3);
+    TEST_CHECK(stats.served[0] == 0);
+    TEST_CHECK(stats.served[1] == 3);
+    TEST_CHECK(stats.fallbacks == 3);
+    TEST_CHECK(stats.failures == 0);
+
+    for (i = 0; i < 3; i++) {
+        if (buffers[i] > 0)
+            ion_free(buffers[i]);
+    }
+}
+
+/* A chain whose only step fails keeps trying it, and fails */
+static void test_chain_failure(ion_client client)
+{
+    const unsigned int masks[] = { TEST_NO_HEAP_MASK };
+    struct ion_chain_stats stats;
+    ion_buffer buffer;
+    unsigned int i;
+    int chain;
+
+    TEST_CHECK(ion_chain_register("test_invalid", masks, 0) == -EINVAL);
+    TEST_CHECK(ion_chain_register("test_invalid", masks,
+                                  ION_CHAIN_MAX_STEPS + 1) == -EINVAL);
+    TEST_CHECK(ion_chain_get_stats(-1, &stats) == -EINVAL);
+
+    chain = ion_chain_register("test_failure", masks, 1);
+    TEST_CHECK(chain >= 0);
+    if (chain < 0)
+        return;
+
+    for (i = 0; i < 3; i++) {
+        buffer = ion_alloc_chain(client, chain, 4096, 0, 0, NULL);
+        TEST_CHECK(buffer < 0);
+    }
+
+    TEST_CHECK(ion_chain_get_stats(chain, &stats) == 0);
+    TEST_CHECK(stats.attempts[0] == 3);
+    TEST_CHECK(stats.skipped[0] == 0);
+    TEST_CHECK(stats.failures == 3);
+    TEST_CHECK(ion_alloc_chain(client, chain + 1, 4096, 0, 0, NULL) == -EINVAL);
+}
+
+struct test_case {
+    const char *name;
+    void (*run)(ion_client client);
+};
+
+static const struct test_case test_cases[] = {
+    { "alloc_cloexec",      test_alloc_cloexec },
+    { "alloc_fd0",          test_alloc_fd0 },
+    { "stats_close_reuse",  test_stats_close_reuse },
+    { "map_prefault",       test_map_prefault },
+    { "map_cache_key",      test_map_cache_key },
+    { "map_cache_anon",     test_map_cache_anon },
+    { "map_cache_evict",    test_map_cache_evict },
+    { "map_cache_fd_reuse", test_map_cache_fd_reuse },
+    { "pool_reuse",         test_pool_reuse },
+    { "pool_limit",         test_pool_limit },
+    { "chain_fallback",     test_chain_fallback },
+    { "chain_failure",      test_chain_failure },
+};
+
+int main(void)
+{
+    ion_client client;
+    unsigned int i, failures;
+
+    if (ion_select_backend("memfd") < 0) {
+        fprintf(stderr, "the memfd backend is not available\n");
+        return 1;
+    }
+
+    client = ion_client_create();
+    if (client < 0) {
+        fprintf(stderr, "failed to create an ion client\n");
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(test_cases) / sizeof(test_cases[0]); i++) {
+        failures = test_failures;
+        test_cases[i].run(client);
+        printf("%-24s %s\n", test_cases[i].name,
+               (test_failures == failures) ? "ok" : "FAILED");
+    }
+
+    ion_client_destroy(client);
+
+    return test_failures ? 1 : 0;
+}
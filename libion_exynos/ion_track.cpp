@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "ion_priv.h"
+
+#define ION_TRACK_MAP_BUCKETS   256
+
+/*
+ * Allocations are indexed by fd like the ion_stats records, mappings are
+ * hashed by address. Both tables only exist while tracking is enabled, so
+ * a disabled tracker costs one load per hook.
+ */
+struct ion_track_alloc {
+    size_t len;
+    unsigned int heap_mask;
+    long long time;
+    const char *tag;
+    unsigned long serial;     /* 0 if the fd is not a live allocation */
+};
+
+struct ion_track_map {
+    struct ion_track_map *next;
+    void *addr;
+    size_t len;
+    ion_buffer buffer;
+    long long time;
+    const char *tag;
+    unsigned long serial;
+    unsigned long prefaulted;
+};
+
+static pthread_mutex_t track_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile int track_enabled;
+static unsigned long track_serial;
+static struct ion_track_alloc *track_allocs;
+static struct ion_track_map *track_maps[ION_TRACK_MAP_BUCKETS];
+static __thread const char *track_tag;
+
+static unsigned int ion_track_hash(void *addr)
+{
+    return ((unsigned long)addr / ION_MAP_PAGE_SIZE) % ION_TRACK_MAP_BUCKETS;
+}
+
+/* Must be called with track_lock held */
+static void ion_track_clear(void)
+{
+    struct ion_track_map *map, *next;
+    unsigned int i;
+
+    for (i = 0; i < ION_TRACK_MAP_BUCKETS; i++) {
+        for (map = track_maps[i]; map; map = next) {
+            next = map->next;
+            free(map);
+        }
+        track_maps[i] = NULL;
+    }
+
+    free(track_allocs);
+    track_allocs = NULL;
+}
+
+int ion_track_enable(int enable)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&track_lock);
+    if (enable && !track_enabled) {
+        track_allocs = (struct ion_track_alloc *)calloc(ION_STATS_MAX_FDS,
+                                                        sizeof(*track_allocs));
+        if (track_allocs)
+            track_enabled = 1;
+        else
+            ret = -ENOMEM;
+    } else if (!enable && track_enabled) {
+        track_enabled = 0;
+        ion_track_clear();
+    }
+    pthread_mutex_unlock(&track_lock);
+
+    return ret;
+}
+
+const char *ion_track_set_tag(const char *tag)
+{
+    const char *prev = track_tag;
+
+    track_tag = tag;
+
+    return prev;
+}
+
+void ion_track_alloc(ion_buffer buffer, size_t len, unsigned int heap_mask)
+{
+    struct ion_track_alloc *rec;
+
+    if (!track_enabled || (buffer < 0) || (buffer >= ION_STATS_MAX_FDS))
+        return;
+
+    pthread_mutex_lock(&track_lock);
+    if (track_allocs) {
+        rec = &track_allocs[buffer];
+        rec->len = len;
+        rec->heap_mask = heap_mask;
+        rec->time = ion_stats_now();
+        rec->tag = track_tag;
+        rec->serial = ++track_serial;
+    }
+    pthread_mutex_unlock(&track_lock);
+}
+
+void ion_track_free(ion_buffer buffer)
+{
+    if (!track_enabled || (buffer < 0) || (buffer >= ION_STATS_MAX_FDS))
+        return;
+
+    pthread_mutex_lock(&track_lock);
+    if (track_allocs)
+        track_allocs[buffer].serial = 0;
+    pthread_mutex_unlock(&track_lock);
+}
+
+void ion_track_map(void *addr, size_t len, ion_buffer buffer,
+                   unsigned long prefaulted)
+{
+    struct ion_track_map *map;
+    unsigned int hash;
+
+    if (!track_enabled)
+        return;
+
+    map = (struct ion_track_map *)malloc(sizeof(*map));
+    if (!map)
+        return;
+
+    map->addr = addr;
+    map->len = len;
+    map->buffer = buffer;
+    map->time = ion_stats_now();
+    map->tag = track_tag;
+    map->prefaulted = prefaulted;
+
+    hash = ion_track_hash(addr);
+    pthread_mutex_lock(&track_lock);
+    if (!track_enabled) {
+        pthread_mutex_unlock(&track_lock);
+        free(map);
+        return;
+    }
+    map->serial = ++track_serial;
+    map->next = track_maps[hash];
+    track_maps[hash] = map;
+    pthread_mutex_unlock(&track_lock);
+}
+
+void ion_track_unmap(void *addr)
+{
+    struct ion_track_map **link, *map = NULL;
+
+    if (!track_enabled)
+        return;
+
+    pthread_mutex_lock(&track_lock);
+    for (link = &track_maps[ion_track_hash(addr)]; *link; link = &(*link)->next) {
+        if ((*link)->addr == addr) {
+            map = *link;
+            *link = map->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&track_lock);
+
+    free(map);
+}
+
+unsigned long ion_track_snapshot(void)
+{
+    unsigned long serial;
+
+    pthread_mutex_lock(&track_lock);
+    serial = track_serial;
+    pthread_mutex_unlock(&track_lock);
+
+    return serial;
+}
+
+int ion_track_get(struct ion_track_record *records, int max,
+                  unsigned long since)
+{
+    struct ion_track_record *rec;
+    struct ion_track_map *map;
+    long long now = ion_stats_now();
+    unsigned int i;
+    int count = 0;
+
+    pthread_mutex_lock(&track_lock);
+    if (!track_enabled) {
+        pthread_mutex_unlock(&track_lock);
+        return 0;
+    }
+
+    for (i = 0; i < ION_STATS_MAX_FDS; i++) {
+        if (track_allocs[i].serial <= since)
+            continue;
+        if (count < max) {
+            rec = &records[count];
+            rec->type = ION_TRACK_ALLOC;
+            rec->buffer = i;
+            rec->addr = NULL;
+            rec->len = track_allocs[i].len;
+            rec->heap_mask = track_allocs[i].heap_mask;
+            rec->age_ns = now - track_allocs[i].time;
+            rec->tag = track_allocs[i].tag;
+            rec->serial = track_allocs[i].serial;
+            rec->prefaulted = 0;
+        }
+        count++;
+    }
+
+    for (i = 0; i < ION_TRACK_MAP_BUCKETS; i++) {
+        for (map = track_maps[i]; map; map = map->next) {
+            if (map->serial <= since)
+                continue;
+            if (count < max) {
+                rec = &records[count];
+                rec->type = ION_TRACK_MAP;
+                rec->buffer = map->buffer;
+                rec->addr = map->addr;
+                rec->len = map->len;
+                /* heap of the mapped buffer if it was allocated here */
+                rec->heap_mask = 0;
+                if ((map->buffer >= 0) && (map->buffer < ION_STATS_MAX_FDS) &&
+                        track_allocs[map->buffer].serial)
+                    rec->heap_mask = track_allocs[map->buffer].heap_mask;
+                rec->age_ns = now - map->time;
+                rec->tag = map->tag;
+                rec->serial = map->serial;
+                rec->prefaulted = map->prefaulted;
+            }
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&track_lock);
+
+    return count;
+}
+
+/* Totals of the records of one tag and type, for the dump summary */
+struct ion_track_total {
+    const char *tag;
+    unsigned int type;
+    unsigned long count;
+    size_t bytes;
+};
+
+#define ION_TRACK_DUMP_TOTALS   32
+
+int ion_track_dump(char *buf, size_t len, unsigned long since)
+{
+    struct ion_track_total totals[ION_TRACK_DUMP_TOTALS];
+    struct ion_track_record *records;
+    unsigned int nr_totals = 0, t;
+    size_t pos = 0;
+    int count, alloc, i;
+
+    if (!buf || !len)
+        return 0;
+    buf[0] = '\0';
+
+    if (!track_enabled)
+        return 0;
+
+    alloc = ion_track_get(NULL, 0, since) + 1;
+    records = (struct ion_track_record *)malloc(alloc * sizeof(*records));
+    if (!records)
+        return 0;
+    /*
+     * More records may have appeared meanwhile. ion_track_get() counts them
+     * all but only stores alloc of them, the extra ones are dropped.
+     */
+    count = ion_track_get(records, alloc, since);
+    if (count > alloc)
+        count = alloc;
+
+    for (i = 0; i < count; i++) {
+        for (t = 0; t < nr_totals; t++) {
+            if ((totals[t].tag == records[i].tag) &&
+                    (totals[t].type == records[i].type))
+                break;
+        }
+        if (t == nr_totals) {
+            if (nr_totals == ION_TRACK_DUMP_TOTALS)
+                continue;
+            totals[t].tag = records[i].tag;
+            totals[t].type = records[i].type;
+            totals[t].count = 0;
+            totals[t].bytes = 0;
+            nr_totals++;
+        }
+        totals[t].count++;
+        totals[t].bytes += records[i].len;
+    }
+
+#define ION_TRACK_APPEND(...)                                           \
+    do {                                                                \
+        pos += snprintf(buf + pos, len - pos, __VA_ARGS__);             \
+        if (pos >= len) {                                               \
+            free(records);                                              \
+            return len - 1;                                             \
+        }                                                               \
+    } while (0)
+
+    ION_TRACK_APPEND("ION live buffers since #%lu:\n", since);
+    for (t = 0; t < nr_totals; t++)
+        ION_TRACK_APPEND("  %-16s %-5s count %lu bytes %zu\n",
+                         totals[t].tag ? totals[t].tag : "-",
+                         (totals[t].type == ION_TRACK_ALLOC) ? "alloc" : "map",
+                         totals[t].count, totals[t].bytes);
+
+    for (i = 0; i < count; i++) {
+        if (records[i].type == ION_TRACK_ALLOC)
+            ION_TRACK_APPEND("  #%lu alloc fd %d len %zu heap 0x%x age %lldms %s\n",
+                             records[i].serial, records[i].buffer,
+                             records[i].len, records[i].heap_mask,
+                             records[i].age_ns / 1000000,
+                             records[i].tag ? records[i].tag : "-");
+        else
+            ION_TRACK_APPEND("  #%lu map %p fd %d len %zu heap 0x%x age %lldms prefaulted %lu %s\n",
+                             records[i].serial, records[i].addr,
+                             records[i].buffer, records[i].len,
+                             records[i].heap_mask, records[i].age_ns / 1000000,
+                             records[i].prefaulted,
+                             records[i].tag ? records[i].tag : "-");
+    }
+
+#undef ION_TRACK_APPEND
+
+    free(records);
+
+    return pos;
+}
@@ -14,68 +14,230 @@
  * limitations under the License.
  */
 
-#include <ion.h>
+#include "ion_priv.h"
+#include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
+#include <sys/resource.h>
 #include <cutils/log.h>
 
-typedef unsigned long ion_handle;
+static int ion_kernel_open(void)
+{
+    return open("/dev/ion", O_RDWR);
+}
 
-struct ion_allocation_data {
-    size_t len;
-    size_t align;
-    unsigned int heap_mask;
-    unsigned int flags;
-    ion_handle handle;
-};
+static void ion_kernel_close(int client)
+{
+    close(client);
+}
 
-struct ion_fd_data {
-    ion_handle handle;
-    int fd;
-};
+static int ion_kernel_ioctl(int client, unsigned long request, void *arg)
+{
+    return ioctl(client, request, arg);
+}
 
-struct ion_handle_data {
-    ion_handle handle;
+const struct ion_backend ion_kernel_backend = {
+    "kernel",
+    ion_kernel_open,
+    ion_kernel_close,
+    ion_kernel_ioctl,
 };
 
-struct ion_custom_data {
-    unsigned int cmd;
-    unsigned long arg;
-};
+static const struct ion_backend *ion_backend;
+static pthread_once_t ion_backend_once = PTHREAD_ONCE_INIT;
 
-#define ION_IOC_MAGIC   'I'
-#define ION_IOC_ALLOC   _IOWR(ION_IOC_MAGIC, 0, struct ion_allocation_data)
-#define ION_IOC_FREE    _IOWR(ION_IOC_MAGIC, 1, struct ion_handle_data)
-#define ION_IOC_MAP     _IOWR(ION_IOC_MAGIC, 2, struct ion_fd_data)
-#define ION_IOC_SHARE   _IOWR(ION_IOC_MAGIC, 4, struct ion_fd_data)
-#define ION_IOC_IMPORT  _IOWR(ION_IOC_MAGIC, 5, struct ion_fd_data)
-#define ION_IOC_CUSTOM  _IOWR(ION_IOC_MAGIC, 6, struct ion_custom_data)
-#define ION_IOC_SYNC	_IOWR(ION_IOC_MAGIC, 7, struct ion_fd_data)
-
-struct ion_msync_data {
-    long flags;
-    ion_buffer buf;
-    size_t size;
-    off_t offset;
-};
+/*
+ * The ION_EXYNOS_BACKEND environment variable selects the memfd emulation,
+ * ION_EXYNOS_TRACK=1 turns on lifetime tracking from the first call.
+ */
+static void ion_init_backend(void)
+{
+    const char *name = getenv("ION_EXYNOS_BACKEND");
+    const char *track = getenv("ION_EXYNOS_TRACK");
+
+    if (track && !strcmp(track, "1"))
+        ion_track_enable(1);
+
+    if (ion_backend)
+        return;
+
+    if (name && !strcmp(name, ion_memfd_backend.name))
+        ion_backend = &ion_memfd_backend;
+    else
+        ion_backend = &ion_kernel_backend;
 
-enum ION_EXYNOS_CUSTOM_CMD {
-    ION_EXYNOS_CUSTOM_MSYNC
+    if (ion_backend != &ion_kernel_backend)
+        ALOGI("libion_exynos: using the %s backend", ion_backend->name);
+}
+
+const struct ion_backend *ion_get_backend(void)
+{
+    pthread_once(&ion_backend_once, ion_init_backend);
+    return ion_backend;
+}
+
+static inline int ion_ioctl(int client, unsigned long request, void *arg)
+{
+    return ion_get_backend()->ioctl(client, request, arg);
+}
+
+enum ion_abi {
+    ION_ABI_UNKNOWN,
+    ION_ABI_LEGACY,     /* ALLOC returns a handle, SHARE turns it into an fd */
+    ION_ABI_FD_ALLOC,   /* ALLOC returns a dma-buf fd directly */
 };
 
+static volatile int ion_abi = ION_ABI_UNKNOWN;
+/*
+ * Set once the kernel rejected the custom MSYNC with ENOTTY. Like the ABI,
+ * that is a property of the kernel, so later calls skip the ioctl.
+ */
+static volatile int ion_no_msync;
+
+/*
+ * Kernels without handles have no ION_IOC_FREE and reject it with ENOTTY,
+ * legacy kernels fail it with EINVAL for handle 0. The ABI is a property of
+ * the kernel, so it is probed once for the whole process.
+ */
+static int ion_detect_abi(ion_client client)
+{
+    struct ion_handle_data arg_free;
+
+    if (ion_abi != ION_ABI_UNKNOWN)
+        return ion_abi;
+
+    arg_free.handle = 0;
+    if ((ion_ioctl(client, ION_IOC_FREE, &arg_free) < 0) && (errno == ENOTTY))
+        ion_abi = ION_ABI_FD_ALLOC;
+    else
+        ion_abi = ION_ABI_LEGACY;
+
+    return ion_abi;
+}
+
+/*
+ * Many users treat fd 0 as "no buffer", so a buffer must never be fd 0. That
+ * happens when stdin is closed; move such an fd to the lowest free fd above 0.
+ * Buffer fds are close-on-exec, and so is the moved one.
+ */
+static int ion_avoid_fd0(int fd)
+{
+    int new_fd;
+
+    if (fd != 0)
+        return fd;
+
+    new_fd = fcntl(fd, F_DUPFD_CLOEXEC, 1);
+    close(fd);
+
+    return new_fd;
+}
+
+/*
+ * The process-wide client handed out by ion_client_create(). It is opened by
+ * the first caller and closed when the last reference is dropped.
+ */
+static pthread_mutex_t shared_client_lock = PTHREAD_MUTEX_INITIALIZER;
+static ion_client shared_client = -1;
+static unsigned int shared_client_refs;
+
 ion_client ion_client_create(void)
 {
-    return open("/dev/ion", O_RDWR);
+    ion_client client;
+
+    pthread_mutex_lock(&shared_client_lock);
+    if (shared_client_refs == 0) {
+        shared_client = ion_get_backend()->open();
+        if (shared_client < 0) {
+            client = shared_client;
+            pthread_mutex_unlock(&shared_client_lock);
+            return client;
+        }
+        ion_detect_abi(shared_client);
+    }
+    shared_client_refs++;
+    client = shared_client;
+    pthread_mutex_unlock(&shared_client_lock);
+
+    return client;
+}
+
+ion_client ion_client_create_private(void)
+{
+    ion_client client = ion_get_backend()->open();
+
+    if (client >= 0)
+        ion_detect_abi(client);
+
+    return client;
 }
 
 void ion_client_destroy(ion_client client)
 {
-    close(client);
+    pthread_mutex_lock(&shared_client_lock);
+    if (shared_client_refs && (client == shared_client)) {
+        if (--shared_client_refs == 0) {
+            ion_get_backend()->close(shared_client);
+            shared_client = -1;
+        }
+        pthread_mutex_unlock(&shared_client_lock);
+        return;
+    }
+    pthread_mutex_unlock(&shared_client_lock);
+
+    ion_get_backend()->close(client);
 }
 
-ion_buffer ion_alloc(ion_client client, size_t len, size_t align,
-                     unsigned int heap_mask, unsigned int flags)
+int ion_select_backend(const char *name)
+{
+    const struct ion_backend *backend;
+    int ret = 0;
+
+    if (!strcmp(name, ion_kernel_backend.name))
+        backend = &ion_kernel_backend;
+    else if (!strcmp(name, ion_memfd_backend.name))
+        backend = &ion_memfd_backend;
+    else
+        return -1;
+
+    pthread_mutex_lock(&shared_client_lock);
+    if (shared_client_refs) {
+        ret = -1;
+    } else {
+        ion_backend = backend;
+        ion_abi = ION_ABI_UNKNOWN;
+        ion_no_msync = 0;
+    }
+    pthread_mutex_unlock(&shared_client_lock);
+
+    return ret;
+}
+
+static ion_buffer ion_alloc_fd(ion_client client, size_t len,
+                               unsigned int heap_mask, unsigned int flags)
+{
+    int ret;
+    struct ion_fd_allocation_data arg_alloc;
+
+    arg_alloc.len = len;
+    arg_alloc.heap_id_mask = heap_mask;
+    arg_alloc.flags = flags;
+    arg_alloc.fd = 0;
+    arg_alloc.unused = 0;
+
+    ret = ion_ioctl(client, ION_IOC_FD_ALLOC, &arg_alloc);
+    if (ret < 0)
+        return ret;
+
+    return ion_avoid_fd0(arg_alloc.fd);
+}
+
+static ion_buffer ion_alloc_legacy(ion_client client, size_t len, size_t align,
+                                   unsigned int heap_mask, unsigned int flags)
 {
     int ret;
     struct ion_handle_data arg_free;
@@ -87,43 +249,147 @@ ion_buffer ion_alloc(ion_client client, size_t len, size_t align,
     arg_alloc.heap_mask = heap_mask;
     arg_alloc.flags = flags;
 
-    ret = ioctl(client, ION_IOC_ALLOC, &arg_alloc);
+    ret = ion_ioctl(client, ION_IOC_ALLOC, &arg_alloc);
     if (ret < 0)
         return ret;
 
     arg_share.handle = arg_alloc.handle;
-    ret = ioctl(client, ION_IOC_SHARE, &arg_share);
-
-    if ((ret >= 0) && (!arg_share.fd)) {
-        ret = ioctl(client, ION_IOC_SHARE, &arg_share);
-        if (ret >= 0)
-            close(0);
-        else
-            ret = 0;
-    }
+    ret = ion_ioctl(client, ION_IOC_SHARE, &arg_share);
 
     arg_free.handle = arg_alloc.handle;
-    ioctl(client, ION_IOC_FREE, &arg_free);
+    ion_ioctl(client, ION_IOC_FREE, &arg_free);
 
     if (ret < 0)
         return ret;
 
-    return arg_share.fd;
+    return ion_avoid_fd0(arg_share.fd);
+}
+
+ion_buffer ion_alloc(ion_client client, size_t len, size_t align,
+                     unsigned int heap_mask, unsigned int flags)
+{
+    ion_buffer buffer;
+    long long start = ion_stats_now();
+
+    /* the fd ABI has no alignment argument, buffers are page aligned */
+    if (ion_detect_abi(client) == ION_ABI_FD_ALLOC)
+        buffer = ion_alloc_fd(client, len, heap_mask, flags);
+    else
+        buffer = ion_alloc_legacy(client, len, align, heap_mask, flags);
+
+    ion_stats_alloc(heap_mask, len, buffer, ion_stats_now() - start);
+    ion_track_alloc(buffer, len, heap_mask);
+
+    return buffer;
 }
 
 void ion_free(ion_buffer buffer)
 {
+    ion_stats_free(buffer);
+    ion_track_free(buffer);
     close(buffer);
 }
 
 void *ion_map(ion_buffer buffer, size_t len, off_t offset)
 {
-    return mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED,
-                buffer, offset);
+    return ion_map_ext(buffer, len, offset, ION_MAP_READ | ION_MAP_WRITE);
+}
+
+/*
+ * Reserves an address range aligned to @align and maps @buffer over it, so
+ * that the kernel can use sections or large pages for a contiguous buffer.
+ */
+static void *ion_map_aligned(ion_buffer buffer, size_t len, off_t offset,
+                             int prot, int flags, size_t align)
+{
+    unsigned long base, aligned;
+    void *reserved, *addr;
+
+    reserved = mmap(NULL, len + align, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED)
+        return MAP_FAILED;
+
+    base = (unsigned long)reserved;
+    aligned = (base + align - 1) & ~(align - 1);
+
+    addr = mmap((void *)aligned, len, prot, flags | MAP_FIXED, buffer, offset);
+    if (addr == MAP_FAILED) {
+        munmap(reserved, len + align);
+        return MAP_FAILED;
+    }
+
+    if (aligned > base)
+        munmap(reserved, aligned - base);
+    if (base + align > aligned)
+        munmap((void *)(aligned + len), base + align - aligned);
+
+    return addr;
+}
+
+/* Minor faults taken by the calling thread so far */
+static unsigned long ion_map_faults(void)
+{
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_THREAD, &usage) < 0)
+        return 0;
+
+    return usage.ru_minflt;
+}
+
+void *ion_map_ext(ion_buffer buffer, size_t len, off_t offset,
+                  unsigned int map_flags)
+{
+    void *addr;
+    int prot = PROT_NONE;
+    int flags = MAP_SHARED;
+    size_t align = 0;
+    unsigned long faults = 0;
+    long long start = ion_stats_now();
+
+    if (map_flags & ION_MAP_READ)
+        prot |= PROT_READ;
+    if (map_flags & ION_MAP_WRITE)
+        prot |= PROT_WRITE;
+    if (map_flags & ION_MAP_PREFAULT)
+        flags |= MAP_POPULATE;
+
+    if (map_flags & ION_MAP_ALIGN_LARGE) {
+        if (len >= ION_MAP_SECTION_SIZE)
+            align = ION_MAP_SECTION_SIZE;
+        else if (len >= ION_MAP_LARGE_PAGE_SIZE)
+            align = ION_MAP_LARGE_PAGE_SIZE;
+    }
+
+    /*
+     * Heaps that map with remap_pfn_range() never fault, so the pages that
+     * MAP_POPULATE saves are counted as the faults it takes, not the length.
+     */
+    if (map_flags & ION_MAP_PREFAULT)
+        faults = ion_map_faults();
+
+    if (align)
+        addr = ion_map_aligned(buffer, len, offset, prot, flags, align);
+    else
+        addr = mmap(NULL, len, prot, flags, buffer, offset);
+
+    if (map_flags & ION_MAP_PREFAULT)
+        faults = ion_map_faults() - faults;
+
+    ion_stats_map(len, ion_stats_now() - start, addr == MAP_FAILED);
+    if (addr != MAP_FAILED) {
+        if (faults)
+            ion_stats_prefault(faults);
+        ion_track_map(addr, len, buffer, faults);
+    }
+
+    return addr;
 }
 
 int ion_unmap(void *addr, size_t len)
 {
+    ion_track_unmap(addr);
     return munmap(addr, len);
 }
 
@@ -133,7 +399,67 @@ int ion_sync(ion_client client, ion_buffer buffer)
 
     data.fd = buffer;
 
-    return ioctl(client, ION_IOC_SYNC, &data);
+    return ion_ioctl(client, ION_IOC_SYNC, &data);
+}
+
+int ion_msync(ion_client client, ion_buffer buffer, long flags,
+              size_t size, off_t offset)
+{
+    struct ion_msync_data arg_cdata;
+    struct ion_custom_data arg_custom;
+    int err;
+
+    if (!(flags & (IMSYNC_SYNC_FOR_DEV | IMSYNC_SYNC_FOR_CPU)))
+        return -EINVAL;
+
+    if (size == 0)
+        return 0;
+
+    if (ion_no_msync)
+        goto no_msync;
+
+    arg_cdata.flags = flags;
+    arg_cdata.buf = buffer;
+    arg_cdata.size = size;
+    arg_cdata.offset = offset;
+
+    arg_custom.cmd = ION_EXYNOS_CUSTOM_MSYNC;
+    arg_custom.arg = (unsigned long)&arg_cdata;
+
+    if (ion_ioctl(client, ION_IOC_CUSTOM, &arg_custom) < 0) {
+        err = errno;
+        /* EINVAL is a bad range or buffer, and is returned as is */
+        if (err != ENOTTY)
+            return -err;
+        ion_no_msync = 1;
+        goto no_msync;
+    }
+
+    return 0;
+
+no_msync:
+    /* no range sync in this kernel, clean the whole buffer instead */
+    if (!(flags & IMSYNC_SYNC_FOR_DEV))
+        return -ENOTTY;
+    if (ion_sync(client, buffer) < 0)
+        return -errno;
+
+    return 0;
+}
+
+int ion_msync_rect(ion_client client, ion_buffer buffer, long flags,
+                   off_t offset, size_t stride,
+                   size_t x, size_t y, size_t w, size_t h)
+{
+    if ((w == 0) || (h == 0))
+        return 0;
+
+    if (x + w > stride)
+        return -EINVAL;
+
+    /* from the first dirty byte of line @y to the last of line @y + @h - 1 */
+    return ion_msync(client, buffer, flags,
+                     (h - 1) * stride + w, offset + y * stride + x);
 }
 
 int ion_incRef(int fd, int share_fd, unsigned long **handle)
@@ -142,7 +468,7 @@ int ion_incRef(int fd, int share_fd, unsigned long **handle)
 
     data.fd = share_fd;
 
-    int ret = ioctl(fd, ION_IOC_IMPORT, &data);
+    int ret = ion_ioctl(fd, ION_IOC_IMPORT, &data);
     if (ret < 0)
         return ret;
 
@@ -155,5 +481,5 @@ int ion_decRef(int fd, unsigned long *handle)
     struct ion_handle_data data;
     data.handle = (ion_handle)handle;
 
-    return ioctl(fd, ION_IOC_FREE, &data);
+    return ion_ioctl(fd, ION_IOC_FREE, &data);
 }
@@ -20,7 +20,7 @@ include $(CLEAR_VARS)
 
 LOCAL_MODULE_RELATIVE_PATH := hw
 LOCAL_C_INCLUDES += hardware/libhardware/include
-LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_SHARED_LIBRARIES := liblog libcutils
 LOCAL_SRC_FILES := memtrack_exynos5.c ion.c
 LOCAL_MODULE := memtrack.exynos5
 
@@ -30,3 +30,18 @@ LOCAL_SRC_FILES += mali.c
 endif
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_C_INCLUDES += hardware/libhardware/include
+LOCAL_SHARED_LIBRARIES := liblog libcutils
+LOCAL_SRC_FILES := memtrack_exynos5.c ion.c memtrack_test.c
+LOCAL_MODULE := memtrack_test
+LOCAL_MODULE_TAGS := optional
+
+ifneq ($(TARGET_SOC),exynos5410)
+LOCAL_CFLAGS += -DTRACK_MALI_MEMORY
+LOCAL_SRC_FILES += mali.c
+endif
+
+include $(BUILD_EXECUTABLE)
@@ -14,77 +14,384 @@
  * limitations under the License.
  */
 
+#include <dirent.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
-#include <sys/mman.h>
 
 #include <hardware/memtrack.h>
 
 #include "memtrack_exynos5.h"
 
-int ion_memtrack_get_memory(pid_t pid,
-                            int type,
-                            struct memtrack_record *records,
-                            size_t *num_records)
+/* Below memtrack_debugfs */
+#define ION_DEBUGFS_CLIENTS     "ion/clients"
+#define ION_DEBUGFS             "ion"
+
+/* The clients directory is scanned again at most this often */
+#define ION_SCAN_INTERVAL_NS    (1000 * 1000000LL)
+/* Initial size of the client table, it grows as needed */
+#define ION_MIN_CLIENTS         64
+
+#define ARRAY_SIZE(x) (sizeof(x)/sizeof(x[0]))
+#define min(x, y) ((x) < (y) ? (x) : (y))
+
+/*
+ * Heap names as printed by the kernel, truncated to 16 characters. Buffers
+ * of the page based heaps belong to the process that allocated them. The
+ * Exynos contiguous heap holds the reserved video, MFC and GSC regions whose
+ * buffers are passed between the media server, the compositor and apps.
+ * Kernels that register the regions as heaps of their own print them by
+ * region name, which attributes codec and camera memory.
+ * Heaps that are not listed are accounted as ION_HEAP_CLASS_SYSTEM.
+ */
+static const struct {
+    const char *name;
+    int heap_class;
+} ion_heaps[] = {
+    { "ion_noncontig_he", ION_HEAP_CLASS_SYSTEM },
+    { "exynos_heap",      ION_HEAP_CLASS_SYSTEM },
+    { "ion_contig_heap",  ION_HEAP_CLASS_CONTIG },
+    { "exynos_contig_he", ION_HEAP_CLASS_EXYNOS_CONTIG },
+    { "mfc_output",       ION_HEAP_CLASS_MFC },
+    { "mfc_input",        ION_HEAP_CLASS_MFC },
+    { "mfc_fw",           ION_HEAP_CLASS_MFC },
+    { "video",            ION_HEAP_CLASS_MFC },
+    { "gsc",              ION_HEAP_CLASS_GSC },
+};
+
+static const struct memtrack_record ion_record_templates[] = {
+    [ION_HEAP_CLASS_SYSTEM] = {
+        .flags = MEMTRACK_FLAG_PRIVATE | MEMTRACK_FLAG_NONSECURE,
+    },
+    [ION_HEAP_CLASS_CONTIG] = {
+        .flags = MEMTRACK_FLAG_PRIVATE | MEMTRACK_FLAG_NONSECURE,
+    },
+    [ION_HEAP_CLASS_EXYNOS_CONTIG] = {
+        .flags = MEMTRACK_FLAG_SHARED | MEMTRACK_FLAG_NONSECURE,
+    },
+    [ION_HEAP_CLASS_MFC] = {
+        .flags = MEMTRACK_FLAG_SHARED | MEMTRACK_FLAG_NONSECURE,
+    },
+    [ION_HEAP_CLASS_GSC] = {
+        .flags = MEMTRACK_FLAG_SHARED | MEMTRACK_FLAG_NONSECURE,
+    },
+};
+
+/* Heap classes reported for each memtrack type */
+static const struct {
+    int first;
+    size_t count;
+} ion_type_classes[MEMTRACK_NUM_TYPES] = {
+    [MEMTRACK_TYPE_GRAPHICS] = { ION_HEAP_CLASS_SYSTEM, 3 },
+    [MEMTRACK_TYPE_MULTIMEDIA] = { ION_HEAP_CLASS_MFC, 1 },
+    [MEMTRACK_TYPE_CAMERA] = { ION_HEAP_CLASS_GSC, 1 },
+};
+
+/* One <pid>-<serial> file of the clients directory */
+struct ion_client_entry {
+    pid_t pid;
+    unsigned int serial;
+};
+
+/* Kernels with a clients/ directory name the files <pid>-<n>, older <pid> */
+static int ion_has_clients_dir;
+static pthread_once_t ion_layout_once = PTHREAD_ONCE_INIT;
+
+static pthread_mutex_t ion_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ion_client_entry *ion_clients;
+static size_t ion_num_clients;
+static size_t ion_max_clients;
+static long long ion_scan_expires;
+
+/*
+ * The types of one pid are queried back to back, so the sums of the last
+ * pid are kept until the next scan and serve all of them.
+ */
+static pid_t ion_last_pid = -1;
+static unsigned long ion_last_sizes[ION_NUM_HEAP_CLASSES];
+static long long ion_last_expires;
+
+static void ion_resolve_layout(void)
 {
+    char path[MEMTRACK_PATH_MAX];
     struct stat sb;
-    const char *ion_path = "/sys/kernel/debug/ion/clients";
-    const char *fmt = "%s/%d-0";
-    char ion_file[64] = { 0 };
-    FILE *fp;
-    int cmp;
-    int rc;
-    char line[1024];
-    int result;
 
-    if (*num_records == 0) {
-        return -EINVAL;
+    snprintf(path, sizeof(path), "%s/" ION_DEBUGFS_CLIENTS, memtrack_debugfs);
+    ion_has_clients_dir = lstat(path, &sb) == 0;
+}
+
+void ion_memtrack_init(void)
+{
+    pthread_once(&ion_layout_once, ion_resolve_layout);
+}
+
+/* Forgets the layout, the scan and the last sums, for a new debugfs root */
+void ion_memtrack_reset(void)
+{
+    pthread_mutex_lock(&ion_lock);
+    ion_memtrack_init();
+    ion_resolve_layout();
+    ion_num_clients = 0;
+    ion_scan_expires = 0;
+    ion_last_pid = -1;
+    ion_last_expires = 0;
+    pthread_mutex_unlock(&ion_lock);
+}
+
+static long long ion_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int ion_client_cmp(const void *a, const void *b)
+{
+    const struct ion_client_entry *ca = a;
+    const struct ion_client_entry *cb = b;
+
+    if (ca->pid != cb->pid) {
+        return (ca->pid > cb->pid) - (ca->pid < cb->pid);
+    }
+
+    return (ca->serial > cb->serial) - (ca->serial < cb->serial);
+}
+
+/* Makes room for one more client. Must be called with ion_lock held */
+static int ion_grow_clients(void)
+{
+    struct ion_client_entry *clients;
+    size_t max;
+
+    if (ion_num_clients < ion_max_clients) {
+        return 0;
     }
 
-    rc = lstat(ion_path, &sb);
-    if (rc != 0) {
-        ion_path = "/sys/kernel/debug/ion/";
-        fmt = "%s/%d";
+    max = ion_max_clients ? ion_max_clients * 2 : ION_MIN_CLIENTS;
+    clients = realloc(ion_clients, sizeof(*clients) * max);
+    if (clients == NULL) {
+        return -ENOMEM;
     }
+    ion_clients = clients;
+    ion_max_clients = max;
 
-    snprintf(ion_file, sizeof(ion_file), fmt, ion_path, pid);
+    return 0;
+}
 
-    fp = fopen(ion_file, "r");
-    if (fp == NULL) {
+/*
+ * A process has one client per ion_client_create() that is still open, and
+ * the serials are reused, so they are not contiguous. The directory is
+ * scanned into a table sorted by pid, which holds every client: readdir()
+ * returns them in no particular order, so a cut off table would lose
+ * arbitrary pids. Must be called with ion_lock held.
+ */
+static int ion_refresh_clients(void)
+{
+    char path[MEMTRACK_PATH_MAX];
+    struct dirent *de;
+    DIR *dp;
+    long long now = ion_now();
+    unsigned long pid, serial;
+    const char *p;
+
+    if (ion_scan_expires > now) {
+        return 0;
+    }
+
+    snprintf(path, sizeof(path), "%s/" ION_DEBUGFS_CLIENTS, memtrack_debugfs);
+    dp = opendir(path);
+    if (dp == NULL) {
         return -errno;
     }
 
-    *num_records = 1;
+    ion_num_clients = 0;
+    for (de = readdir(dp); de != NULL; de = readdir(dp)) {
+        p = memtrack_parse_ulong(de->d_name, &pid);
+        if (p == NULL || *p != '-') {
+            continue;
+        }
+        p = memtrack_parse_ulong(p + 1, &serial);
+        if (p == NULL || *p != '\0') {
+            continue;
+        }
+        if (ion_grow_clients() < 0) {
+            /* no partial table, the next query scans again */
+            closedir(dp);
+            ion_num_clients = 0;
+            ion_scan_expires = 0;
+            return -ENOMEM;
+        }
+
+        ion_clients[ion_num_clients].pid = pid;
+        ion_clients[ion_num_clients].serial = serial;
+        ion_num_clients++;
+    }
+    closedir(dp);
 
-    for(;;) {
-        unsigned int x;
+    qsort(ion_clients, ion_num_clients, sizeof(ion_clients[0]), ion_client_cmp);
+    ion_scan_expires = now + ION_SCAN_INTERVAL_NS;
 
-        if (fgets(line, sizeof(line), fp) == NULL) {
-            break;
+    return 0;
+}
+
+/* Kernels that do not truncate the names print them in full */
+static int ion_heap_class(const char *name, size_t len)
+{
+    size_t i, n;
+
+    for (i = 0; i < ARRAY_SIZE(ion_heaps); i++) {
+        n = strlen(ion_heaps[i].name);
+        if (len >= n && strncmp(name, ion_heaps[i].name, n) == 0) {
+            return ion_heaps[i].heap_class;
         }
+    }
+
+    return ION_HEAP_CLASS_SYSTEM;
+}
+
+/* Adds the per-heap totals of one client file to @sizes */
+static int ion_parse_client(const char *path,
+                            unsigned long sizes[ION_NUM_HEAP_CLASSES])
+{
+    char buf[MEMTRACK_FILE_SIZE];
+    const char *p, *name, *q;
+    unsigned long x;
+    int rc;
 
+    rc = memtrack_read_file(path, buf, sizeof(buf));
+    if (rc < 0) {
+        return rc;
+    }
+
+    for (p = buf; *p != '\0'; p = memtrack_next_line(p)) {
         /* Format:
+         *        heap_name:    size_in_bytes
          * ion_noncontig_he:         19304448
          */
-        cmp = strncmp(line, "ion_noncontig_he", 16);
-        if (cmp != 0) {
+        name = memtrack_skip_spaces(p);
+        for (q = name; *q != '\0' && *q != ':' && *q != '\n'; q++)
+            ;
+        if (*q != ':') {
             continue;
         }
 
-        rc = sscanf(line, "%*s %u", &x);
-        if (rc != 1) {
-            break;
+        /* the header line has no number and is skipped here */
+        if (memtrack_parse_ulong(memtrack_skip_spaces(q + 1), &x) == NULL) {
+            continue;
+        }
+
+        sizes[ion_heap_class(name, q - name)] += x;
+    }
+
+    return 0;
+}
+
+int ion_memtrack_get_heaps(pid_t pid,
+                           unsigned long sizes[ION_NUM_HEAP_CLASSES])
+{
+    char ion_file[MEMTRACK_PATH_MAX];
+    struct ion_client_entry key = { pid, 0 };
+    const struct ion_client_entry *entry, *end;
+    size_t lo, hi, mid;
+    int found = 0;
+    int rc;
+
+    memset(sizes, 0, sizeof(unsigned long) * ION_NUM_HEAP_CLASSES);
+
+    ion_memtrack_init();
+
+    if (!ion_has_clients_dir) {
+        snprintf(ion_file, sizeof(ion_file), "%s/" ION_DEBUGFS "/%d",
+                 memtrack_debugfs, pid);
+        return ion_parse_client(ion_file, sizes);
+    }
+
+    pthread_mutex_lock(&ion_lock);
+    rc = ion_refresh_clients();
+    if (rc < 0) {
+        pthread_mutex_unlock(&ion_lock);
+        return rc;
+    }
+
+    if (pid == ion_last_pid && ion_last_expires == ion_scan_expires) {
+        memcpy(sizes, ion_last_sizes, sizeof(ion_last_sizes));
+        pthread_mutex_unlock(&ion_lock);
+        return 0;
+    }
+
+    lo = 0;
+    hi = ion_num_clients;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (ion_client_cmp(&ion_clients[mid], &key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    end = ion_clients + ion_num_clients;
+    for (entry = ion_clients + lo; entry < end && entry->pid == pid; entry++) {
+        snprintf(ion_file, sizeof(ion_file), "%s/" ION_DEBUGFS_CLIENTS "/%d-%u",
+                 memtrack_debugfs, pid, entry->serial);
+        /* a client closed since the last scan is simply not counted */
+        if (ion_parse_client(ion_file, sizes) == 0) {
+            found = 1;
         }
+    }
 
-        records[0].flags = MEMTRACK_FLAG_PRIVATE|MEMTRACK_FLAG_NONSECURE;
-        records[0].size_in_bytes = x;
+    if (found) {
+        ion_last_pid = pid;
+        ion_last_expires = ion_scan_expires;
+        memcpy(ion_last_sizes, sizes, sizeof(ion_last_sizes));
     }
+    pthread_mutex_unlock(&ion_lock);
+
+    return found ? 0 : -ENOENT;
+}
 
-    fclose(fp);
+int ion_memtrack_get_memory(pid_t pid,
+                            int type,
+                            struct memtrack_record *records,
+                            size_t *num_records)
+{
+    unsigned long sizes[ION_NUM_HEAP_CLASSES];
+    size_t allocated_records;
+    size_t first, count, i;
+    int rc;
+
+    if (type < 0 || type >= MEMTRACK_NUM_TYPES ||
+        ion_type_classes[type].count == 0) {
+        return -EINVAL;
+    }
+
+    first = ion_type_classes[type].first;
+    count = ion_type_classes[type].count;
+    allocated_records = min(*num_records, count);
+    *num_records = count;
+
+    /* fastpath to return the necessary number of records */
+    if (allocated_records == 0) {
+        return 0;
+    }
+
+    rc = ion_memtrack_get_heaps(pid, sizes);
+    if (rc < 0) {
+        return rc;
+    }
+
+    memcpy(records, &ion_record_templates[first],
+           sizeof(struct memtrack_record) * allocated_records);
+    for (i = 0; i < allocated_records; i++) {
+        records[i].size_in_bytes = sizes[first + i];
+    }
 
     return 0;
 }
@@ -15,8 +15,11 @@
  */
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <sys/types.h>
 #include <dirent.h>
 #include <sys/mman.h>
@@ -28,6 +31,15 @@
 /* Set a 512 MB limit */
 #define MAX_MEMTRACK_SIZE 0x20000000
 
+/* Below memtrack_debugfs */
+#define MALI_MEM_PATH "mali/mem"
+
+/* The directory is scanned again at most this often */
+#define MALI_SCAN_INTERVAL_NS (1000 * 1000000LL)
+/* Initial size of the context table, it grows as needed */
+#define MALI_MIN_ENTRIES 64
+#define MALI_MAX_TOKENS 8
+
 #define ARRAY_SIZE(x) (sizeof(x)/sizeof(x[0]))
 #define min(x, y) ((x) < (y) ? (x) : (y))
 
@@ -44,103 +56,318 @@ struct memtrack_record record_templates[] = {
     },
 };
 
-int mali_memtrack_get_memory(pid_t pid, int type,
-                             struct memtrack_record *records,
-                             size_t *num_records)
+/*
+ * One file of the Mali debugfs memory directory. The files are named after
+ * the pid that owns the GPU context, optionally followed by a context
+ * suffix, so a pid may own several of them.
+ */
+struct mali_entry {
+    pid_t pid;
+    char name[16];
+};
+
+static pthread_mutex_t mali_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct mali_entry *mali_entries;
+static size_t mali_num_entries;
+static size_t mali_max_entries;
+static long long mali_scan_expires;
+
+static long long mali_now(void)
 {
-    size_t allocated_records = min(*num_records, ARRAY_SIZE(record_templates));
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int mali_entry_cmp(const void *a, const void *b)
+{
+    pid_t pa = ((const struct mali_entry *)a)->pid;
+    pid_t pb = ((const struct mali_entry *)b)->pid;
+
+    return (pa > pb) - (pa < pb);
+}
+
+/* Makes room for one more entry. Must be called with mali_lock held */
+static int mali_grow(void)
+{
+    struct mali_entry *entries;
+    size_t max;
+
+    if (mali_num_entries < mali_max_entries) {
+        return 0;
+    }
+
+    max = mali_max_entries ? mali_max_entries * 2 : MALI_MIN_ENTRIES;
+    entries = realloc(mali_entries, sizeof(*entries) * max);
+    if (entries == NULL) {
+        return -ENOMEM;
+    }
+    mali_entries = entries;
+    mali_max_entries = max;
+
+    return 0;
+}
+
+/*
+ * readdir() returns the contexts in no particular order, so the table
+ * holds all of them; a cut off table would lose arbitrary pids. Must be
+ * called with mali_lock held.
+ */
+static int mali_refresh(void)
+{
+    char path[MEMTRACK_PATH_MAX];
     struct dirent *de;
     DIR *dp;
-    FILE *fp;
-    char pid_str[8];
-    char mali_file[32];
-    char line[1024];
-    int len;
-    int total = 0;
-    int native_buffer = 0;
-
-    *num_records = ARRAY_SIZE(record_templates);
+    long long now = mali_now();
+    unsigned long pid;
+    const char *end;
 
-    /* fastpath to return the necessary number of records */
-    if (allocated_records == 0) {
+    if (mali_scan_expires > now) {
         return 0;
     }
 
-    dp = opendir("/d/mali/mem/");
+    snprintf(path, sizeof(path), "%s/" MALI_MEM_PATH, memtrack_debugfs);
+    dp = opendir(path);
     if (dp == NULL) {
         return -errno;
     }
 
-    len = snprintf(pid_str, sizeof(pid_str), "%d", pid);
-    if (len <= 0) {
-        closedir(dp);
-        return -EINVAL;
-    }
-
+    mali_num_entries = 0;
     for (de = readdir(dp); de != NULL; de = readdir(dp)) {
-        if (strncmp(de->d_name, pid_str, len) != 0) {
+        end = memtrack_parse_ulong(de->d_name, &pid);
+        if (end == NULL || (*end != '\0' && *end != '_') ||
+            strlen(de->d_name) >= sizeof(mali_entries[0].name)) {
             continue;
         }
+        if (mali_grow() < 0) {
+            /* no partial table, the next query scans again */
+            closedir(dp);
+            mali_num_entries = 0;
+            mali_scan_expires = 0;
+            return -ENOMEM;
+        }
 
-        snprintf(mali_file, sizeof(mali_file), "/d/mali/mem/%s", pid_str);
-        break;
+        mali_entries[mali_num_entries].pid = pid;
+        strcpy(mali_entries[mali_num_entries].name, de->d_name);
+        mali_num_entries++;
     }
     closedir(dp);
 
-    fp = fopen(mali_file, "r");
-    if (fp == NULL) {
-        return -errno;
+    qsort(mali_entries, mali_num_entries, sizeof(mali_entries[0]),
+          mali_entry_cmp);
+    mali_scan_expires = now + MALI_SCAN_INTERVAL_NS;
+
+    return 0;
+}
+
+/* Returns the first entry of @pid, or NULL. Must be called with mali_lock held */
+static const struct mali_entry *mali_find(pid_t pid)
+{
+    size_t lo = 0, hi = mali_num_entries, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (mali_entries[mid].pid < pid) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
 
-    memcpy(records, record_templates,
-           sizeof(struct memtrack_record) * allocated_records);
+    if (lo == mali_num_entries || mali_entries[lo].pid != pid) {
+        return NULL;
+    }
+
+    return &mali_entries[lo];
+}
+
+static int mali_is_number(const char *token)
+{
+    unsigned long v;
+    const char *end = memtrack_parse_ulong(token, &v);
+
+    return end != NULL && *end == '\0';
+}
+
+/*
+ * Adds the usage of one context file to @total and @native_buffer. Lines are
+ * split into whitespace separated tokens in place.
+ */
+static int mali_parse_file(const char *name, unsigned long *total,
+                           unsigned long *native_buffer)
+{
+    char path[MEMTRACK_PATH_MAX];
+    char buf[MEMTRACK_FILE_SIZE];
+    char *tokens[MALI_MAX_TOKENS];
+    char *p, *next;
+    unsigned long size;
+    int ntokens;
+    int rc;
 
-    while (1) {
-        int rc;
-        char label1[16] = { 0 };
-        char label2[16] = { 0 };
-        unsigned int size = 0;
+    snprintf(path, sizeof(path), "%s/" MALI_MEM_PATH "/%s", memtrack_debugfs,
+             name);
 
-        if (fgets(line, sizeof(line), fp) == NULL) {
-            break;
+    rc = memtrack_read_file(path, buf, sizeof(buf));
+    if (rc < 0) {
+        return rc;
+    }
+
+    for (p = buf; *p != '\0'; p = next) {
+        next = (char *)memtrack_next_line(p);
+        if (next > p && next[-1] == '\n') {
+            next[-1] = '\0';
+        }
+
+        ntokens = 0;
+        while (ntokens < MALI_MAX_TOKENS) {
+            p = (char *)memtrack_skip_spaces(p);
+            if (*p == '\0') {
+                break;
+            }
+            tokens[ntokens++] = p;
+            while (*p != '\0' && *p != ' ' && *p != '\t') {
+                p++;
+            }
+            if (*p != '\0') {
+                *p++ = '\0';
+            }
         }
 
         /* Format:
-         * TODO: list out format, use more descriptive names
+         * Total <label> <label> <size>
          */
-        rc = sscanf(line, "%s %*s %*s %u \n", label1, &size);
-        if (rc == 2) {
-            if (strcmp(label1, "Total") == 0) {
-                if (total + size > MAX_MEMTRACK_SIZE) {
+        if (ntokens >= 4 && mali_is_number(tokens[3])) {
+            if (strcmp(tokens[0], "Total") == 0) {
+                memtrack_parse_ulong(tokens[3], &size);
+                if (*total + size > MAX_MEMTRACK_SIZE) {
                     break;
                 }
-                total += size;
+                *total += size;
             }
             continue;
         }
 
         /* Format:
-         * TODO: list out format, use more descriptive names
+         * <label> Native Buffer <label> <label> <size>
          */
-        rc = sscanf(line, "%*s %s %s %*s %*s %u \n", label1, label2, &size);
-        if (rc == 3) {
-            if (strcmp(label1, "Native") == 0 &&
-                strcmp(label2, "Buffer") == 0) {
-                if (native_buffer + size > MAX_MEMTRACK_SIZE) {
-                    break;
-                }
-                native_buffer += size;
+        if (ntokens >= 6 && mali_is_number(tokens[5]) &&
+            strcmp(tokens[1], "Native") == 0 &&
+            strcmp(tokens[2], "Buffer") == 0) {
+            memtrack_parse_ulong(tokens[5], &size);
+            if (*native_buffer + size > MAX_MEMTRACK_SIZE) {
+                break;
             }
+            *native_buffer += size;
         }
     }
 
+    return 0;
+}
+
+/* Must be called with mali_lock held */
+static int mali_get_usage(pid_t pid, unsigned long *total,
+                          unsigned long *native_buffer)
+{
+    const struct mali_entry *entry = mali_find(pid);
+    const struct mali_entry *end = mali_entries + mali_num_entries;
+    int rc;
+
+    *total = 0;
+    *native_buffer = 0;
+
+    if (entry == NULL) {
+        return -ENOENT;
+    }
+
+    for (; entry < end && entry->pid == pid; entry++) {
+        rc = mali_parse_file(entry->name, total, native_buffer);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
+static void mali_fill_records(struct memtrack_record *records,
+                              size_t allocated_records,
+                              unsigned long total,
+                              unsigned long native_buffer)
+{
+    memcpy(records, record_templates,
+           sizeof(struct memtrack_record) * allocated_records);
+
     records[0].size_in_bytes = native_buffer;
 
     if (allocated_records == 2 && total >= native_buffer) {
         records[1].size_in_bytes = total - native_buffer;
     }
+}
+
+int mali_memtrack_get_memory(pid_t pid, int type,
+                             struct memtrack_record *records,
+                             size_t *num_records)
+{
+    size_t allocated_records = min(*num_records, ARRAY_SIZE(record_templates));
+    unsigned long total, native_buffer;
+    int rc;
+
+    *num_records = ARRAY_SIZE(record_templates);
+
+    /* fastpath to return the necessary number of records */
+    if (allocated_records == 0) {
+        return 0;
+    }
 
-    fclose(fp);
+    pthread_mutex_lock(&mali_lock);
+    rc = mali_refresh();
+    if (rc == 0) {
+        rc = mali_get_usage(pid, &total, &native_buffer);
+    }
+    pthread_mutex_unlock(&mali_lock);
+
+    if (rc < 0) {
+        return rc;
+    }
+
+    mali_fill_records(records, allocated_records, total, native_buffer);
+
+    return 0;
+}
+
+int mali_memtrack_get_memory_batch(const pid_t *pids, size_t count,
+                                   struct memtrack_record *records)
+{
+    unsigned long total, native_buffer;
+    size_t i;
+    int rc;
+
+    pthread_mutex_lock(&mali_lock);
+    rc = mali_refresh();
+    if (rc < 0) {
+        pthread_mutex_unlock(&mali_lock);
+        return rc;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (mali_get_usage(pids[i], &total, &native_buffer) < 0) {
+            total = 0;
+            native_buffer = 0;
+        }
+        mali_fill_records(records + i * MALI_MEMTRACK_RECORDS,
+                          MALI_MEMTRACK_RECORDS, total, native_buffer);
+    }
+    pthread_mutex_unlock(&mali_lock);
 
     return 0;
 }
+
+/* Forgets the scan, for a new debugfs root */
+void mali_memtrack_reset(void)
+{
+    pthread_mutex_lock(&mali_lock);
+    mali_num_entries = 0;
+    mali_scan_expires = 0;
+    pthread_mutex_unlock(&mali_lock);
+}
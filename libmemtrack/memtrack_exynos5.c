@@ -15,13 +15,151 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
+#include <cutils/properties.h>
 #include <hardware/memtrack.h>
 
 #include "memtrack_exynos5.h"
 
+#define min(x, y) ((x) < (y) ? (x) : (y))
+
+const char *memtrack_debugfs = "/sys/kernel/debug";
+
+/*
+ * Reads a whole debugfs file with a single read(). The result is always
+ * NUL terminated, a file larger than @size is truncated.
+ */
+int memtrack_read_file(const char *path, char *buf, size_t size)
+{
+    ssize_t len;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    len = read(fd, buf, size - 1);
+    if (len < 0) {
+        len = -errno;
+        close(fd);
+        return len;
+    }
+    close(fd);
+
+    buf[len] = '\0';
+
+    return len;
+}
+
+const char *memtrack_next_line(const char *p)
+{
+    while (*p != '\0' && *p != '\n') {
+        p++;
+    }
+
+    return *p == '\n' ? p + 1 : p;
+}
+
+const char *memtrack_skip_spaces(const char *p)
+{
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+
+    return p;
+}
+
+/* Returns the end of the number, or NULL if @p does not start with a digit */
+const char *memtrack_parse_ulong(const char *p, unsigned long *value)
+{
+    unsigned long v = 0;
+
+    if (*p < '0' || *p > '9') {
+        return NULL;
+    }
+
+    while (*p >= '0' && *p <= '9') {
+        v = v * 10 + (*p - '0');
+        p++;
+    }
+    *value = v;
+
+    return p;
+}
+
+/*
+ * dumpsys meminfo and the activity manager ask for every process every few
+ * seconds, often several times in a row for the same pid. Results, failures
+ * included, are kept per pid and type for memtrack_cache_ttl milliseconds.
+ */
+struct memtrack_cache_entry {
+    pid_t pid;
+    int type;
+    long long expires;
+    int rc;
+    size_t num_records;
+    struct memtrack_record records[MEMTRACK_CACHE_MAX_RECORDS];
+};
+
+static pthread_mutex_t memtrack_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct memtrack_cache_entry memtrack_cache[MEMTRACK_CACHE_ENTRIES];
+static long long memtrack_cache_ttl = MEMTRACK_CACHE_TTL_MS * 1000000LL;
+
+void memtrack_set_debugfs_root(const char *root)
+{
+    memtrack_debugfs = root;
+
+    pthread_mutex_lock(&memtrack_cache_lock);
+    memset(memtrack_cache, 0, sizeof(memtrack_cache));
+    pthread_mutex_unlock(&memtrack_cache_lock);
+
+    ion_memtrack_reset();
+    mali_memtrack_reset();
+}
+
+static long long memtrack_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int memtrack_query(pid_t pid, int type,
+                          struct memtrack_record *records,
+                          size_t *num_records)
+{
+    if (type == MEMTRACK_TYPE_GL) {
+        return mali_memtrack_get_memory(pid, type, records, num_records);
+    }
+
+    if (type == MEMTRACK_TYPE_GRAPHICS ||
+        type == MEMTRACK_TYPE_MULTIMEDIA ||
+        type == MEMTRACK_TYPE_CAMERA) {
+        return ion_memtrack_get_memory(pid, type, records, num_records);
+    }
+
+    return -EINVAL;
+}
+
 int exynos5_memtrack_init(const struct memtrack_module *module)
 {
+    char value[PROPERTY_VALUE_MAX];
+
+    /* ro.memtrack.cache_ttl_ms=0 disables caching */
+    if (property_get("ro.memtrack.cache_ttl_ms", value, NULL) > 0) {
+        memtrack_cache_ttl = atoll(value) * 1000000LL;
+    }
+
+    ion_memtrack_init();
+
     return 0;
 }
 
@@ -31,15 +169,38 @@ int exynos5_memtrack_get_memory(const struct memtrack_module *module,
                                 struct memtrack_record *records,
                                 size_t *num_records)
 {
-    if (type == MEMTRACK_TYPE_GL) {
-        return mali_memtrack_get_memory(pid, type, records, num_records);
+    struct memtrack_cache_entry *entry;
+    long long now;
+    int rc;
+
+    if (memtrack_cache_ttl <= 0) {
+        return memtrack_query(pid, type, records, num_records);
     }
 
-    if (type == MEMTRACK_TYPE_GRAPHICS) {
-        return ion_memtrack_get_memory(pid, type, records, num_records);
+    entry = &memtrack_cache[((unsigned int)pid * MEMTRACK_NUM_TYPES + type) %
+                            MEMTRACK_CACHE_ENTRIES];
+    now = memtrack_now();
+
+    pthread_mutex_lock(&memtrack_cache_lock);
+    if (entry->pid != pid || entry->type != type || entry->expires <= now) {
+        entry->pid = pid;
+        entry->type = type;
+        entry->num_records = MEMTRACK_CACHE_MAX_RECORDS;
+        memset(entry->records, 0, sizeof(entry->records));
+        entry->rc = memtrack_query(pid, type, entry->records,
+                                   &entry->num_records);
+        entry->expires = now + memtrack_cache_ttl;
     }
 
-    return -EINVAL;
+    rc = entry->rc;
+    if (rc == 0) {
+        memcpy(records, entry->records, sizeof(struct memtrack_record) *
+               min(*num_records, entry->num_records));
+        *num_records = entry->num_records;
+    }
+    pthread_mutex_unlock(&memtrack_cache_lock);
+
+    return rc;
 }
 
 static struct hw_module_methods_t memtrack_module_methods = {
@@ -17,10 +17,54 @@
 #ifndef _MEMTRACK_EXYNOS5_H_
 #define _MEMTRACK_EXYNOS5_H_
 
+/* Largest debugfs file the parsers read, in one read() on the stack */
+#define MEMTRACK_FILE_SIZE          8192
+
+/* Results are cached per pid and type for this long, see memtrack_cache_ttl */
+#define MEMTRACK_CACHE_TTL_MS       1000
+#define MEMTRACK_CACHE_ENTRIES      128
+#define MEMTRACK_CACHE_MAX_RECORDS  8
+
+/* Longest path of a debugfs file the parsers open */
+#define MEMTRACK_PATH_MAX           128
+
+/*
+ * Directory debugfs is mounted on, the parsers read everything below it.
+ * memtrack_test points it at a synthetic tree with
+ * memtrack_set_debugfs_root(), which also drops every cached scan and
+ * result.
+ */
+extern const char *memtrack_debugfs;
+void memtrack_set_debugfs_root(const char *root);
+
+int exynos5_memtrack_init(const struct memtrack_module *module);
+int exynos5_memtrack_get_memory(const struct memtrack_module *module,
+                                pid_t pid,
+                                int type,
+                                struct memtrack_record *records,
+                                size_t *num_records);
+
+int memtrack_read_file(const char *path, char *buf, size_t size);
+const char *memtrack_next_line(const char *p);
+const char *memtrack_skip_spaces(const char *p);
+const char *memtrack_parse_ulong(const char *p, unsigned long *value);
+
+/* Records mali_memtrack_get_memory() returns for each pid */
+#define MALI_MEMTRACK_RECORDS       2
+
 #ifdef TRACK_MALI_MEMORY
 int mali_memtrack_get_memory(pid_t pid, int type,
                              struct memtrack_record *records,
                              size_t *num_records);
+
+/*
+ * GL usage of @count pids from a single scan of the Mali debugfs directory.
+ * @records holds MALI_MEMTRACK_RECORDS records per pid, in the order of
+ * @pids. A pid without a GPU context gets zero sizes.
+ */
+int mali_memtrack_get_memory_batch(const pid_t *pids, size_t count,
+                                   struct memtrack_record *records);
+void mali_memtrack_reset(void);
 #else
 static int inline mali_memtrack_get_memory(pid_t pid, int type,
                                            struct memtrack_record *records,
@@ -28,8 +72,40 @@ static int inline mali_memtrack_get_memory(pid_t pid, int type,
 {
     return -ENOSYS;
 }
+
+static int inline mali_memtrack_get_memory_batch(const pid_t *pids,
+                                                 size_t count,
+                                                 struct memtrack_record *records)
+{
+    return -ENOSYS;
+}
+
+static void inline mali_memtrack_reset(void)
+{
+}
 #endif
 
+/*
+ * Classes of ION heaps, each reported as one memtrack record. The first
+ * three make up MEMTRACK_TYPE_GRAPHICS, the MFC regions are accounted as
+ * MEMTRACK_TYPE_MULTIMEDIA and the GSC region as MEMTRACK_TYPE_CAMERA.
+ */
+enum {
+    ION_HEAP_CLASS_SYSTEM,
+    ION_HEAP_CLASS_CONTIG,
+    ION_HEAP_CLASS_EXYNOS_CONTIG,
+    ION_HEAP_CLASS_MFC,
+    ION_HEAP_CLASS_GSC,
+    ION_NUM_HEAP_CLASSES,
+};
+
+void ion_memtrack_init(void);
+void ion_memtrack_reset(void);
+
+/* Sums the per-heap-class usage of every ION client of @pid */
+int ion_memtrack_get_heaps(pid_t pid,
+                           unsigned long sizes[ION_NUM_HEAP_CLASSES]);
+
 int ion_memtrack_get_memory(pid_t pid,
                             int type,
                             struct memtrack_record *records,
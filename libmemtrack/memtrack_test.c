@@ -0,0 +1,521 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * memtrack_test - checks the debugfs parsers and measures the query cost
+ *
+ * usage: memtrack_test [-n pids] [-t tmpdir] fixture_dir
+ *
+ * fixture_dir is a copy of libmemtrack/memtrack_fixture, a synthetic
+ * debugfs tree (adb push it to the device). The parsers read it instead of
+ * /sys/kernel/debug and the results are compared with the sizes written in
+ * it. Then a tree of -n pids (200 by default) is generated below -t
+ * (/data/local/tmp by default) and every memtrack type is queried for each
+ * pid, with an empty and with a filled result cache. The checks of many
+ * pids also generate a tree of TEST_LARGE_PIDS pids below -t, more clients
+ * and contexts than the scans start with. Exits with 1 if any check fails.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <hardware/memtrack.h>
+
+#include "memtrack_exynos5.h"
+
+#define ARRAY_SIZE(x) (sizeof(x)/sizeof(x[0]))
+
+static unsigned int test_failures;
+static const char *test_fixture;
+static const char *test_tmpdir = "/data/local/tmp";
+
+#define TEST_CHECK(cond)                                                \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            printf("  FAIL %s:%d: %s\n", __func__, __LINE__, #cond);    \
+            test_failures++;                                            \
+        }                                                               \
+    } while (0)
+
+/* Queries through the HAL entry, so the result cache is exercised too */
+static int test_query(pid_t pid, int type, size_t *num_records,
+                      struct memtrack_record *records)
+{
+    *num_records = MEMTRACK_CACHE_MAX_RECORDS;
+    memset(records, 0, sizeof(struct memtrack_record) *
+           MEMTRACK_CACHE_MAX_RECORDS);
+
+    return exynos5_memtrack_get_memory(NULL, pid, type, records, num_records);
+}
+
+static void test_expect(pid_t pid, int type, const size_t *sizes,
+                        size_t count)
+{
+    struct memtrack_record records[MEMTRACK_CACHE_MAX_RECORDS];
+    size_t num_records, i;
+    int rc;
+
+    rc = test_query(pid, type, &num_records, records);
+    TEST_CHECK(rc == 0);
+    if (rc != 0) {
+        return;
+    }
+
+    TEST_CHECK(num_records == count);
+    for (i = 0; i < count && i < num_records; i++) {
+        if (records[i].size_in_bytes != sizes[i]) {
+            printf("  pid %d type %d record %zu: %zu, expected %zu\n",
+                   pid, type, i, records[i].size_in_bytes, sizes[i]);
+            test_failures++;
+        }
+    }
+}
+
+/* Both clients of pid 100 are summed, by heap class */
+static void test_ion_clients(void)
+{
+    static const size_t graphics[] = { 1572864, 0, 2097152 };
+    static const size_t multimedia[] = { 4194304 };
+    static const size_t camera[] = { 262144 };
+    static const size_t graphics_200[] = { 0, 65536, 0 };
+
+    test_expect(100, MEMTRACK_TYPE_GRAPHICS, graphics, ARRAY_SIZE(graphics));
+    test_expect(100, MEMTRACK_TYPE_MULTIMEDIA, multimedia,
+                ARRAY_SIZE(multimedia));
+    test_expect(100, MEMTRACK_TYPE_CAMERA, camera, ARRAY_SIZE(camera));
+    test_expect(200, MEMTRACK_TYPE_GRAPHICS, graphics_200,
+                ARRAY_SIZE(graphics_200));
+}
+
+#define BENCH_PID_BASE  1000
+#define TEST_LARGE_PIDS 600
+
+static int bench_populate(const char *root, unsigned int npids);
+static void bench_cleanup(const char *root, unsigned int npids);
+
+/* Generates a tree of TEST_LARGE_PIDS pids and reads it instead of the fixture */
+static int test_large_begin(char *root, size_t len)
+{
+    snprintf(root, len, "%s/memtrack_test.XXXXXX", test_tmpdir);
+    if (mkdtemp(root) == NULL) {
+        printf("  cannot create a directory in %s: %s\n", test_tmpdir,
+               strerror(errno));
+        return -1;
+    }
+    if (bench_populate(root, TEST_LARGE_PIDS) < 0) {
+        bench_cleanup(root, TEST_LARGE_PIDS);
+        return -1;
+    }
+    memtrack_set_debugfs_root(root);
+
+    return 0;
+}
+
+static void test_large_end(const char *root)
+{
+    memtrack_set_debugfs_root(test_fixture);
+    bench_cleanup(root, TEST_LARGE_PIDS);
+}
+
+/* Every pid is found however many clients come before it in readdir order */
+static void test_ion_many_clients(void)
+{
+    char root[MEMTRACK_PATH_MAX];
+    size_t graphics[3], camera[1];
+    unsigned int i, n;
+    int rc;
+
+    rc = test_large_begin(root, sizeof(root));
+    TEST_CHECK(rc == 0);
+    if (rc != 0) {
+        return;
+    }
+
+    for (i = 0; i < TEST_LARGE_PIDS; i++) {
+        /* every 4th pid has a second client */
+        n = (i % 4 == 0) ? 2 : 1;
+        graphics[0] = 1048576 * n;
+        graphics[1] = 0;
+        graphics[2] = 2097152 * n;
+        camera[0] = 262144 * n;
+        test_expect(BENCH_PID_BASE + i, MEMTRACK_TYPE_GRAPHICS, graphics,
+                    ARRAY_SIZE(graphics));
+        test_expect(BENCH_PID_BASE + i, MEMTRACK_TYPE_CAMERA, camera,
+                    ARRAY_SIZE(camera));
+    }
+
+    test_large_end(root);
+}
+
+/* A pid without ION clients is an error, not zero usage */
+static void test_ion_missing(void)
+{
+    struct memtrack_record records[MEMTRACK_CACHE_MAX_RECORDS];
+    size_t num_records;
+
+    TEST_CHECK(test_query(300, MEMTRACK_TYPE_GRAPHICS, &num_records,
+                          records) == -ENOENT);
+    TEST_CHECK(test_query(999, MEMTRACK_TYPE_CAMERA, &num_records,
+                          records) == -ENOENT);
+}
+
+#ifdef TRACK_MALI_MEMORY
+/* The contexts 100 and 100_1 are summed, native buffers split off */
+static void test_mali_contexts(void)
+{
+    static const size_t gl_100[] = { 1572864, 2621440 };
+    static const size_t gl_300[] = { 0, 262144 };
+    static const size_t gl_large[] = { 1048576, 2097152 };
+    struct memtrack_record records[MEMTRACK_CACHE_MAX_RECORDS];
+    char root[MEMTRACK_PATH_MAX];
+    size_t num_records;
+    unsigned int i;
+    int rc;
+
+    test_expect(100, MEMTRACK_TYPE_GL, gl_100, ARRAY_SIZE(gl_100));
+    test_expect(300, MEMTRACK_TYPE_GL, gl_300, ARRAY_SIZE(gl_300));
+    TEST_CHECK(test_query(200, MEMTRACK_TYPE_GL, &num_records,
+                          records) == -ENOENT);
+
+    /* every context is found however many come before it in readdir order */
+    rc = test_large_begin(root, sizeof(root));
+    TEST_CHECK(rc == 0);
+    if (rc != 0) {
+        return;
+    }
+
+    for (i = 0; i < TEST_LARGE_PIDS; i++) {
+        test_expect(BENCH_PID_BASE + i, MEMTRACK_TYPE_GL, gl_large,
+                    ARRAY_SIZE(gl_large));
+    }
+
+    test_large_end(root);
+}
+
+/* The batch call agrees with single queries and zeroes unknown pids */
+static void test_mali_batch(void)
+{
+    static const pid_t pids[] = { 300, 200, 100 };
+    struct memtrack_record records[ARRAY_SIZE(pids) * MALI_MEMTRACK_RECORDS];
+
+    TEST_CHECK(mali_memtrack_get_memory_batch(pids, ARRAY_SIZE(pids),
+                                              records) == 0);
+    TEST_CHECK(records[0].size_in_bytes == 0);
+    TEST_CHECK(records[1].size_in_bytes == 262144);
+    TEST_CHECK(records[2].size_in_bytes == 0);
+    TEST_CHECK(records[3].size_in_bytes == 0);
+    TEST_CHECK(records[4].size_in_bytes == 1572864);
+    TEST_CHECK(records[5].size_in_bytes == 2621440);
+}
+#endif
+
+/* Records are only filled up to *num_records, the count is always set */
+static void test_short_records(void)
+{
+    struct memtrack_record records[1];
+    size_t num_records;
+
+    num_records = 0;
+    TEST_CHECK(exynos5_memtrack_get_memory(NULL, 100, MEMTRACK_TYPE_GRAPHICS,
+                                           records, &num_records) == 0);
+    TEST_CHECK(num_records == 3);
+
+    num_records = 1;
+    TEST_CHECK(exynos5_memtrack_get_memory(NULL, 100, MEMTRACK_TYPE_GRAPHICS,
+                                           records, &num_records) == 0);
+    TEST_CHECK(num_records == 3);
+    TEST_CHECK(records[0].size_in_bytes == 1572864);
+}
+
+struct test_case {
+    const char *name;
+    void (*run)(void);
+};
+
+static const struct test_case test_cases[] = {
+    { "ion_clients",        test_ion_clients },
+    { "ion_missing",        test_ion_missing },
+    { "ion_many_clients",   test_ion_many_clients },
+#ifdef TRACK_MALI_MEMORY
+    { "mali_contexts",      test_mali_contexts },
+    { "mali_batch",         test_mali_batch },
+#endif
+    { "short_records",      test_short_records },
+};
+
+static int run_tests(const char *fixture)
+{
+    size_t i;
+    unsigned int failures;
+
+    test_fixture = fixture;
+    memtrack_set_debugfs_root(fixture);
+
+    for (i = 0; i < ARRAY_SIZE(test_cases); i++) {
+        failures = test_failures;
+        test_cases[i].run();
+        printf("%-24s %s\n", test_cases[i].name,
+               (test_failures == failures) ? "ok" : "FAILED");
+    }
+
+    return test_failures ? -1 : 0;
+}
+
+static long long bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int bench_write(const char *dir, const char *name, const char *text)
+{
+    char path[MEMTRACK_PATH_MAX];
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    fp = fopen(path, "w");
+    if (fp == NULL) {
+        return -errno;
+    }
+    fputs(text, fp);
+    fclose(fp);
+
+    return 0;
+}
+
+/* Every pid gets one ION client and one Mali context, every 4th a second */
+static int bench_populate(const char *root, unsigned int npids)
+{
+    char clients[MEMTRACK_PATH_MAX], mem[MEMTRACK_PATH_MAX];
+    char name[32], text[256];
+    unsigned int i;
+    int rc;
+
+    snprintf(clients, sizeof(clients), "%s/ion", root);
+    mkdir(clients, 0755);
+    snprintf(clients, sizeof(clients), "%s/ion/clients", root);
+    mkdir(clients, 0755);
+    snprintf(mem, sizeof(mem), "%s/mali", root);
+    mkdir(mem, 0755);
+    snprintf(mem, sizeof(mem), "%s/mali/mem", root);
+    mkdir(mem, 0755);
+
+    snprintf(text, sizeof(text),
+             "       heap_name:    size_in_bytes\n"
+             "ion_noncontig_he:          1048576\n"
+             "exynos_contig_he:          2097152\n"
+             "             gsc:           262144\n");
+    for (i = 0; i < npids; i++) {
+        snprintf(name, sizeof(name), "%u-1", BENCH_PID_BASE + i);
+        rc = bench_write(clients, name, text);
+        if (rc < 0) {
+            return rc;
+        }
+        if (i % 4 == 0) {
+            snprintf(name, sizeof(name), "%u-2", BENCH_PID_BASE + i);
+            rc = bench_write(clients, name, text);
+            if (rc < 0) {
+                return rc;
+            }
+        }
+    }
+
+    snprintf(text, sizeof(text),
+             "Total allocated memory: 3145728\n"
+             "  1 Native Buffer memory usage: 1048576\n");
+    for (i = 0; i < npids; i++) {
+        snprintf(name, sizeof(name), "%u", BENCH_PID_BASE + i);
+        rc = bench_write(mem, name, text);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
+static void bench_cleanup(const char *root, unsigned int npids)
+{
+    char path[MEMTRACK_PATH_MAX];
+    unsigned int i;
+
+    for (i = 0; i < npids; i++) {
+        snprintf(path, sizeof(path), "%s/ion/clients/%u-1", root,
+                 BENCH_PID_BASE + i);
+        unlink(path);
+        snprintf(path, sizeof(path), "%s/ion/clients/%u-2", root,
+                 BENCH_PID_BASE + i);
+        unlink(path);
+        snprintf(path, sizeof(path), "%s/mali/mem/%u", root,
+                 BENCH_PID_BASE + i);
+        unlink(path);
+    }
+
+    snprintf(path, sizeof(path), "%s/ion/clients", root);
+    rmdir(path);
+    snprintf(path, sizeof(path), "%s/ion", root);
+    rmdir(path);
+    snprintf(path, sizeof(path), "%s/mali/mem", root);
+    rmdir(path);
+    snprintf(path, sizeof(path), "%s/mali", root);
+    rmdir(path);
+    rmdir(root);
+}
+
+static const int bench_types[] = {
+    MEMTRACK_TYPE_GRAPHICS,
+    MEMTRACK_TYPE_MULTIMEDIA,
+    MEMTRACK_TYPE_CAMERA,
+#ifdef TRACK_MALI_MEMORY
+    MEMTRACK_TYPE_GL,
+#endif
+};
+
+/* One pass over every pid and type, as dumpsys meminfo does */
+static void bench_pass(const char *name, unsigned int npids)
+{
+    struct memtrack_record records[MEMTRACK_CACHE_MAX_RECORDS];
+    size_t num_records, t;
+    unsigned int i, fails = 0, count = 0;
+    long long start, ns, max = 0, total;
+
+    total = bench_now();
+    for (i = 0; i < npids; i++) {
+        for (t = 0; t < ARRAY_SIZE(bench_types); t++) {
+            start = bench_now();
+            if (test_query(BENCH_PID_BASE + i, bench_types[t], &num_records,
+                           records) != 0) {
+                fails++;
+            }
+            ns = bench_now() - start;
+            if (ns > max) {
+                max = ns;
+            }
+            count++;
+        }
+    }
+    total = bench_now() - total;
+
+    printf("  %-18s %5u queries  total %9.1f us  avg %7.2f us  "
+           "max %8.1f us  fails %u\n", name, count, total / 1000.0,
+           total / 1000.0 / count, max / 1000.0, fails);
+}
+
+#ifdef TRACK_MALI_MEMORY
+static void bench_mali_batch(unsigned int npids)
+{
+    struct memtrack_record *records;
+    pid_t *pids;
+    unsigned int i;
+    long long start;
+    int rc;
+
+    pids = malloc(sizeof(*pids) * npids);
+    records = malloc(sizeof(*records) * npids * MALI_MEMTRACK_RECORDS);
+    if (pids == NULL || records == NULL) {
+        free(pids);
+        free(records);
+        return;
+    }
+    for (i = 0; i < npids; i++) {
+        pids[i] = BENCH_PID_BASE + i;
+    }
+
+    mali_memtrack_reset();
+    start = bench_now();
+    rc = mali_memtrack_get_memory_batch(pids, npids, records);
+    printf("  %-18s %5u pids     total %9.1f us  rc %d\n", "mali batch",
+           npids, (bench_now() - start) / 1000.0, rc);
+
+    free(pids);
+    free(records);
+}
+#endif
+
+static int run_bench(const char *tmpdir, unsigned int npids)
+{
+    char root[MEMTRACK_PATH_MAX];
+    int rc;
+
+    snprintf(root, sizeof(root), "%s/memtrack_bench.XXXXXX", tmpdir);
+    if (mkdtemp(root) == NULL) {
+        fprintf(stderr, "cannot create a directory in %s: %s\n", tmpdir,
+                strerror(errno));
+        return -1;
+    }
+
+    rc = bench_populate(root, npids);
+    if (rc < 0) {
+        fprintf(stderr, "cannot populate %s: %s\n", root, strerror(-rc));
+        bench_cleanup(root, npids);
+        return -1;
+    }
+
+    printf("%u pids, %zu types\n", npids, ARRAY_SIZE(bench_types));
+
+    /* the first pass also scans both directories */
+    memtrack_set_debugfs_root(root);
+    bench_pass("empty cache", npids);
+    bench_pass("filled cache", npids);
+#ifdef TRACK_MALI_MEMORY
+    bench_mali_batch(npids);
+#endif
+
+    bench_cleanup(root, npids);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int npids = 200;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:t:")) != -1) {
+        switch (opt) {
+        case 'n':
+            npids = atoi(optarg);
+            break;
+        case 't':
+            test_tmpdir = optarg;
+            break;
+        default:
+            fprintf(stderr,
+                    "usage: %s [-n pids] [-t tmpdir] fixture_dir\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind >= argc || npids == 0) {
+        fprintf(stderr, "usage: %s [-n pids] [-t tmpdir] fixture_dir\n",
+                argv[0]);
+        return 1;
+    }
+
+    if (run_tests(argv[optind]) < 0) {
+        return 1;
+    }
+
+    return run_bench(test_tmpdir, npids) < 0 ? 1 : 0;
+}
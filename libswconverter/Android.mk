@@ -14,7 +14,9 @@ LOCAL_SRC_FILES_arm += \
 	csc_tiled_to_linear_uv_deinterleave_neon.s \
 	csc_interleave_memcpy_neon.s \
 	csc_ARGB8888_to_YUV420SP_NEON.s \
-	csc_ARGB8888_to_ABGR8888.s
+	csc_ARGB8888_to_ABGR8888.s \
+	csc_memcpy_2d_neon.s \
+	csc_memset_2d_neon.s
 
 LOCAL_C_INCLUDES := \
 	$(TOP)/hardware/samsung_slsi-cm/openmax/include/khronos \
@@ -0,0 +1,132 @@
+/*
+ *
+ * Copyright 2012 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file    csc_memcpy_2d_neon.s
+ * @brief   SEC_OMX specific define
+ * @version 1.0
+ */
+
+/*
+ * Copies a 2D rectangle from src to dst
+ * Stores to dst are 128bit aligned bursts after a short byte head, so an
+ * uncached (write-combined) destination sees full bus writes only.
+ *
+ * @param dst
+ *   address of the first byte of the destination rectangle[out]
+ *
+ * @param dst_pitch
+ *   bytes between the starts of two destination lines[in]
+ *
+ * @param src
+ *   address of the first byte of the source rectangle[in]
+ *
+ * @param src_pitch
+ *   bytes between the starts of two source lines[in]
+ *
+ * @param width
+ *   width of the rectangle in bytes[in]
+ *
+ * @param height
+ *   height of the rectangle in lines[in]
+ */
+
+    .arch armv7-a
+    .text
+    .global csc_memcpy_2d_neon
+    .type   csc_memcpy_2d_neon, %function
+csc_memcpy_2d_neon:
+    .fnstart
+
+    .equ CACHE_LINE_SIZE, 64
+    .equ PRE_LOAD_OFFSET, 4
+
+    @r0     dst
+    @r1     dst_pitch
+    @r2     src
+    @r3     src_pitch
+    @r4     width
+    @r5     height
+    @r6     dst_addr
+    @r7     src_addr
+    @r8     remain
+    @r9     temp1
+    @r10
+    @r14
+
+    stmfd       sp!, {r4-r10,r14}       @ backup registers
+    ldr         r4, [sp, #32]           @ r4 = width
+    ldr         r5, [sp, #36]           @ r5 = height
+
+    cmp         r4, #0
+    cmpne       r5, #0
+    beq         RESTORE_REG
+
+LOOP_LINE:
+    mov         r6, r0
+    mov         r7, r2
+    mov         r8, r4
+    pld         [r7]
+
+LOOP_HEAD:
+    tst         r6, #15                 @ copy bytes until dst is 16 byte aligned
+    beq         ALIGNED
+    ldrb        r9, [r7], #1
+    strb        r9, [r6], #1
+    subs        r8, #1
+    bne         LOOP_HEAD
+    b           NEXT_LINE
+
+ALIGNED:
+    cmp         r8, #64
+    blt         LOOP_16
+
+LOOP_64:
+    pld         [r7, #(CACHE_LINE_SIZE*PRE_LOAD_OFFSET)]
+    vld1.8      {d0, d1, d2, d3}, [r7]!
+    vld1.8      {d4, d5, d6, d7}, [r7]!
+    sub         r8, #64
+    vst1.8      {d0, d1, d2, d3}, [r6, :128]!
+    vst1.8      {d4, d5, d6, d7}, [r6, :128]!
+    cmp         r8, #64
+    bge         LOOP_64
+
+LOOP_16:
+    cmp         r8, #16
+    blt         LOOP_1
+    vld1.8      {q0}, [r7]!
+    sub         r8, #16
+    vst1.8      {q0}, [r6, :128]!
+    b           LOOP_16
+
+LOOP_1:
+    cmp         r8, #0
+    beq         NEXT_LINE
+    ldrb        r9, [r7], #1
+    strb        r9, [r6], #1
+    sub         r8, #1
+    b           LOOP_1
+
+NEXT_LINE:
+    add         r0, r0, r1
+    add         r2, r2, r3
+    subs        r5, #1
+    bne         LOOP_LINE
+
+RESTORE_REG:
+    ldmfd       sp!, {r4-r10,r15}       @ restore registers
+    .fnend
@@ -0,0 +1,127 @@
+/*
+ *
+ * Copyright 2012 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file    csc_memset_2d_neon.s
+ * @brief   SEC_OMX specific define
+ * @version 1.0
+ */
+
+/*
+ * Fills a 2D rectangle with a 32bit pattern
+ * The destination is written only with 128bit aligned bursts after a short
+ * byte head, and is never read, so it is safe and fast on uncached
+ * (write-combined) ION memory.
+ *
+ * @param dst
+ *   address of the first byte of the rectangle[out]
+ *
+ * @param dst_pitch
+ *   bytes between the starts of two lines[in]
+ *
+ * @param width
+ *   width of the rectangle in bytes[in]
+ *
+ * @param height
+ *   height of the rectangle in lines[in]
+ *
+ * @param pattern
+ *   32bit pattern. byte (i % 4) is stored at byte i of each line[in]
+ */
+
+    .arch armv7-a
+    .text
+    .global csc_memset_2d_neon
+    .type   csc_memset_2d_neon, %function
+csc_memset_2d_neon:
+    .fnstart
+
+    @r0     dst
+    @r1     dst_pitch
+    @r2     width
+    @r3     height
+    @r4     line_addr
+    @r5     remain
+    @r6     line_pattern
+    @r7     pattern
+    @r8
+    @r14
+
+    stmfd       sp!, {r4-r8,r14}        @ backup registers
+    ldr         r7, [sp, #24]           @ r7 = pattern
+
+    cmp         r2, #0
+    cmpne       r3, #0
+    beq         RESTORE_REG
+
+LOOP_LINE:
+    mov         r4, r0
+    mov         r5, r2
+    mov         r6, r7
+
+LOOP_HEAD:
+    tst         r4, #15                 @ store bytes until 16 byte aligned
+    beq         ALIGNED
+    strb        r6, [r4], #1
+    mov         r6, r6, ror #8
+    subs        r5, #1
+    bne         LOOP_HEAD
+    b           NEXT_LINE
+
+ALIGNED:
+    vdup.32     q0, r6
+    vmov        q1, q0
+    cmp         r5, #64
+    blt         LOOP_16
+
+LOOP_64:
+    vst1.8      {d0, d1, d2, d3}, [r4, :128]!
+    vst1.8      {d0, d1, d2, d3}, [r4, :128]!
+    sub         r5, #64
+    cmp         r5, #64
+    bge         LOOP_64
+
+LOOP_16:
+    cmp         r5, #16
+    blt         LOOP_4
+    vst1.8      {q0}, [r4, :128]!
+    sub         r5, #16
+    b           LOOP_16
+
+LOOP_4:
+    cmp         r5, #4
+    blt         LOOP_1
+    str         r6, [r4], #4
+    sub         r5, #4
+    b           LOOP_4
+
+LOOP_1:
+    cmp         r5, #0
+    beq         NEXT_LINE
+    strb        r6, [r4], #1
+    mov         r6, r6, ror #8
+    sub         r5, #1
+    b           LOOP_1
+
+NEXT_LINE:
+    add         r0, r0, r1
+    subs        r3, #1
+    bne         LOOP_LINE
+
+RESTORE_REG:
+    ldmfd       sp!, {r4-r8,r15}        @ restore registers
+    .fnend
@@ -787,3 +787,322 @@ void csc_ARGB8888_to_YUV420SP(
         }
     }
 }
+
+/*
+ * Copies a 2D rectangle from src to dst
+ *
+ * @param dst
+ *   Address of the first byte of the destination rectangle[out]
+ *
+ * @param dst_pitch
+ *   Bytes between the starts of two destination lines[in]
+ *
+ * @param src
+ *   Address of the first byte of the source rectangle[in]
+ *
+ * @param src_pitch
+ *   Bytes between the starts of two source lines[in]
+ *
+ * @param width
+ *   Width of the rectangle in bytes[in]
+ *
+ * @param height
+ *   Height of the rectangle in lines[in]
+ */
+void csc_memcpy_2d(
+    unsigned char *dst,
+    unsigned int dst_pitch,
+    unsigned char *src,
+    unsigned int src_pitch,
+    unsigned int width,
+    unsigned int height)
+{
+    unsigned int j;
+
+    if ((dst_pitch == width) && (src_pitch == width)) {
+        memcpy(dst, src, width * height);
+        return;
+    }
+
+    for (j = 0; j < height; j++) {
+        memcpy(dst, src, width);
+        dst += dst_pitch;
+        src += src_pitch;
+    }
+}
+
+/*
+ * Fills a 2D rectangle with a 32bit pattern
+ *
+ * @param dst
+ *   Address of the first byte of the rectangle[out]
+ *
+ * @param dst_pitch
+ *   Bytes between the starts of two lines[in]
+ *
+ * @param width
+ *   Width of the rectangle in bytes[in]
+ *
+ * @param height
+ *   Height of the rectangle in lines[in]
+ *
+ * @param pattern
+ *   32bit pattern. Byte (i % 4) of it is stored at byte i of each line[in]
+ */
+void csc_memset_2d(
+    unsigned char *dst,
+    unsigned int dst_pitch,
+    unsigned int width,
+    unsigned int height,
+    unsigned int pattern)
+{
+    unsigned int i, j;
+    unsigned int *pDst;
+
+    if (pattern == ((pattern & 0xFF) * 0x01010101U)) {
+        if (dst_pitch == width) {
+            memset(dst, pattern & 0xFF, width * height);
+        } else {
+            for (j = 0; j < height; j++) {
+                memset(dst, pattern & 0xFF, width);
+                dst += dst_pitch;
+            }
+        }
+        return;
+    }
+
+    for (j = 0; j < height; j++) {
+        i = 0;
+        if (((unsigned long)dst & 3) == 0) {
+            pDst = (unsigned int *)dst;
+            for (; i + 4 <= width; i += 4)
+                *pDst++ = pattern;
+        }
+        for (; i < width; i++)
+            dst[i] = (unsigned char)(pattern >> ((i & 3) * 8));
+        dst += dst_pitch;
+    }
+}
+
+#ifdef __arm__
+#define CSC_MEMCPY_2D csc_memcpy_2d_neon
+#define CSC_MEMSET_2D csc_memset_2d_neon
+#else
+#define CSC_MEMCPY_2D csc_memcpy_2d
+#define CSC_MEMSET_2D csc_memset_2d
+#endif
+
+/*
+ * Copies a rectangle between two buffers of the same pixel size
+ *
+ * @param dst
+ *   Base address of the destination buffer[out]
+ *
+ * @param dst_pitch
+ *   Bytes per line of the destination buffer[in]
+ *
+ * @param dst_x, dst_y
+ *   Position of the rectangle in the destination buffer in pixels[in]
+ *
+ * @param src
+ *   Base address of the source buffer[in]
+ *
+ * @param src_pitch
+ *   Bytes per line of the source buffer[in]
+ *
+ * @param src_x, src_y
+ *   Position of the rectangle in the source buffer in pixels[in]
+ *
+ * @param width, height
+ *   Size of the rectangle in pixels[in]
+ *
+ * @param bpp
+ *   Bytes per pixel. 1 for a Y or U/V plane, 2 for an interleaved UV plane
+ *   in UV pairs, 4 for ARGB8888[in]
+ */
+void csc_copy_rect(
+    unsigned char *dst,
+    unsigned int dst_pitch,
+    unsigned int dst_x,
+    unsigned int dst_y,
+    unsigned char *src,
+    unsigned int src_pitch,
+    unsigned int src_x,
+    unsigned int src_y,
+    unsigned int width,
+    unsigned int height,
+    unsigned int bpp)
+{
+    CSC_MEMCPY_2D(dst + dst_y * dst_pitch + dst_x * bpp, dst_pitch,
+                  src + src_y * src_pitch + src_x * bpp, src_pitch,
+                  width * bpp, height);
+}
+
+/*
+ * Fills a rectangle of YUV420SP(NV12/NV21) with one colour
+ *
+ * @param y_dst
+ *   Y plane base address[out]
+ *
+ * @param uv_dst
+ *   UV plane base address[out]
+ *
+ * @param y_pitch
+ *   Bytes per line of the Y plane[in]
+ *
+ * @param uv_pitch
+ *   Bytes per line of the UV plane[in]
+ *
+ * @param x, y
+ *   Position of the rectangle in luma pixels. it should be even[in]
+ *
+ * @param width, height
+ *   Size of the rectangle in luma pixels. it should be even[in]
+ *
+ * @param y_value
+ *   Value stored to the Y plane[in]
+ *
+ * @param u_value
+ *   Value stored to the first byte of each UV pair[in]
+ *
+ * @param v_value
+ *   Value stored to the second byte of each UV pair[in]
+ */
+void csc_fill_rect_YUV420SP(
+    unsigned char *y_dst,
+    unsigned char *uv_dst,
+    unsigned int y_pitch,
+    unsigned int uv_pitch,
+    unsigned int x,
+    unsigned int y,
+    unsigned int width,
+    unsigned int height,
+    unsigned char y_value,
+    unsigned char u_value,
+    unsigned char v_value)
+{
+    unsigned int uv_pattern = (u_value | (v_value << 8)) * 0x00010001U;
+
+    if (y_dst != NULL)
+        CSC_MEMSET_2D(y_dst + y * y_pitch + x, y_pitch,
+                      width, height, y_value * 0x01010101U);
+    if (uv_dst != NULL)
+        CSC_MEMSET_2D(uv_dst + (y / 2) * uv_pitch + (x & ~1), uv_pitch,
+                      width & ~1, height / 2, uv_pattern);
+}
+
+/*
+ * Fills a rectangle of YUV420P(I420/YV12) with one colour
+ *
+ * @param y_dst
+ *   Y plane base address[out]
+ *
+ * @param u_dst
+ *   U plane base address[out]
+ *
+ * @param v_dst
+ *   V plane base address[out]
+ *
+ * @param y_pitch
+ *   Bytes per line of the Y plane[in]
+ *
+ * @param uv_pitch
+ *   Bytes per line of the U and V planes[in]
+ *
+ * @param x, y
+ *   Position of the rectangle in luma pixels. it should be even[in]
+ *
+ * @param width, height
+ *   Size of the rectangle in luma pixels. it should be even[in]
+ *
+ * @param y_value, u_value, v_value
+ *   Values stored to each plane[in]
+ */
+void csc_fill_rect_YUV420P(
+    unsigned char *y_dst,
+    unsigned char *u_dst,
+    unsigned char *v_dst,
+    unsigned int y_pitch,
+    unsigned int uv_pitch,
+    unsigned int x,
+    unsigned int y,
+    unsigned int width,
+    unsigned int height,
+    unsigned char y_value,
+    unsigned char u_value,
+    unsigned char v_value)
+{
+    unsigned int uv_offset = (y / 2) * uv_pitch + (x / 2);
+
+    if (y_dst != NULL)
+        CSC_MEMSET_2D(y_dst + y * y_pitch + x, y_pitch,
+                      width, height, y_value * 0x01010101U);
+    if (u_dst != NULL)
+        CSC_MEMSET_2D(u_dst + uv_offset, uv_pitch,
+                      width / 2, height / 2, u_value * 0x01010101U);
+    if (v_dst != NULL)
+        CSC_MEMSET_2D(v_dst + uv_offset, uv_pitch,
+                      width / 2, height / 2, v_value * 0x01010101U);
+}
+
+/*
+ * Fills a rectangle of a 32bit RGB buffer with one colour
+ *
+ * @param dst
+ *   Base address of the buffer[out]
+ *
+ * @param dst_pitch
+ *   Bytes per line of the buffer[in]
+ *
+ * @param x, y
+ *   Position of the rectangle in pixels[in]
+ *
+ * @param width, height
+ *   Size of the rectangle in pixels[in]
+ *
+ * @param color
+ *   Pixel value as it is stored in memory[in]
+ */
+void csc_fill_rect_ARGB8888(
+    unsigned char *dst,
+    unsigned int dst_pitch,
+    unsigned int x,
+    unsigned int y,
+    unsigned int width,
+    unsigned int height,
+    unsigned int color)
+{
+    CSC_MEMSET_2D(dst + y * dst_pitch + x * 4, dst_pitch,
+                  width * 4, height, color);
+}
+
+/*
+ * Clears a rectangle to zero
+ *
+ * @param dst
+ *   Base address of the buffer[out]
+ *
+ * @param dst_pitch
+ *   Bytes per line of the buffer[in]
+ *
+ * @param x, y
+ *   Position of the rectangle in pixels[in]
+ *
+ * @param width, height
+ *   Size of the rectangle in pixels[in]
+ *
+ * @param bpp
+ *   Bytes per pixel[in]
+ */
+void csc_clear_rect(
+    unsigned char *dst,
+    unsigned int dst_pitch,
+    unsigned int x,
+    unsigned int y,
+    unsigned int width,
+    unsigned int height,
+    unsigned int bpp)
+{
+    CSC_MEMSET_2D(dst + y * dst_pitch + x * bpp, dst_pitch,
+                  width * bpp, height, 0);
+}